@@ -0,0 +1,131 @@
+--- LUALIB 'engine calls through the LuaJIT FFI'
+----------------------------------------------------------
+--- Exports:
+---   vec2(x, y)
+---   Time()
+---   Tick()
+---   TickSpeed()
+---   CheckPoint(x, y)
+---   GetTile(x, y)
+---   IntersectLine(x0, y0, x1, y1)
+---   TestBox(x, y, w, h)
+---   MoveBox(pos, vel, w, h, elasticity)
+---   EntityPtr(entity)
+---   GetPos(ptr)
+---   SetPos(ptr, x, y)
+---   NewQueryBuffer(max)
+---   Query(type, buffer, max, x, y, radius)
+----------------------------------------------------------
+--- Unlike the luabridge bindings these can be compiled by the JIT,
+--- use them in loops that run every tick.
+--- Entity pointers are only valid in the tick they were taken in.
+
+module("ffiapi", package.seeall)
+
+local ffi = require("ffi")
+
+ffi.cdef[[
+typedef struct { float x, y; } tw_vec2;
+typedef struct { void *ent; tw_vec2 pos; tw_vec2 vel; int health, armor, team, cid; } tw_entity_info;
+]]
+
+local exports = _ENGINE_FFI
+if exports == nil then error("the engine does not provide the ffi exports") end
+
+local C = {
+    time = ffi.cast("double (*)(void)", exports.tw_time),
+    tick = ffi.cast("int (*)(void)", exports.tw_tick),
+    tickspeed = ffi.cast("int (*)(void)", exports.tw_tickspeed),
+    check_point = ffi.cast("int (*)(float, float)", exports.tw_col_check_point),
+    get_tile = ffi.cast("int (*)(float, float)", exports.tw_col_get_tile),
+    intersect_line = ffi.cast("int (*)(float, float, float, float, tw_vec2 *, tw_vec2 *)", exports.tw_col_intersect_line),
+    test_box = ffi.cast("int (*)(float, float, float, float)", exports.tw_col_test_box),
+    move_box = ffi.cast("void (*)(tw_vec2 *, tw_vec2 *, float, float, float)", exports.tw_col_move_box),
+    entity_get_pos = ffi.cast("void (*)(void *, tw_vec2 *)", exports.tw_entity_get_pos),
+    entity_set_pos = ffi.cast("void (*)(void *, float, float)", exports.tw_entity_set_pos),
+    world_query = ffi.cast("int (*)(int, float, float, float, tw_entity_info *, int)", exports.tw_world_query),
+}
+
+local sqrt = math.sqrt
+
+local vec2_methods = {}
+
+--- A vector that lives in a C struct. Temporaries in compiled loops don't allocate.
+--- @param x number
+--- @param y number
+--- @return cdata
+vec2 = ffi.metatype("tw_vec2", {
+    __add = function(a, b) return vec2(a.x+b.x, a.y+b.y) end,
+    __sub = function(a, b) return vec2(a.x-b.x, a.y-b.y) end,
+    __mul = function(a, s) return vec2(a.x*s, a.y*s) end,
+    __div = function(a, s) return vec2(a.x/s, a.y/s) end,
+    __unm = function(a) return vec2(-a.x, -a.y) end,
+    __eq = function(a, b) return a.x == b.x and a.y == b.y end,
+    __tostring = function(a) return "vec2(" .. a.x .. ", " .. a.y .. ")" end,
+    __index = vec2_methods,
+})
+
+function vec2_methods.Length(a) return sqrt(a.x*a.x + a.y*a.y) end
+function vec2_methods.Dot(a, b) return a.x*b.x + a.y*b.y end
+function vec2_methods.Distance(a, b) local dx, dy = a.x-b.x, a.y-b.y return sqrt(dx*dx + dy*dy) end
+function vec2_methods.Normalize(a)
+    local l = sqrt(a.x*a.x + a.y*a.y)
+    if l == 0 then return vec2(0, 0) end
+    return vec2(a.x/l, a.y/l)
+end
+
+--- @return number Seconds since an arbitrary point, with sub-microsecond resolution
+function Time() return C.time() end
+
+--- @return number The current server tick
+function Tick() return C.tick() end
+
+--- @return number Ticks per second
+function TickSpeed() return C.tickspeed() end
+
+--- @return boolean Whether the point is inside a solid tile
+function CheckPoint(x, y) return C.check_point(x, y) ~= 0 end
+
+--- @return number The collision flags of the tile at the point
+function GetTile(x, y) return C.get_tile(x, y) end
+
+--- @return number,cdata,cdata The collision flags of the tile hit (0 for none), the hit position and the last position before it
+function IntersectLine(x0, y0, x1, y1)
+    local col, before = vec2(0, 0), vec2(0, 0)
+    local tile = C.intersect_line(x0, y0, x1, y1, col, before)
+    return tile, col, before
+end
+
+--- @return boolean Whether a box of that size at the point touches a solid tile
+function TestBox(x, y, w, h) return C.test_box(x, y, w, h) ~= 0 end
+
+--- Moves a box like the characters are moved. pos and vel are updated in place.
+--- @param pos cdata vec2
+--- @param vel cdata vec2
+function MoveBox(pos, vel, w, h, elasticity) C.move_box(pos, vel, w, h, elasticity or 0) end
+
+--- @param entity userdata Any entity
+--- @return userdata The raw pointer for GetPos and SetPos
+function EntityPtr(entity) return exports.EntityPtr(entity) end
+
+--- @return cdata vec2
+function GetPos(ptr)
+    local pos = vec2(0, 0)
+    C.entity_get_pos(ptr, pos)
+    return pos
+end
+
+function SetPos(ptr, x, y) C.entity_set_pos(ptr, x, y) end
+
+--- @param max number How many entities the buffer can hold
+--- @return cdata A buffer for Query, reuse it
+function NewQueryBuffer(max) return ffi.new("tw_entity_info[?]", max) end
+
+--- Fills the buffer with the entities of a type, see World:Query.
+--- The entries are zero based: buffer[0] .. buffer[n-1], each with ent, pos, vel, health, armor, team and cid.
+--- @param x number|nil Without a position the whole world is searched
+--- @return number How many entities were found
+function Query(type, buffer, max, x, y, radius)
+    if x == nil then return C.world_query(type, 0, 0, -1, buffer, max) end
+    return C.world_query(type, x, y, radius, buffer, max)
+end
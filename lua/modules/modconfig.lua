@@ -57,7 +57,7 @@ function Load()
     end
 
     local json_string = f:read("*a")
-    local success, result = pcall(json.Parse, json_string) -- lua style try-catch - result is either our json_value or an error message
+    local success, result = pcall(json.Read, json_string) -- lua style try-catch - result is either our table or an error message
     f:close()
 
     -- json parsing error
@@ -66,9 +66,8 @@ function Load()
         return false, path
     end
 
-    success, result = pcall(result.ToObject, result)
-    if not success then
-        throw("[config] Failed to load config! " .. result)
+    if type(result) ~= "table" then
+        throw("[config] Failed to load config! The settings file doesn't contain an object")
         return false, path
     end
 
@@ -85,9 +84,7 @@ function Save() -- call this in OnScriptUnload()
     local file = io.open(_scriptConfigFile, "w+")
     if file == nil then error("Failed to save config to " .. _scriptConfigFile, 2) end
 
-    local json_value = json.Convert(_scriptConfig)
-    local json_string = json.Serialize(json_value)
-    json_value:Destroy()
+    local json_string = json.Write(_scriptConfig)
 
     file:write(json_string)
     file:flush()
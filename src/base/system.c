@@ -32,6 +32,12 @@
 
 	#include <dirent.h>
 
+	#if defined(CONF_PLATFORM_LINUX)
+		#include <sys/epoll.h>
+		#include <sys/eventfd.h>
+		#include <sys/timerfd.h>
+	#endif
+
 	#if defined(CONF_PLATFORM_MACOSX)
 		#include <Carbon/Carbon.h>
 	#endif
@@ -1561,6 +1567,31 @@ int fs_is_dir(const char *path)
 #endif
 }
 
+int fs_file_info(const char *path, int64 *modified, int64 *size)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	ULARGE_INTEGER time;
+	if(!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+		return 1;
+
+	/* 100ns intervals since 1601 */
+	time.LowPart = data.ftLastWriteTime.dwLowDateTime;
+	time.HighPart = data.ftLastWriteTime.dwHighDateTime;
+	*modified = (int64)(time.QuadPart/10000000 - 11644473600LL);
+	*size = ((int64)data.nFileSizeHigh<<32) | data.nFileSizeLow;
+	return 0;
+#else
+	struct stat sb;
+	if(stat(path, &sb) == -1)
+		return 1;
+
+	*modified = (int64)sb.st_mtime;
+	*size = (int64)sb.st_size;
+	return 0;
+#endif
+}
+
 int fs_chdir(const char *path)
 {
 	if(fs_is_dir(path))
@@ -1666,8 +1697,8 @@ int net_socket_read_wait(NETSOCKET sock, int time)
 	fd_set readfds;
 	int sockid;
 
-	tv.tv_sec = 0;
-	tv.tv_usec = 1000*time;
+	tv.tv_sec = time/1000;
+	tv.tv_usec = 1000*(time%1000);
 	sockid = 0;
 
 	FD_ZERO(&readfds);
@@ -1695,6 +1726,243 @@ int net_socket_read_wait(NETSOCKET sock, int time)
 	return 0;
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+struct NETWAIT
+{
+	int epollfd;
+	int timerfd;
+	int wakefd;
+};
+
+static int net_wait_add_fd(NETWAIT *wait, int fd);
+
+NETWAIT *net_wait_create()
+{
+	NETWAIT *wait = (NETWAIT *)mem_alloc(sizeof(NETWAIT), 4);
+	wait->epollfd = epoll_create(8);
+	/* time_get is based on gettimeofday, so the deadlines are realtime as well */
+	wait->timerfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK);
+	wait->wakefd = eventfd(0, EFD_NONBLOCK);
+	if(wait->epollfd < 0 || wait->timerfd < 0 || wait->wakefd < 0 ||
+		net_wait_add_fd(wait, wait->timerfd) != 0 || net_wait_add_fd(wait, wait->wakefd) != 0)
+	{
+		dbg_msg("net", "failed to create the wait set. errno=%d", errno);
+		net_wait_destroy(wait);
+		return NULL;
+	}
+	return wait;
+}
+
+void net_wait_destroy(NETWAIT *wait)
+{
+	if(wait->wakefd >= 0)
+		close(wait->wakefd);
+	if(wait->timerfd >= 0)
+		close(wait->timerfd);
+	if(wait->epollfd >= 0)
+		close(wait->epollfd);
+	mem_free(wait);
+}
+
+void net_wait_wake(NETWAIT *wait)
+{
+	int64 one = 1;
+	if(write(wait->wakefd, &one, sizeof(one)) < 0)
+		return; /* the counter is full, so it is going to wake up anyway */
+}
+
+static int net_wait_add_fd(NETWAIT *wait, int fd)
+{
+	struct epoll_event event;
+	if(fd < 0)
+		return 0;
+	mem_zero(&event, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+	return epoll_ctl(wait->epollfd, EPOLL_CTL_ADD, fd, &event);
+}
+
+int net_wait_add(NETWAIT *wait, NETSOCKET sock)
+{
+	if(net_wait_add_fd(wait, sock.ipv4sock) != 0 || net_wait_add_fd(wait, sock.ipv6sock) != 0)
+		return -1;
+	return 0;
+}
+
+void net_wait_remove(NETWAIT *wait, NETSOCKET sock)
+{
+	/* a socket that gets closed leaves the set by itself, this is only for the ones that stay open */
+	struct epoll_event event;
+	if(sock.ipv4sock >= 0)
+		epoll_ctl(wait->epollfd, EPOLL_CTL_DEL, sock.ipv4sock, &event);
+	if(sock.ipv6sock >= 0)
+		epoll_ctl(wait->epollfd, EPOLL_CTL_DEL, sock.ipv6sock, &event);
+}
+
+int net_wait(NETWAIT *wait, int64 deadline)
+{
+	struct epoll_event events[16];
+	struct itimerspec spec;
+	int num, i, readable = 0;
+
+	/* an absolute deadline fires right away if it has passed already, zero disarms */
+	mem_zero(&spec, sizeof(spec));
+	if(deadline >= 0)
+	{
+		spec.it_value.tv_sec = deadline/time_freq();
+		spec.it_value.tv_nsec = (deadline%time_freq())*(1000000000/time_freq());
+		if(spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+			spec.it_value.tv_nsec = 1;
+	}
+	timerfd_settime(wait->timerfd, TFD_TIMER_ABSTIME, &spec, NULL);
+
+	num = epoll_wait(wait->epollfd, events, sizeof(events)/sizeof(events[0]), -1);
+	if(num < 0)
+		return errno == EINTR ? 0 : -1;
+
+	for(i = 0; i < num; i++)
+	{
+		if(events[i].data.fd == wait->timerfd || events[i].data.fd == wait->wakefd)
+		{
+			/* only to clear them, the number of expirations or wakes doesn't matter */
+			int64 count;
+			if(read(events[i].data.fd, &count, sizeof(count)) < 0)
+				continue;
+			if(events[i].data.fd == wait->wakefd)
+				readable = 1;
+		}
+		else
+			readable = 1;
+	}
+	return readable;
+}
+#else
+enum
+{
+	NETWAIT_MAX_FDS = 64
+};
+
+struct NETWAIT
+{
+	int num;
+	int fds[NETWAIT_MAX_FDS];
+
+	/* wakes are a byte sent to this loopback socket, select takes nothing else on windows */
+	NETSOCKET wakesock;
+	NETADDR wakeaddr;
+};
+
+NETWAIT *net_wait_create()
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	NETWAIT *wait = (NETWAIT *)mem_alloc(sizeof(NETWAIT), 4);
+	wait->num = 0;
+
+	mem_zero(&wait->wakeaddr, sizeof(wait->wakeaddr));
+	wait->wakeaddr.type = NETTYPE_IPV4;
+	wait->wakeaddr.ip[0] = 127;
+	wait->wakeaddr.ip[3] = 1;
+	wait->wakesock = net_udp_create(wait->wakeaddr, 1);
+	if(wait->wakesock.ipv4sock < 0 || getsockname(wait->wakesock.ipv4sock, (struct sockaddr *)&addr, &addrlen) != 0)
+	{
+		dbg_msg("net", "failed to create the wait set");
+		net_wait_destroy(wait);
+		return NULL;
+	}
+	wait->wakeaddr.port = ntohs(addr.sin_port);
+	wait->fds[wait->num++] = wait->wakesock.ipv4sock;
+	return wait;
+}
+
+void net_wait_destroy(NETWAIT *wait)
+{
+	if(wait->wakesock.ipv4sock >= 0)
+		net_udp_close(wait->wakesock);
+	mem_free(wait);
+}
+
+void net_wait_wake(NETWAIT *wait)
+{
+	char data = 0;
+	net_udp_send(wait->wakesock, &wait->wakeaddr, &data, sizeof(data));
+}
+
+static int net_wait_add_fd(NETWAIT *wait, int fd)
+{
+	if(fd < 0)
+		return 0;
+	if(wait->num == NETWAIT_MAX_FDS)
+		return -1;
+	wait->fds[wait->num++] = fd;
+	return 0;
+}
+
+static void net_wait_remove_fd(NETWAIT *wait, int fd)
+{
+	int i;
+	for(i = 0; i < wait->num; i++)
+	{
+		if(wait->fds[i] == fd)
+		{
+			wait->fds[i] = wait->fds[--wait->num];
+			return;
+		}
+	}
+}
+
+int net_wait_add(NETWAIT *wait, NETSOCKET sock)
+{
+	if(net_wait_add_fd(wait, sock.ipv4sock) != 0 || net_wait_add_fd(wait, sock.ipv6sock) != 0)
+		return -1;
+	return 0;
+}
+
+void net_wait_remove(NETWAIT *wait, NETSOCKET sock)
+{
+	if(sock.ipv4sock >= 0)
+		net_wait_remove_fd(wait, sock.ipv4sock);
+	if(sock.ipv6sock >= 0)
+		net_wait_remove_fd(wait, sock.ipv6sock);
+}
+
+int net_wait(NETWAIT *wait, int64 deadline)
+{
+	struct timeval tv;
+	fd_set readfds;
+	int i, maxfd = 0, num;
+
+	FD_ZERO(&readfds);
+	for(i = 0; i < wait->num; i++)
+	{
+		FD_SET(wait->fds[i], &readfds);
+		if(wait->fds[i] > maxfd)
+			maxfd = wait->fds[i];
+	}
+
+	if(deadline >= 0)
+	{
+		int64 left = deadline-time_get();
+		if(left < 0)
+			left = 0;
+		left = left*1000000/time_freq();
+		tv.tv_sec = (long)(left/1000000);
+		tv.tv_usec = (long)(left%1000000);
+	}
+	num = select(maxfd+1, &readfds, NULL, NULL, deadline >= 0 ? &tv : NULL);
+	if(num < 0)
+		return -1;
+
+	if(FD_ISSET(wait->wakesock.ipv4sock, &readfds))
+	{
+		char buf[64];
+		NETADDR addr;
+		while(net_udp_recv(wait->wakesock, &addr, buf, sizeof(buf)) > 0);
+	}
+	return num > 0 ? 1 : 0;
+}
+#endif
+
 int time_timestamp()
 {
 	return time(0);
@@ -1089,6 +1089,20 @@ int fs_storage_path(const char *appname, char *path, int max);
 */
 int fs_is_dir(const char *path);
 
+/*
+	Function: fs_file_info
+		Gets the modification time and size of a file
+
+	Parameters:
+		path - File to look at
+		modified - Receives the modification time in seconds since the epoch
+		size - Receives the size in bytes
+
+	Returns:
+		Returns 0 on success, 1 on failure.
+*/
+int fs_file_info(const char *path, int64 *modified, int64 *size);
+
 /*
 	Function: fs_chdir
 		Changes current working directory
@@ -1198,6 +1212,62 @@ int net_would_block();
 
 int net_socket_read_wait(NETSOCKET sock, int time);
 
+/* Group: Network Waiting */
+typedef struct NETWAIT NETWAIT;
+
+/*
+	Function: net_wait_create
+		Creates a set of sockets to wait on together with a deadline.
+		On linux this is an epoll instance with a timerfd, so the
+		deadline is kept to the microsecond instead of the whole
+		milliseconds of a select timeout.
+
+	Returns:
+		The set or NULL on failure.
+*/
+NETWAIT *net_wait_create();
+
+/*
+	Function: net_wait_destroy
+		Frees a set, the sockets in it are left open.
+*/
+void net_wait_destroy(NETWAIT *wait);
+
+/*
+	Function: net_wait_wake
+		Makes a <net_wait> on the set return right away, or the next
+		one if nobody is waiting. Can be called from any thread.
+*/
+void net_wait_wake(NETWAIT *wait);
+
+/*
+	Function: net_wait_add
+		Adds a socket to the set, both its ipv4 and ipv6 part.
+
+	Returns:
+		Returns 0 on success.
+*/
+int net_wait_add(NETWAIT *wait, NETSOCKET sock);
+
+/*
+	Function: net_wait_remove
+		Removes a socket from the set, call it before closing the socket.
+*/
+void net_wait_remove(NETWAIT *wait, NETSOCKET sock);
+
+/*
+	Function: net_wait
+		Waits until a socket in the set has data or the deadline passes.
+
+	Parameters:
+		wait - The set to wait on.
+		deadline - Point in <time_get> units to wake up at, or a negative value to wait for data only.
+
+	Returns:
+		1 if a socket is readable or the set was woken up, 0 on the deadline, negative on error.
+*/
+int net_wait(NETWAIT *wait, int64 deadline);
+
 void mem_debug_dump(IOHANDLE file);
 
 void swap_endian(void *data, unsigned elem_size, unsigned num);
@@ -8,6 +8,8 @@ class ILua : public IInterface
 	MACRO_INTERFACE("lua", 0)
 public:
 	virtual void FirstInit() = 0;
+	/** makes this the lua state the engine talks to, there is one per game instance */
+	virtual void Activate() = 0;
 };
 
 extern ILua *CreateLua();
@@ -41,11 +41,17 @@ public:
 	int TickSpeed() const { return m_TickSpeed; }
 
 	virtual int MaxClients() const = 0;
+
+	// the game instance the server is currently working on, see sv_instances
+	virtual class IGameServer *GameServer() = 0;
+	// calls pfnFunc once for every game instance, with that instance active
+	virtual void ForEachInstance(void (*pfnFunc)(void *pUser), void *pUser) = 0;
 	virtual const char *ClientName(int ClientID) = 0;
 	virtual const char *ClientClan(int ClientID) = 0;
 	virtual int ClientCountry(int ClientID) = 0;
 	virtual bool ClientIngame(int ClientID) = 0;
 	virtual bool ClientIsDummy(int ClientID) = 0;
+	virtual bool ClientSlotFree(int ClientID) = 0; // in any game instance
 	virtual int GetClientInfo(int ClientID, CClientInfo *pInfo) const = 0;
 	virtual void GetClientAddr(int ClientID, char *pAddrStr, int Size) = 0;
 	virtual std::string GetClientAddrLua(int ClientID) = 0;
@@ -86,6 +92,8 @@ public:
 	virtual void *SnapNewItem(int Type, int ID, int Size) = 0;
 
 	virtual void SnapSetStaticsize(int ItemType, int Size) = 0;
+	// items snapped from now on are accounted to this lua class in the bandwidth statistics (NULL = none)
+	virtual void SnapSetOwner(const char *pLuaClass) = 0;
 
 	enum
 	{
@@ -189,6 +197,7 @@ public:
 	virtual void OnShutdown() = 0;
 
 	virtual void OnTick() = 0;
+	virtual void OnIdleTick() = 0; // instead of OnTick while nobody is connected, at sv_idle_tickrate
 	virtual void OnPreSnap() = 0;
 	virtual void OnSnap(int ClientID) = 0;
 	virtual void OnPostSnap() = 0;
@@ -3,6 +3,7 @@
 
 #include <base/system.h>
 
+#include <engine/engine.h>
 #include <engine/storage.h>
 #include <engine/console.h>
 #include <engine/server.h>
@@ -20,20 +21,27 @@ CLua * CLua::ms_pSelf = NULL;
 CLua::CLua()
 {
 	m_pLuaState = NULL;
+	m_ClassCapsGeneration = 0;
 }
 
 void CLua::FirstInit()
+{
+	Activate();
+}
+
+void CLua::Activate()
 {
 	CLua::ms_pSelf = this;
 	CLuaBinding::StaticInit(this);
 }
 
-bool CLua::InitAndStartGametype()
+bool CLua::InitAndStartGametype(CGameContext *pGameServer)
 {
 	m_pStorage = Kernel()->RequestInterface<IStorage>();
 	m_pConsole = Kernel()->RequestInterface<IConsole>();
 	m_pServer = Kernel()->RequestInterface<IServer>();
-	m_pGameServer = dynamic_cast<CGameContext *>(Kernel()->RequestInterface<IGameServer>());
+	m_pGameServer = pGameServer;
+	m_BytecodeCache.Init(m_pStorage);
 
 	return CleanLaunchLua();
 }
@@ -50,6 +58,11 @@ void CLua::OpenLua()
 	InitializeLuaState();
 	RegisterLuaCallbacks();
 	InjectOverrides();
+
+	m_GC.Init(m_pLuaState);
+	m_Timers.Init(m_pLuaState, Server()->Tick());
+	m_Async.Init(m_pLuaState, Kernel()->RequestInterface<IEngine>());
+	m_Watchdog.Init(m_pLuaState);
 }
 
 void CLua::InitializeLuaState()
@@ -96,7 +109,10 @@ void CLua::InjectOverrides()
 
 bool CLua::CleanLaunchLua()
 {
+	// the operations in flight may still use the databases
+	m_Async.Shutdown();
 	GetResMan()->FreeAll();
+	m_Timers.Clear();
 	if(m_pLuaState)
 		lua_close(m_pLuaState);
 	m_lLuaClasses.clear();
@@ -144,7 +160,14 @@ bool CLua::LoadLuaFile(const char *pFilePath)
 
 	// load the file
 	dbg_msg("lua", "loading script '%s' for gametype %s", aFullPath, g_Config.m_SvGametype);
-	int Status = luaL_dofile(m_pLuaState, aFullPath);
+	int Status = m_BytecodeCache.Load(m_pLuaState, aFullPath);
+	if(Status == 0)
+	{
+		// the watchdog's hook doesn't get to run in compiled code
+		if(CLuaWatchdog::Enabled())
+			luaJIT_setmode(m_pLuaState, -1, LUAJIT_MODE_ALLFUNC|LUAJIT_MODE_OFF);
+		Status = lua_pcall(m_pLuaState, 0, LUA_MULTRET, 0);
+	}
 	if(Status != 0)
 	{
 		dbg_msg("lua", "FATAL: an error was thrown while loading file '%s', not starting!", aFullPath);
@@ -187,6 +210,7 @@ int CLua::ListdirCallback(const char *name, const char *full_path, int is_dir, i
 bool CLua::LoadGametype()
 {
 	char aDir[128];
+	m_BytecodeCache.ResetStats();
 
 	// load all the lua files
 	str_formatb(aDir, "gamemodes/%s", g_Config.m_SvGametype);
@@ -201,9 +225,44 @@ bool CLua::LoadGametype()
 		return false;
 	}
 
+	const CLuaBytecodeCache::CStats *pStats = m_BytecodeCache.Stats();
+	dbg_msg("lua", "loaded %d scripts (%d from the bytecode cache) in %.2fms", pStats->m_Hits+pStats->m_Misses, pStats->m_Hits, pStats->m_Time*1000.0/time_freq());
+
+	// the init file may still add functions to the classes
+	UpdateClassCaps();
 	return true;
 }
 
+void CLua::UpdateClassCaps()
+{
+	static const struct { const char *pFunc; int Cap; } s_aCaps[] = {
+		{ "Tick", CLASSCAP_TICK },
+		{ "TickDefered", CLASSCAP_TICKDEFERED },
+		{ "TickPaused", CLASSCAP_TICKPAUSED },
+		{ "Snap", CLASSCAP_SNAP },
+	};
+
+	for(std::vector<LuaClass>::iterator it = m_lLuaClasses.begin(); it != m_lLuaClasses.end(); ++it)
+	{
+		it->caps = 0;
+		luabridge::LuaRef ClassTable = luabridge::getGlobal(m_pLuaState, it->name.c_str());
+		if(!ClassTable.isTable())
+			continue;
+		for(unsigned i = 0; i < sizeof(s_aCaps)/sizeof(s_aCaps[0]); i++)
+			if(ClassTable[s_aCaps[i].pFunc].isFunction())
+				it->caps |= s_aCaps[i].Cap;
+	}
+	m_ClassCapsGeneration++;
+}
+
+int CLua::GetClassCaps(const char *pClassName) const
+{
+	for(std::vector<LuaClass>::const_iterator it = m_lLuaClasses.begin(); it != m_lLuaClasses.end(); ++it)
+		if(it->name == pClassName)
+			return it->caps;
+	return 0;
+}
+
 void CLua::ReloadSingleObject(int ObjectID)
 {
 	if(ObjectID < 0)
@@ -221,6 +280,8 @@ void CLua::ReloadSingleObject(int ObjectID)
 		RegisterScript(m_lLuaClasses[ObjectID].path.c_str(), m_lLuaClasses[ObjectID].name.c_str(), true);
 		Console()->Printf(0, "luaserver", "reloading %s", m_lLuaClasses[ObjectID].GetIdent().c_str());
 	}
+
+	UpdateClassCaps();
 }
 
 // low level error handling (errors not thrown as an exception)
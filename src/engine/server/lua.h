@@ -9,6 +9,12 @@
 #include <base/tl/array.h>
 #include <engine/lua.h>
 #include <engine/server/luaresman.h>
+#include <engine/server/lua/luaasync.h>
+#include <engine/server/lua/luacache.h>
+#include <engine/server/lua/luagc.h>
+#include <engine/server/lua/luatimers.h>
+#include <engine/server/lua/luawatchdog.h>
+#include <engine/shared/profiler.h>
 
 
 /** USEFUL MACROS TO INVOKE LUA
@@ -30,7 +36,7 @@ bool _LUA_EVENT_HANDLED = false; \
 	{ \
 		lua_State *L = ClassTable.state(); \
 		LuaRef Func = ClassTable[FUNCNAME]; \
-		if(Func.isFunction()) \
+		if(Func.isFunction() && !CLua::Lua()->Watchdog()->IsDisabled(GetLuaClassName())) \
 		{ \
 			/*lua_State *L = Func.state();*/ \
 \
@@ -56,7 +62,11 @@ bool _LUA_EVENT_HANDLED = false; \
 				LuaRef PrevThis = getGlobal(L, "this"); \
 				setGlobal(L, Self, "self"); \
 				setGlobal(L, this, "this"); \
-				try { RESOP Func(__VA_ARGS__); } catch(LuaException& e) { CLua::HandleException(e); } \
+				{ \
+					PROFILE_SCOPE(PHASE_LUA); \
+					CLuaWatchdog::CScope WatchdogScope(CLua::Lua()->Watchdog(), GetLuaClassName()); \
+					try { RESOP Func(__VA_ARGS__); } catch(LuaException& e) { CLua::HandleException(e); } \
+				} \
 				/* restore previous environment */ \
 				setGlobal(L, PrevSelf, "self"); \
 				setGlobal(L, PrevThis, "this"); \
@@ -120,6 +130,11 @@ class CLua : public ILua
 	friend class CLuaBinding;
 	friend class CLuaRessourceMgr;
 	friend class CLuaSql;
+	friend class CConfigProperties;
+	friend class CLuaFFI;
+	friend class CLuaAsync;
+	friend class CLuaTimers;
+	friend class CLuaWatchdog;
 
 public:
 	enum
@@ -127,6 +142,15 @@ public:
 		OBJ_ID_EVERYTHING = -1
 	};
 
+	// functions a lua class implements, see UpdateClassCaps
+	enum
+	{
+		CLASSCAP_TICK = 1,
+		CLASSCAP_TICKDEFERED = 2,
+		CLASSCAP_TICKPAUSED = 4,
+		CLASSCAP_SNAP = 8,
+	};
+
 private:
 	class IStorage *m_pStorage;
 	class IConsole *m_pConsole;
@@ -154,16 +178,30 @@ private:
 
 	struct LuaClass
 	{
-		LuaClass(const std::string& path, const std::string& name) : name(name), path(path) {}
+		LuaClass(const std::string& path, const std::string& name) : name(name), path(path), caps(0) {}
 
 		std::string name;
 		std::string path;
+		int caps;
 
 		std::string GetIdent() const { return std::string(name + ":" + path); }
 	};
 	std::vector<LuaClass> m_lLuaClasses;
+	int m_ClassCapsGeneration;
+
+	/**
+	 * Looks up which of the CLASSCAP_* functions every loaded class defines.
+	 * Needs to run whenever scripts got (re)loaded, functions that are added to a
+	 * class table later on from within lua are not picked up.
+	 */
+	void UpdateClassCaps();
 
 	CLuaRessourceMgr m_ResMan;
+	CLuaGC m_GC;
+	CLuaTimers m_Timers;
+	CLuaAsync m_Async;
+	CLuaWatchdog m_Watchdog;
+	CLuaBytecodeCache m_BytecodeCache;
 
 	// for debugging
 	int m_NumLuaObjects;
@@ -172,15 +210,25 @@ public:
 	CLua();
 	lua_State *L() { return m_pLuaState; }
 	CLuaRessourceMgr *GetResMan() { return &m_ResMan; }
+	CLuaGC *GC() { return &m_GC; }
+	CLuaTimers *Timers() { return &m_Timers; }
+	CLuaAsync *Async() { return &m_Async; }
+	CLuaWatchdog *Watchdog() { return &m_Watchdog; }
 
 	void FirstInit();
-	bool InitAndStartGametype();
+	void Activate();
+	bool InitAndStartGametype(class CGameContext *pGameServer);
 	void ReloadSingleObject(int ObjectID);
 
 	int NumLoadedClasses() const { return (int)m_lLuaClasses.size(); }
 	std::string GetObjectIdentifier(int ID) const { return m_lLuaClasses[ID].GetIdent(); }
 	const char *GetObjectName(int ID) const { return m_lLuaClasses[ID].name.c_str(); }
 
+	/** CLASSCAP_* flags of the given class, 0 if there is no such class */
+	int GetClassCaps(const char *pClassName) const;
+	/** changes every time the caps got updated */
+	int ClassCapsGeneration() const { return m_ClassCapsGeneration; }
+
 	static luabridge::LuaRef GetSelfTable(lua_State *L, const class CLuaClass *pLC);
 	static void FreeSelfTable(lua_State *L, const class CLuaClass *pLC);
 	int NumLuaObjects() const { return m_NumLuaObjects; }
@@ -0,0 +1,245 @@
+#include <stddef.h>
+
+#include <engine/server.h>
+#include <engine/server/lua.h>
+
+#include "lua_config.h"
+
+CConfigProperties::CVariable CConfigProperties::ms_aVariables[] = {
+#define MACRO_CONFIG_INT(Name,ScriptName,Def,Min,Max,Save,Desc) \
+	{ #Name, #ScriptName, TYPE_INT, (int)offsetof(CConfiguration, m_##Name), (int)sizeof(int), Save, false },
+#define MACRO_CONFIG_STR(Name,ScriptName,Len,Def,Save,Desc) \
+	{ #Name, #ScriptName, TYPE_STR, (int)offsetof(CConfiguration, m_##Name), Len, Save, false },
+
+#include <engine/shared/config_variables.h>
+
+#undef MACRO_CONFIG_INT
+#undef MACRO_CONFIG_STR
+	{ 0, 0, 0, 0, 0, 0, false }
+};
+
+// as large as the longest string variable
+union CStrSnapshot
+{
+#define MACRO_CONFIG_INT(Name,ScriptName,Def,Min,Max,Save,Desc)
+#define MACRO_CONFIG_STR(Name,ScriptName,Len,Def,Save,Desc) char m_a##Name[Len];
+
+#include <engine/shared/config_variables.h>
+
+#undef MACRO_CONFIG_INT
+#undef MACRO_CONFIG_STR
+};
+
+static char s_WatchersKey; // its address keys the watchers in the registry
+
+void CConfigProperties::Register(lua_State *L)
+{
+	lua_newtable(L); // Config
+
+	// name -> variable, shared by the functions below as their upvalue
+	lua_newtable(L);
+	for(int i = 0; ms_aVariables[i].m_pName; i++)
+	{
+		lua_pushlightuserdata(L, &ms_aVariables[i]);
+		lua_setfield(L, -2, ms_aVariables[i].m_pName);
+		lua_pushlightuserdata(L, &ms_aVariables[i]);
+		lua_setfield(L, -2, ms_aVariables[i].m_pScriptName);
+	}
+
+	lua_pushvalue(L, -1);
+	lua_pushcclosure(L, Watch, 1);
+	lua_setfield(L, -3, "Watch");
+	lua_pushvalue(L, -1);
+	lua_pushcclosure(L, Unwatch, 1);
+	lua_setfield(L, -3, "Unwatch");
+
+	lua_newtable(L); // metatable
+	lua_insert(L, -2);
+	lua_pushcclosure(L, Index, 1);
+	lua_setfield(L, -2, "__index");
+	lua_pushcfunction(L, NewIndex);
+	lua_setfield(L, -2, "__newindex");
+	lua_setmetatable(L, -2);
+
+	lua_setglobal(L, "Config");
+
+	lua_pushlightuserdata(L, &s_WatchersKey);
+	lua_newtable(L);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
+CConfigProperties::CVariable *CConfigProperties::Find(lua_State *L, int Index)
+{
+	lua_pushvalue(L, Index);
+	lua_rawget(L, lua_upvalueindex(1));
+	CVariable *pVar = (CVariable *)lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	return pVar;
+}
+
+void CConfigProperties::PushValue(lua_State *L, const CVariable *pVar)
+{
+	const char *pData = (const char *)&g_Config + pVar->m_Offset;
+	if(pVar->m_Type == TYPE_INT)
+		lua_pushinteger(L, *(const int *)pData);
+	else
+		lua_pushstring(L, pData);
+}
+
+int CConfigProperties::Index(lua_State *L)
+{
+	CVariable *pVar = Find(L, 2);
+	if(!pVar)
+		return 0;
+	if(!(pVar->m_Flags&CFGFLAG_SERVER))
+		return luaL_error(L, "invalid config type (this is not a server variable)");
+
+	PushValue(L, pVar);
+	return 1;
+}
+
+int CConfigProperties::NewIndex(lua_State *L)
+{
+	return luaL_error(L, "config variables are read-only, use the console to change them");
+}
+
+void CConfigProperties::PushWatchers(lua_State *L)
+{
+	lua_pushlightuserdata(L, &s_WatchersKey);
+	lua_rawget(L, LUA_REGISTRYINDEX);
+}
+
+int CConfigProperties::Watch(lua_State *L)
+{
+	CVariable *pVar = Find(L, 1);
+	if(!pVar)
+		return luaL_error(L, "unknown config variable '%s'", luaL_checkstring(L, 1));
+	if(!(pVar->m_Flags&CFGFLAG_SERVER))
+		return luaL_error(L, "invalid config type (this is not a server variable)");
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+
+	// the chain outlives the lua state, it only calls into the current one
+	if(!pVar->m_Chained)
+	{
+		CLua::Lua()->Console()->Chain(pVar->m_pScriptName, ConchainNotify, pVar);
+		pVar->m_Chained = true;
+	}
+
+	PushWatchers(L);
+	lua_pushlightuserdata(L, pVar);
+	lua_rawget(L, -2);
+	if(lua_isnil(L, -1))
+	{
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_pushlightuserdata(L, pVar);
+		lua_pushvalue(L, -2);
+		lua_rawset(L, -4);
+	}
+
+	lua_pushvalue(L, 2);
+	lua_rawseti(L, -2, (int)lua_objlen(L, -2)+1);
+	return 0;
+}
+
+int CConfigProperties::Unwatch(lua_State *L)
+{
+	CVariable *pVar = Find(L, 1);
+	if(!pVar)
+		return luaL_error(L, "unknown config variable '%s'", luaL_checkstring(L, 1));
+
+	PushWatchers(L);
+	lua_pushlightuserdata(L, pVar);
+	lua_rawget(L, -2);
+	if(lua_isnil(L, -1))
+		return 0;
+
+	int Num = (int)lua_objlen(L, -1);
+	for(int i = 1; i <= Num; i++)
+	{
+		lua_rawgeti(L, -1, i);
+		bool Match = lua_rawequal(L, -1, 2);
+		lua_pop(L, 1);
+		if(!Match)
+			continue;
+
+		// close the gap
+		for(; i < Num; i++)
+		{
+			lua_rawgeti(L, -1, i+1);
+			lua_rawseti(L, -2, i);
+		}
+		lua_pushnil(L);
+		lua_rawseti(L, -2, Num);
+		break;
+	}
+	return 0;
+}
+
+void CConfigProperties::Notify(void *pUser)
+{
+	const CVariable *pVar = (const CVariable *)pUser;
+	if(!CLua::Lua() || !CLua::Lua()->L())
+		return;
+	lua_State *L = CLua::Lua()->L();
+	int Top = lua_gettop(L);
+
+	PushWatchers(L);
+	if(lua_isnil(L, -1))
+	{
+		lua_settop(L, Top);
+		return;
+	}
+	lua_pushlightuserdata(L, (void *)pVar);
+	lua_rawget(L, -2);
+	if(lua_isnil(L, -1))
+	{
+		lua_settop(L, Top);
+		return;
+	}
+
+	// take the functions off the list first, a watcher might unwatch itself
+	int Num = (int)lua_objlen(L, -1);
+	luaL_checkstack(L, Num+4, "too many config watchers");
+	int First = lua_gettop(L)+1;
+	for(int i = 1; i <= Num; i++)
+		lua_rawgeti(L, First-1, i);
+
+	lua_pushcfunction(L, CLua::ErrorFunc);
+	int ErrorFunc = lua_gettop(L);
+	for(int i = 0; i < Num; i++)
+	{
+		lua_pushvalue(L, First+i);
+		lua_pushstring(L, pVar->m_pScriptName);
+		PushValue(L, pVar);
+		lua_pcall(L, 2, 0, ErrorFunc);
+	}
+
+	lua_settop(L, Top);
+}
+
+void CConfigProperties::ConchainNotify(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	const CVariable *pVar = (const CVariable *)pUserData;
+	const char *pData = (const char *)&g_Config + pVar->m_Offset;
+
+	// without arguments the command only prints the value
+	if(pResult->NumArguments() == 0)
+	{
+		pfnCallback(pResult, pCallbackUserData);
+		return;
+	}
+
+	char aOld[sizeof(CStrSnapshot)];
+	if(pVar->m_Type == TYPE_INT)
+		mem_copy(aOld, pData, sizeof(int));
+	else
+		str_copy(aOld, pData, pVar->m_Size);
+
+	pfnCallback(pResult, pCallbackUserData);
+
+	bool Changed = pVar->m_Type == TYPE_INT ? mem_comp(aOld, pData, sizeof(int)) != 0 : str_comp(aOld, pData) != 0;
+	// every game instance has its own watchers
+	if(Changed && CLua::Lua())
+		CLua::Lua()->Server()->ForEachInstance(Notify, (void *)pVar);
+}
@@ -1,21 +1,59 @@
 #ifndef ENGINE_SERVER_CONFIG_H
 #define ENGINE_SERVER_CONFIG_H
 
+#include <engine/console.h>
+#include <engine/lua_include.h>
 #include <engine/shared/config.h>
 
+/*
+	The Config table in lua.
 
-struct CConfigProperties
+	Config.<var_name> (both the C++ and the console name work) is looked up
+	through a table of all variables that's generated from config_variables.h,
+	with the type and the place in g_Config precomputed, so reading a value
+	is a single table lookup. Only server variables can be read.
+
+	Config.Watch(name, func) calls func(name, value) whenever the variable
+	is changed through the console, so scripts can keep the value around
+	instead of reading it every tick. Config.Unwatch(name, func) removes it.
+*/
+class CConfigProperties
 {
-#define MACRO_CONFIG_STR(Name,ScriptName,Len,Def,Save,Desc) \
-		static std::string GetConfig_##Name() { if(!((Save)&CFGFLAG_SERVER)) throw "invalid config type (this is not a server variable)"; return g_Config.m_##Name; } \
+public:
+	enum
+	{
+		TYPE_INT=0,
+		TYPE_STR,
+	};
+
+	struct CVariable
+	{
+		const char *m_pName;
+		const char *m_pScriptName;
+		int m_Type;
+		int m_Offset; // in g_Config
+		int m_Size;
+		int m_Flags;
+		bool m_Chained; // watched through the console already
+	};
+
+	static void Register(lua_State *L);
+
+private:
+	static CVariable ms_aVariables[];
 
-#define MACRO_CONFIG_INT(Name,ScriptName,Def,Min,Max,Save,Desc) \
-		static int GetConfig_##Name() { if(!((Save)&CFGFLAG_SERVER)) throw "invalid config type (this is not a server variable)"; return g_Config.m_##Name; } \
+	static CVariable *Find(lua_State *L, int Index);
+	static void PushValue(lua_State *L, const CVariable *pVar);
+	static void PushWatchers(lua_State *L);
+	/** calls the watchers of the CVariable in the active lua state */
+	static void Notify(void *pUser);
 
-#include <engine/shared/config_variables.h>
+	static int Index(lua_State *L);
+	static int NewIndex(lua_State *L);
+	static int Watch(lua_State *L);
+	static int Unwatch(lua_State *L);
 
-#undef MACRO_CONFIG_STR
-#undef MACRO_CONFIG_INT
+	static void ConchainNotify(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 };
 
 #endif
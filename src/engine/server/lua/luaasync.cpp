@@ -0,0 +1,430 @@
+#include <string>
+#include <base/math.h>
+#include <engine/engine.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+#include <engine/shared/profiler.h>
+
+#include "../lua.h"
+#include "../lua_class.h"
+#include "luaasync.h"
+#include "luasqlite.h"
+
+class CReadFileOp : public CLuaAsync::COperation
+{
+public:
+	char m_aName[512]; // as the script gave it
+	char m_aPath[512];
+	char *m_pData;
+	int m_Size;
+
+	CReadFileOp() { m_pData = 0; m_Size = -1; }
+	~CReadFileOp() { if(m_pData) mem_free(m_pData); }
+
+	void Run()
+	{
+		IOHANDLE File = io_open(m_aPath, IOFLAG_READ);
+		if(!File)
+			return;
+		int Size = (int)io_length(File);
+		m_pData = (char *)mem_alloc(max(Size, 1), 1);
+		if(Size >= 0 && (int)io_read(File, m_pData, Size) == Size)
+			m_Size = Size;
+		io_close(File);
+	}
+
+	int Push(lua_State *L)
+	{
+		if(m_Size < 0)
+		{
+			lua_pushnil(L);
+			lua_pushfstring(L, "could not read '%s'", m_aName);
+			return 2;
+		}
+		lua_pushlstring(L, m_pData, m_Size);
+		return 1;
+	}
+};
+
+class CListdirOp : public CLuaAsync::COperation
+{
+	struct CEntry
+	{
+		std::string m_Name;
+		std::string m_Path;
+		bool m_Dir;
+	};
+	std::vector<CEntry> m_lEntries;
+
+	static int Callback(const char *pName, const char *pFullPath, int IsDir, int DirType, void *pUser)
+	{
+		CEntry Entry;
+		Entry.m_Name = pName;
+		Entry.m_Path = pFullPath;
+		Entry.m_Dir = IsDir != 0;
+		((CListdirOp *)pUser)->m_lEntries.push_back(Entry);
+		return 0;
+	}
+
+public:
+	char m_aPath[512];
+
+	void Run()
+	{
+		fs_listdir_verbose(m_aPath, Callback, IStorage::TYPE_SAVE, this);
+	}
+
+	int Push(lua_State *L)
+	{
+		lua_createtable(L, (int)m_lEntries.size(), 0);
+		for(unsigned i = 0; i < m_lEntries.size(); i++)
+		{
+			lua_createtable(L, 0, 3);
+			lua_pushstring(L, m_lEntries[i].m_Name.c_str());
+			lua_setfield(L, -2, "name");
+			lua_pushstring(L, m_lEntries[i].m_Path.c_str());
+			lua_setfield(L, -2, "path");
+			lua_pushboolean(L, m_lEntries[i].m_Dir);
+			lua_setfield(L, -2, "dir");
+			lua_rawseti(L, -2, i+1);
+		}
+		return 1;
+	}
+};
+
+class CQueryOp : public CLuaAsync::COperation
+{
+	struct CValue
+	{
+		int m_Type; // SQLITE_*
+		double m_Number;
+		std::string m_Text;
+	};
+
+	// copies the rows out while the statement is still alive
+	class CCollectQuery : public CQuery
+	{
+		CQueryOp *m_pOp;
+
+	public:
+		CCollectQuery(char *pQueryBuf, CQueryOp *pOp) : CQuery(pQueryBuf), m_pOp(pOp) {}
+
+		void OnData()
+		{
+			int NumColumns = GetColumnCount();
+			for(int i = 0; i < NumColumns; i++)
+				m_pOp->m_lColumns.push_back(GetName(i));
+
+			while(Next())
+			{
+				for(int i = 0; i < NumColumns; i++)
+				{
+					CValue Value;
+					Value.m_Type = GetType(i);
+					Value.m_Number = 0;
+					if(Value.m_Type == SQLITE_INTEGER)
+						Value.m_Number = (double)GetInt64(i);
+					else if(Value.m_Type == SQLITE_FLOAT)
+						Value.m_Number = GetDouble(i);
+					else if(Value.m_Type != SQLITE_NULL)
+						Value.m_Text.assign((const char *)GetBlob(i), GetSize(i));
+					m_pOp->m_lValues.push_back(Value);
+				}
+			}
+		}
+	};
+
+	std::vector<std::string> m_lColumns;
+	std::vector<CValue> m_lValues; // row after row
+
+public:
+	CSql *m_pDb;
+	char *m_pStatement; // sqlite3_malloc'ed, the query frees it
+
+	void Run()
+	{
+		m_pDb->InsertQuerySync(new CCollectQuery(m_pStatement, this));
+	}
+
+	int Push(lua_State *L)
+	{
+		int NumColumns = (int)m_lColumns.size();
+		int NumRows = NumColumns ? (int)m_lValues.size()/NumColumns : 0;
+		lua_createtable(L, NumRows, 0);
+		for(int r = 0; r < NumRows; r++)
+		{
+			lua_createtable(L, 0, NumColumns);
+			for(int c = 0; c < NumColumns; c++)
+			{
+				const CValue *pValue = &m_lValues[r*NumColumns+c];
+				if(pValue->m_Type == SQLITE_NULL)
+					continue;
+				if(pValue->m_Type == SQLITE_INTEGER || pValue->m_Type == SQLITE_FLOAT)
+					lua_pushnumber(L, pValue->m_Number);
+				else
+					lua_pushlstring(L, pValue->m_Text.data(), pValue->m_Text.size());
+				lua_setfield(L, -2, m_lColumns[c].c_str());
+			}
+			lua_rawseti(L, -2, r+1);
+		}
+		return 1;
+	}
+};
+
+
+CLuaAsync::CLuaAsync()
+{
+	m_pLua = 0;
+	m_pEngine = 0;
+	m_pCurrent = 0;
+}
+
+void CLuaAsync::Init(lua_State *L, IEngine *pEngine)
+{
+	m_pLua = L;
+	m_pEngine = pEngine;
+	m_pCurrent = 0;
+}
+
+void CLuaAsync::Shutdown()
+{
+	for(unsigned i = 0; i < m_lpTasks.size(); i++)
+	{
+		COperation *pOp = m_lpTasks[i]->m_pOp;
+		if(pOp)
+		{
+			while(pOp->m_Job.Status() != CJob::STATE_DONE)
+				thread_sleep(1);
+			delete pOp;
+		}
+		if(m_lpTasks[i]->m_pOwner)
+			m_lpTasks[i]->m_pOwner->m_NumAsyncTasks--;
+		delete m_lpTasks[i];
+	}
+	m_lpTasks.clear();
+	m_pCurrent = 0;
+	m_pLua = 0;
+}
+
+int CLuaAsync::JobFunc(void *pUser)
+{
+	((COperation *)pUser)->Run();
+	return 0;
+}
+
+void CLuaAsync::Release(CTask *pTask)
+{
+	luaL_unref(m_pLua, LUA_REGISTRYINDEX, pTask->m_Ref);
+	luaL_unref(m_pLua, LUA_REGISTRYINDEX, pTask->m_SelfRef);
+	luaL_unref(m_pLua, LUA_REGISTRYINDEX, pTask->m_ThisRef);
+	if(pTask->m_pOwner)
+		pTask->m_pOwner->m_NumAsyncTasks--;
+	pTask->m_pOwner = 0;
+	pTask->m_pThread = 0;
+}
+
+bool CLuaAsync::Resume(CTask *pTask, int NumArgs)
+{
+	lua_State *L = m_pLua;
+
+	// the event that started it has long returned, give it back its environment
+	lua_getglobal(L, "self");
+	lua_getglobal(L, "this");
+	lua_rawgeti(L, LUA_REGISTRYINDEX, pTask->m_SelfRef);
+	lua_setglobal(L, "self");
+	lua_rawgeti(L, LUA_REGISTRYINDEX, pTask->m_ThisRef);
+	lua_setglobal(L, "this");
+
+	CTask *pPrev = m_pCurrent;
+	m_pCurrent = pTask;
+	int Status;
+	{
+		CLuaWatchdog::CScope WatchdogScope(CLua::Lua()->Watchdog(), pTask->m_aClass);
+		Status = lua_resume(pTask->m_pThread, NumArgs);
+	}
+	m_pCurrent = pPrev;
+
+	if(Status != 0 && Status != LUA_YIELD)
+	{
+		lua_xmove(pTask->m_pThread, L, 1);
+		luabridge::LuaException e(L, Status);
+		CLua::HandleException(e);
+	}
+
+	lua_setglobal(L, "this");
+	lua_setglobal(L, "self");
+
+	// its owner may have been destroyed while it ran
+	if(Status == LUA_YIELD && !pTask->m_Stopped)
+	{
+		// nobody takes what a plain coroutine.yield() passes
+		lua_settop(pTask->m_pThread, 0);
+		return true;
+	}
+
+	Release(pTask);
+	return false;
+}
+
+int CLuaAsync::Await(lua_State *L, COperation *pOp)
+{
+	if(!m_pCurrent || m_pCurrent->m_pThread != L || !m_pEngine)
+	{
+		pOp->Run();
+		int NumResults = pOp->Push(L);
+		delete pOp;
+		return NumResults;
+	}
+
+	m_pCurrent->m_pOp = pOp;
+	m_pEngine->AddJob(&pOp->m_Job, JobFunc, pOp);
+	return lua_yield(L, 0);
+}
+
+void CLuaAsync::Tick()
+{
+	if(m_lpTasks.empty())
+		return;
+
+	PROFILE_SCOPE(PHASE_LUA);
+	int64 Deadline = time_get()+time_freq()*g_Config.m_SvLuaAsyncBudget/1000000;
+	bool Resumed = false;
+
+	// the ones started while resuming have already run once
+	unsigned Num = m_lpTasks.size();
+	for(unsigned i = 0; i < Num; i++)
+	{
+		CTask *pTask = m_lpTasks[i];
+		if(pTask->m_Stopped && pTask->m_pThread)
+			Release(pTask);
+		if(!pTask->m_pThread || (pTask->m_pOp && pTask->m_pOp->m_Job.Status() != CJob::STATE_DONE))
+			continue;
+		// waits for the watchdog to enable the class again
+		if(CLua::Lua()->Watchdog()->IsDisabled(pTask->m_aClass))
+			continue;
+
+		// at least one a tick, so that a tiny budget can't hold everything up
+		if(Resumed && time_get() >= Deadline)
+			break;
+		Resumed = true;
+
+		int NumArgs = 0;
+		if(pTask->m_pOp)
+		{
+			NumArgs = pTask->m_pOp->Push(pTask->m_pThread);
+			delete pTask->m_pOp;
+			pTask->m_pOp = 0;
+		}
+		Resume(pTask, NumArgs);
+	}
+
+	// a stopped task may still have its operation running on the job thread
+	unsigned Alive = 0;
+	for(unsigned i = 0; i < m_lpTasks.size(); i++)
+	{
+		CTask *pTask = m_lpTasks[i];
+		if(pTask->m_pThread || (pTask->m_pOp && pTask->m_pOp->m_Job.Status() != CJob::STATE_DONE))
+			m_lpTasks[Alive++] = pTask;
+		else
+		{
+			delete pTask->m_pOp;
+			delete pTask;
+		}
+	}
+	m_lpTasks.resize(Alive);
+}
+
+void CLuaAsync::StopOwner(CLuaClass *pOwner)
+{
+	// a task can't be dropped while it runs, Resume() and Tick() release it
+	for(unsigned i = 0; i < m_lpTasks.size(); i++)
+	{
+		CTask *pTask = m_lpTasks[i];
+		if(pTask->m_pOwner != pOwner)
+			continue;
+		pTask->m_pOwner = 0;
+		pTask->m_Stopped = true;
+	}
+	pOwner->m_NumAsyncTasks = 0;
+}
+
+int CLuaAsync::LuaRun(lua_State *L)
+{
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	CLuaAsync *pSelf = CLua::Lua()->Async();
+	int NumArgs = lua_gettop(L)-1;
+
+	CTask *pTask = new CTask;
+	pTask->m_pOp = 0;
+	pTask->m_Stopped = false;
+
+	// the object of the event it was started from owns it, see CLuaTimers::LuaStart
+	pTask->m_pOwner = 0;
+	lua_getglobal(L, "self");
+	if(lua_istable(L, -1))
+	{
+		lua_pushstring(L, "__dbgLC");
+		lua_rawget(L, -2);
+		if(lua_isuserdata(L, -1))
+			pTask->m_pOwner = const_cast<CLuaClass *>(luabridge::Stack<const CLuaClass *>::get(L, lua_gettop(L)));
+		lua_pop(L, 1);
+	}
+	pTask->m_SelfRef = luaL_ref(L, LUA_REGISTRYINDEX);
+	lua_getglobal(L, "this");
+	pTask->m_ThisRef = luaL_ref(L, LUA_REGISTRYINDEX);
+	if(pTask->m_pOwner)
+		pTask->m_pOwner->m_NumAsyncTasks++;
+
+	str_copyb(pTask->m_aClass, pSelf->m_pCurrent ? pSelf->m_pCurrent->m_aClass : CLua::Lua()->Watchdog()->CurrentClass());
+	if(pTask->m_aClass[0] == '\0')
+		str_copyb(pTask->m_aClass, "async");
+	pTask->m_pThread = lua_newthread(L);
+	lua_insert(L, 1);
+	lua_xmove(L, pTask->m_pThread, NumArgs+1); // the function and its arguments
+	pTask->m_Ref = luaL_ref(L, LUA_REGISTRYINDEX); // pops the thread
+	pSelf->m_lpTasks.push_back(pTask);
+
+	lua_pushboolean(L, pSelf->Resume(pTask, NumArgs));
+	return 1;
+}
+
+int CLuaAsync::LuaReadFile(lua_State *L)
+{
+	const char *pFilename = luaL_checkstring(L, 1);
+	bool Shared = lua_toboolean(L, 2);
+
+	// same sandbox as io.open
+	char aFilename[512];
+	str_copyb(aFilename, pFilename);
+	pFilename = CLua::Lua()->Storage()->SandboxPathMod(aFilename, sizeof(aFilename), Shared ? "_shared" : g_Config.m_SvGametype);
+
+	CReadFileOp *pOp = new CReadFileOp;
+	str_copyb(pOp->m_aName, lua_tostring(L, 1));
+	CLua::Lua()->Storage()->GetCompletePath(IStorage::TYPE_SAVE, pFilename, pOp->m_aPath, sizeof(pOp->m_aPath));
+	return CLua::Lua()->Async()->Await(L, pOp);
+}
+
+int CLuaAsync::LuaListdir(lua_State *L)
+{
+	CListdirOp *pOp = new CListdirOp;
+	str_copyb(pOp->m_aPath, luaL_checkstring(L, 1));
+	CLua::Lua()->Storage()->SandboxPathMod(pOp->m_aPath, sizeof(pOp->m_aPath), g_Config.m_SvGametype, true);
+	return CLua::Lua()->Async()->Await(L, pOp);
+}
+
+int CLuaAsync::LuaQuery(lua_State *L)
+{
+	CLuaSqlite *pDb = luabridge::Stack<CLuaSqlite *>::get(L, 1);
+	const char *pStatement = luaL_checkstring(L, 2);
+	if(!pDb)
+		return luaL_error(L, "Query expects a database as first parameter");
+	if(pStatement[0] == '\0')
+		return luaL_error(L, "Empty statement");
+
+	int Length = str_length(pStatement);
+	CQueryOp *pOp = new CQueryOp;
+	pOp->m_pDb = pDb->Db();
+	pOp->m_pStatement = (char *)sqlite3_malloc(Length+1);
+	str_copy(pOp->m_pStatement, pStatement, Length+1);
+	return CLua::Lua()->Async()->Await(L, pOp);
+}
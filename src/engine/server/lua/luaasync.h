@@ -0,0 +1,93 @@
+#ifndef ENGINE_SERVER_LUA_LUAASYNC_H
+#define ENGINE_SERVER_LUA_LUAASYNC_H
+
+#include <vector>
+#include <base/system.h>
+#include <engine/shared/jobs.h>
+#include <engine/lua_include.h>
+
+/*
+	Coroutines for script work that would otherwise block the tick.
+
+	async.Run(func, ...) runs func in a coroutine of its own. When it calls
+	one of the async functions, the operation is handed to the engine's job
+	thread and the coroutine yields; once the job is done, Tick() resumes it
+	with the results as the return values of that call. A plain
+	coroutine.yield() waits for the next tick.
+
+	Outside of a coroutine started by async.Run the operations simply run
+	right away, so the same code works in both places.
+
+	A coroutine started from an event gets the self and this of that event
+	back whenever it is resumed, and is dropped when that object is
+	destroyed.
+
+	Tick() resumes the finished coroutines oldest first until
+	sv_lua_async_budget is used up, the rest wait for the next tick.
+*/
+class CLuaAsync
+{
+public:
+	// Run() happens on the job thread and must not touch lua, Push() hands the results to the coroutine
+	class COperation
+	{
+	public:
+		CJob m_Job;
+
+		virtual ~COperation() {}
+		virtual void Run() = 0;
+		/** returns the number of values pushed */
+		virtual int Push(lua_State *L) = 0;
+	};
+
+private:
+	struct CTask
+	{
+		lua_State *m_pThread; // 0 once it finished
+		int m_Ref; // keeps the coroutine alive
+		COperation *m_pOp; // 0 if it only waits for the next tick
+		char m_aClass[64]; // whose callback started it, for the watchdog
+		class CLuaClass *m_pOwner; // the object of that callback, 0 if none
+		int m_SelfRef; // self and this of that callback, set again for every resume
+		int m_ThisRef;
+		bool m_Stopped; // the owner is gone, drop it instead of resuming it
+	};
+
+	lua_State *m_pLua;
+	class IEngine *m_pEngine;
+	std::vector<CTask *> m_lpTasks;
+	CTask *m_pCurrent; // the task being resumed
+
+	static int JobFunc(void *pUser);
+
+	/** returns false if the coroutine finished (or failed) */
+	bool Resume(CTask *pTask, int NumArgs);
+	void Release(CTask *pTask);
+	/** yields the current coroutine until pOp is done, or runs it right away, takes over pOp */
+	int Await(lua_State *L, COperation *pOp);
+
+public:
+	CLuaAsync();
+
+	void Init(lua_State *L, class IEngine *pEngine);
+	/** waits for the operations in flight and drops every coroutine, the lua state is about to be closed */
+	void Shutdown();
+
+	void Tick();
+	/** drops the coroutines started from the events of the object, which is being destroyed */
+	void StopOwner(class CLuaClass *pOwner);
+
+	int NumTasks() const { return (int)m_lpTasks.size(); }
+
+	// lua
+	/** async.Run(func, ...), returns whether func is still running */
+	static int LuaRun(lua_State *L);
+	/** async.ReadFile(path[, shared]), the whole file as a string or nil and an error message */
+	static int LuaReadFile(lua_State *L);
+	/** async.Listdir(path), an array of { name=, path=, dir= } */
+	static int LuaListdir(lua_State *L);
+	/** async.Query(db, statement), an array of rows keyed by column name */
+	static int LuaQuery(lua_State *L);
+};
+
+#endif
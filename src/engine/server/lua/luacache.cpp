@@ -0,0 +1,181 @@
+#include <base/math.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+
+#include "luacache.h"
+
+static const char s_aMagic[4] = {'T', 'W', 'B', 'C'};
+
+// an entry is this header, the source path and then the bytecode
+struct CEntryHeader
+{
+	char m_aMagic[4];
+	int m_Format;
+	int m_VMVersion;
+	int m_PointerSize;
+	int64 m_Modified;
+	int64 m_SourceSize;
+	int m_PathLength;
+	int m_DataSize;
+};
+
+static void FillHeader(CEntryHeader *pHeader, const char *pSourcePath, int64 Modified, int64 Size)
+{
+	mem_zero(pHeader, sizeof(*pHeader));
+	mem_copy(pHeader->m_aMagic, s_aMagic, sizeof(s_aMagic));
+	pHeader->m_Format = CLuaBytecodeCache::FORMAT_VERSION;
+	pHeader->m_VMVersion = LUAJIT_VERSION_NUM;
+	pHeader->m_PointerSize = sizeof(void *);
+	pHeader->m_Modified = Modified;
+	pHeader->m_SourceSize = Size;
+	pHeader->m_PathLength = str_length(pSourcePath);
+}
+
+struct CDumpBuffer
+{
+	char *m_pData;
+	int m_Size;
+	int m_Capacity;
+};
+
+static int DumpWriter(lua_State *L, const void *pData, size_t Size, void *pUser)
+{
+	CDumpBuffer *pBuf = (CDumpBuffer *)pUser;
+	if(pBuf->m_Size+(int)Size > pBuf->m_Capacity)
+	{
+		int NewCapacity = max(pBuf->m_Capacity*2, pBuf->m_Size+(int)Size);
+		char *pNew = (char *)mem_alloc(NewCapacity, 1);
+		if(pBuf->m_pData)
+		{
+			mem_copy(pNew, pBuf->m_pData, pBuf->m_Size);
+			mem_free(pBuf->m_pData);
+		}
+		pBuf->m_pData = pNew;
+		pBuf->m_Capacity = NewCapacity;
+	}
+	mem_copy(pBuf->m_pData+pBuf->m_Size, pData, Size);
+	pBuf->m_Size += (int)Size;
+	return 0;
+}
+
+CLuaBytecodeCache::CLuaBytecodeCache()
+{
+	m_pStorage = 0;
+	ResetStats();
+}
+
+void CLuaBytecodeCache::Init(IStorage *pStorage)
+{
+	m_pStorage = pStorage;
+	m_pStorage->CreateFolder("lua", IStorage::TYPE_SAVE);
+	m_pStorage->CreateFolder("lua/bytecode", IStorage::TYPE_SAVE);
+}
+
+void CLuaBytecodeCache::EntryName(const char *pSourcePath, char *pBuffer, int BufferSize) const
+{
+	// collisions are caught by the path stored in the entry
+	str_format(pBuffer, BufferSize, "lua/bytecode/%08x.luac", str_quickhash(pSourcePath));
+}
+
+int CLuaBytecodeCache::Load(lua_State *L, const char *pSourcePath)
+{
+	int64 Start = time_get();
+
+	int64 Modified, Size;
+	if(!m_pStorage || !g_Config.m_SvLuaBytecodeCache || fs_file_info(pSourcePath, &Modified, &Size) != 0)
+	{
+		m_Stats.m_Misses++;
+		int Status = luaL_loadfile(L, pSourcePath);
+		m_Stats.m_Time += time_get()-Start;
+		return Status;
+	}
+
+	if(LoadEntry(L, pSourcePath, Modified, Size))
+	{
+		m_Stats.m_Hits++;
+		m_Stats.m_Time += time_get()-Start;
+		return 0;
+	}
+
+	m_Stats.m_Misses++;
+	int Status = luaL_loadfile(L, pSourcePath);
+	if(Status == 0)
+		WriteEntry(L, pSourcePath, Modified, Size);
+	m_Stats.m_Time += time_get()-Start;
+	return Status;
+}
+
+bool CLuaBytecodeCache::LoadEntry(lua_State *L, const char *pSourcePath, int64 Modified, int64 Size)
+{
+	char aName[64];
+	EntryName(pSourcePath, aName, sizeof(aName));
+	IOHANDLE File = m_pStorage->OpenFile(aName, IOFLAG_READ, IStorage::TYPE_SAVE);
+	if(!File)
+		return false;
+
+	CEntryHeader Expected, Header;
+	FillHeader(&Expected, pSourcePath, Modified, Size);
+	if(io_read(File, &Header, sizeof(Header)) != sizeof(Header) || Header.m_DataSize <= 0)
+	{
+		io_close(File);
+		return false;
+	}
+	Expected.m_DataSize = Header.m_DataSize;
+	if(mem_comp(&Header, &Expected, sizeof(Header)) != 0)
+	{
+		io_close(File);
+		return false;
+	}
+
+	int Total = Header.m_PathLength+Header.m_DataSize;
+	char *pData = (char *)mem_alloc(Total, 1);
+	bool Valid = (int)io_read(File, pData, Total) == Total && mem_comp(pData, pSourcePath, Header.m_PathLength) == 0;
+	io_close(File);
+
+	if(Valid)
+	{
+		char aChunkName[512];
+		str_format(aChunkName, sizeof(aChunkName), "@%s", pSourcePath);
+		if(luaL_loadbuffer(L, pData+Header.m_PathLength, Header.m_DataSize, aChunkName) != 0)
+		{
+			dbg_msg("lua/cache", "dropping unusable bytecode of '%s': %s", pSourcePath, lua_tostring(L, -1));
+			lua_pop(L, 1);
+			Valid = false;
+		}
+	}
+	mem_free(pData);
+	return Valid;
+}
+
+void CLuaBytecodeCache::WriteEntry(lua_State *L, const char *pSourcePath, int64 Modified, int64 Size)
+{
+	CDumpBuffer Buf = { 0, 0, 0 };
+	if(lua_dump(L, DumpWriter, &Buf) != 0 || Buf.m_Size == 0)
+	{
+		if(Buf.m_pData)
+			mem_free(Buf.m_pData);
+		return;
+	}
+
+	CEntryHeader Header;
+	FillHeader(&Header, pSourcePath, Modified, Size);
+	Header.m_DataSize = Buf.m_Size;
+
+	// write next to it and swap, so a crash never leaves half an entry behind
+	char aName[64], aTempName[64];
+	EntryName(pSourcePath, aName, sizeof(aName));
+	str_format(aTempName, sizeof(aTempName), "%s.tmp", aName);
+	IOHANDLE File = m_pStorage->OpenFile(aTempName, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(File)
+	{
+		bool Written = io_write(File, &Header, sizeof(Header)) == sizeof(Header) &&
+			(int)io_write(File, pSourcePath, Header.m_PathLength) == Header.m_PathLength &&
+			(int)io_write(File, Buf.m_pData, Buf.m_Size) == Buf.m_Size;
+		io_close(File);
+
+		m_pStorage->RemoveFile(aName, IStorage::TYPE_SAVE);
+		if(!Written || !m_pStorage->RenameFile(aTempName, aName, IStorage::TYPE_SAVE))
+			m_pStorage->RemoveFile(aTempName, IStorage::TYPE_SAVE);
+	}
+	mem_free(Buf.m_pData);
+}
@@ -0,0 +1,52 @@
+#ifndef ENGINE_SERVER_LUA_LUACACHE_H
+#define ENGINE_SERVER_LUA_LUACACHE_H
+
+#include <base/system.h>
+#include <engine/lua_include.h>
+
+/*
+	Keeps the compiled bytecode of the gametype scripts in the save
+	directory (lua/bytecode/), so a map change or lua_reinit doesn't have to
+	parse every file again.
+
+	An entry belongs to a source file through its path and is only used
+	while the modification time, the size and the LuaJIT version it was
+	compiled with still match. Anything else, including a broken entry, falls
+	back to the source and writes a fresh entry.
+*/
+class CLuaBytecodeCache
+{
+public:
+	enum
+	{
+		FORMAT_VERSION=1,
+	};
+
+	struct CStats
+	{
+		int m_Hits;
+		int m_Misses;
+		int64 m_Time; // spent in Load
+	};
+
+private:
+	class IStorage *m_pStorage;
+	CStats m_Stats;
+
+	void EntryName(const char *pSourcePath, char *pBuffer, int BufferSize) const;
+	bool LoadEntry(lua_State *L, const char *pSourcePath, int64 Modified, int64 Size);
+	void WriteEntry(lua_State *L, const char *pSourcePath, int64 Modified, int64 Size);
+
+public:
+	CLuaBytecodeCache();
+
+	void Init(class IStorage *pStorage);
+
+	/** like luaL_loadfile: pushes the compiled chunk or an error message and returns the lua status */
+	int Load(lua_State *L, const char *pSourcePath);
+
+	void ResetStats() { mem_zero(&m_Stats, sizeof(m_Stats)); }
+	const CStats *Stats() const { return &m_Stats; }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include <stddef.h>
+
+#include <base/system.h>
+#include <engine/server.h>
+#include <game/collision.h>
+#include <game/server/entity.h>
+#include <game/server/gamecontext.h>
+
+#include "../lua.h"
+#include "luaffi.h"
+
+// the declarations in ffiapi.lua rely on these layouts
+static_assert(sizeof(tw_vec2) == sizeof(vec2), "tw_vec2 must match vec2");
+static_assert(offsetof(CGameWorld::CEntityInfo, m_pEntity) == 0 && offsetof(CGameWorld::CEntityInfo, m_Pos) == sizeof(void *) &&
+	offsetof(CGameWorld::CEntityInfo, m_CID) == sizeof(void *)+4*sizeof(float)+3*sizeof(int), "tw_entity_info must match CGameWorld::CEntityInfo");
+
+IServer *CLuaFFI::Server() { return CLua::Lua()->Server(); }
+CGameContext *CLuaFFI::GameServer() { return CLua::Lua()->GameServer(); }
+CCollision *CLuaFFI::Collision() { return CLua::Lua()->GameServer()->Collision(); }
+
+extern "C"
+{
+
+double tw_time(void)
+{
+	return time_get()/(double)time_freq();
+}
+
+int tw_tick(void)
+{
+	return CLuaFFI::Server()->Tick();
+}
+
+int tw_tickspeed(void)
+{
+	return CLuaFFI::Server()->TickSpeed();
+}
+
+int tw_col_check_point(float x, float y)
+{
+	return CLuaFFI::Collision()->CheckPoint(x, y);
+}
+
+int tw_col_get_tile(float x, float y)
+{
+	return CLuaFFI::Collision()->GetCollisionAt(x, y);
+}
+
+int tw_col_intersect_line(float x0, float y0, float x1, float y1, tw_vec2 *pOutCollision, tw_vec2 *pOutBeforeCollision)
+{
+	return CLuaFFI::Collision()->IntersectLine(vec2(x0, y0), vec2(x1, y1), (vec2 *)pOutCollision, (vec2 *)pOutBeforeCollision);
+}
+
+int tw_col_test_box(float x, float y, float w, float h)
+{
+	return CLuaFFI::Collision()->TestBox(vec2(x, y), vec2(w, h));
+}
+
+void tw_col_move_box(tw_vec2 *pInoutPos, tw_vec2 *pInoutVel, float w, float h, float Elasticity)
+{
+	CLuaFFI::Collision()->MoveBox((vec2 *)pInoutPos, (vec2 *)pInoutVel, vec2(w, h), Elasticity);
+}
+
+void tw_entity_get_pos(void *pEntity, tw_vec2 *pOut)
+{
+	const CEntity *pEnt = (const CEntity *)pEntity;
+	pOut->x = pEnt->m_Pos.x;
+	pOut->y = pEnt->m_Pos.y;
+}
+
+void tw_entity_set_pos(void *pEntity, float x, float y)
+{
+	((CEntity *)pEntity)->m_Pos = vec2(x, y);
+}
+
+int tw_world_query(int Type, float x, float y, float Radius, void *pOutInfos, int Max)
+{
+	return CLuaFFI::GameServer()->m_World.Query(Type, vec2(x, y), Radius, (CGameWorld::CEntityInfo *)pOutInfos, Max);
+}
+
+}
+
+void CLuaFFI::Register(lua_State *L)
+{
+	#define EXPORT(Func) { #Func, (void *)Func }
+	static const struct { const char *m_pName; void *m_pFunc; } s_aExports[] = {
+		EXPORT(tw_time),
+		EXPORT(tw_tick),
+		EXPORT(tw_tickspeed),
+		EXPORT(tw_col_check_point),
+		EXPORT(tw_col_get_tile),
+		EXPORT(tw_col_intersect_line),
+		EXPORT(tw_col_test_box),
+		EXPORT(tw_col_move_box),
+		EXPORT(tw_entity_get_pos),
+		EXPORT(tw_entity_set_pos),
+		EXPORT(tw_world_query),
+	};
+	#undef EXPORT
+
+	lua_newtable(L);
+	for(unsigned i = 0; i < sizeof(s_aExports)/sizeof(s_aExports[0]); i++)
+	{
+		lua_pushlightuserdata(L, s_aExports[i].m_pFunc);
+		lua_setfield(L, -2, s_aExports[i].m_pName);
+	}
+	lua_pushcfunction(L, EntityPtr);
+	lua_setfield(L, -2, "EntityPtr");
+	lua_setglobal(L, "_ENGINE_FFI");
+}
+
+int CLuaFFI::EntityPtr(lua_State *L)
+{
+	CEntity *pEnt = luabridge::Stack<CEntity *>::get(L, 1);
+	if(!pEnt)
+		return luaL_argerror(L, 1, "entity expected");
+	lua_pushlightuserdata(L, pEnt);
+	return 1;
+}
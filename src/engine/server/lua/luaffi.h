@@ -0,0 +1,53 @@
+#ifndef ENGINE_SERVER_LUA_LUAFFI_H
+#define ENGINE_SERVER_LUA_LUAFFI_H
+
+#include <engine/lua_include.h>
+
+/*
+	Plain C entry points for the hottest engine calls, for use through the
+	LuaJIT FFI. Calls through luabridge are C functions the JIT can't trace
+	through, so a loop that touches them falls back to the interpreter.
+	Calls to these compile into the trace.
+
+	They are handed to lua as function pointers in the _ENGINE_FFI table
+	rather than looked up in the executable, which would need the symbols
+	exported on every platform. lua/modules/ffiapi.lua holds the matching
+	declarations and is what scripts should use.
+
+	Entity pointers are raw: only use them in the tick they were queried in.
+*/
+
+extern "C"
+{
+	struct tw_vec2 { float x, y; };
+
+	double tw_time(void);
+	int tw_tick(void);
+	int tw_tickspeed(void);
+
+	int tw_col_check_point(float x, float y);
+	int tw_col_get_tile(float x, float y);
+	int tw_col_intersect_line(float x0, float y0, float x1, float y1, tw_vec2 *pOutCollision, tw_vec2 *pOutBeforeCollision);
+	int tw_col_test_box(float x, float y, float w, float h);
+	void tw_col_move_box(tw_vec2 *pInoutPos, tw_vec2 *pInoutVel, float w, float h, float Elasticity);
+
+	void tw_entity_get_pos(void *pEntity, tw_vec2 *pOut);
+	void tw_entity_set_pos(void *pEntity, float x, float y);
+	int tw_world_query(int Type, float x, float y, float Radius, void *pOutInfos, int Max);
+}
+
+class CLuaFFI
+{
+public:
+	/** creates the _ENGINE_FFI table */
+	static void Register(lua_State *L);
+	/** the raw pointer of an entity as lightuserdata, for the tw_entity_* functions */
+	static int EntityPtr(lua_State *L);
+
+	// for the exports
+	static class IServer *Server();
+	static class CGameContext *GameServer();
+	static class CCollision *Collision();
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include <base/math.h>
+#include <engine/shared/config.h>
+#include <engine/shared/profiler.h>
+
+#include "luagc.h"
+
+CLuaGC::CLuaGC()
+{
+	m_pLua = 0;
+	m_Stopped = false;
+	Init(0);
+}
+
+int64 CLuaGC::Memory() const
+{
+	return (int64)lua_gc(m_pLua, LUA_GCCOUNT, 0)*1024 + lua_gc(m_pLua, LUA_GCCOUNTB, 0);
+}
+
+void CLuaGC::Init(lua_State *L)
+{
+	m_pLua = L;
+	m_Paced = false;
+	m_InCycle = false;
+	m_Debt = 0;
+	mem_zero(&m_Stats, sizeof(m_Stats));
+	m_LastMemory = 0;
+
+	if(!L)
+		return;
+
+	if(m_Stopped)
+		lua_gc(L, LUA_GCSTOP, 0);
+	m_Stats.m_LiveMemory = m_LastMemory = Memory();
+}
+
+void CLuaGC::FullCollect()
+{
+	int64 Start = time_get();
+	lua_gc(m_pLua, LUA_GCCOLLECT, 0);
+	int64 Pause = time_get()-Start;
+
+	int64 Memory = CLuaGC::Memory();
+	dbg_msg("lua/gc", "incremental steps fell behind, full collection took %.2fms (%d KB -> %d KB)",
+			Pause*1000.0/time_freq(), (int)(m_LastMemory/1024), (int)(Memory/1024));
+
+	m_Stats.m_FullCollects++;
+	m_Stats.m_LastFullPause = Pause;
+	m_Stats.m_LiveMemory = Memory;
+	m_InCycle = false;
+	m_Debt = 0;
+}
+
+void CLuaGC::Step(int64 Deadline)
+{
+	if(!m_pLua || m_Stopped)
+		return;
+
+	if(g_Config.m_SvLuaGcBudget == 0)
+	{
+		// hand the pacing back to lua
+		if(m_Paced)
+		{
+			lua_gc(m_pLua, LUA_GCRESTART, 0);
+			m_Paced = false;
+		}
+		return;
+	}
+
+	PROFILE_SCOPE(PHASE_GC);
+	int64 Start = time_get();
+	if(!m_Paced)
+	{
+		m_LastMemory = CLuaGC::Memory();
+		m_Paced = true;
+	}
+
+	// nothing gets freed outside of the collector, so the growth is what was allocated
+	int64 Memory = CLuaGC::Memory();
+	int64 Alloc = max(Memory-m_LastMemory, (int64)0);
+	m_Stats.m_AllocRate = (m_Stats.m_AllocRate*7 + Alloc)/8;
+	m_LastMemory = Memory;
+
+	if(Memory >= max((int64)MIN_MEMORY, m_Stats.m_LiveMemory*g_Config.m_SvLuaGcBackstop/100))
+		FullCollect();
+	else
+	{
+		if(!m_InCycle && Memory*100 >= m_Stats.m_LiveMemory*PAUSE)
+			m_InCycle = true;
+
+		if(m_InCycle)
+		{
+			// size the work after the smoothed allocation rate so that a single
+			// spike is paid off over the next frames instead of in one go
+			m_Debt = min(m_Debt + max(m_Stats.m_AllocRate*STEPMUL, (int64)STEP_WORK), Memory*STEPMUL);
+			do
+			{
+				m_Stats.m_Steps++;
+				m_Debt -= STEP_WORK;
+				if(lua_gc(m_pLua, LUA_GCSTEP, 0))
+				{
+					m_Stats.m_Cycles++;
+					m_Stats.m_LiveMemory = CLuaGC::Memory();
+					m_InCycle = false;
+					m_Debt = 0;
+					break;
+				}
+			}
+			while(m_Debt > 0 && time_get() < Deadline);
+		}
+	}
+
+	// every step (and anything else that ran the collector) rearms the automatic threshold
+	lua_gc(m_pLua, LUA_GCSTOP, 0);
+	m_LastMemory = CLuaGC::Memory();
+
+	int64 Time = time_get()-Start;
+	m_Stats.m_Time += Time;
+	if(Time > m_Stats.m_MaxPause)
+		m_Stats.m_MaxPause = Time;
+}
+
+void CLuaGC::Stop()
+{
+	m_Stopped = true;
+	if(m_pLua)
+		lua_gc(m_pLua, LUA_GCSTOP, 0);
+}
+
+void CLuaGC::Restart()
+{
+	m_Stopped = false;
+	m_Paced = false;
+	if(m_pLua)
+		lua_gc(m_pLua, LUA_GCRESTART, 0);
+}
+
+const CLuaGC::CStats *CLuaGC::Stats()
+{
+	m_Stats.m_Memory = m_pLua ? Memory() : 0;
+	return &m_Stats;
+}
+
+void CLuaGC::ResetStats()
+{
+	int64 Live = m_Stats.m_LiveMemory;
+	mem_zero(&m_Stats, sizeof(m_Stats));
+	m_Stats.m_LiveMemory = Live;
+}
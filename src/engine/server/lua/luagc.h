@@ -0,0 +1,71 @@
+#ifndef ENGINE_SERVER_LUA_LUAGC_H
+#define ENGINE_SERVER_LUA_LUAGC_H
+
+#include <base/system.h>
+#include <engine/lua_include.h>
+
+/*
+	Paces the lua garbage collector from the server loop instead of letting
+	lua run its steps whenever an allocation crosses the threshold, which puts
+	whole cycles into random ticks.
+
+	The automatic collector is stopped and Step() is called once per server
+	frame with a deadline: it runs incremental steps until the work owed for
+	the memory allocated since the last frame is paid off or the deadline is
+	hit. A new cycle only starts once the memory grew by PAUSE percent over what
+	was alive after the last one. Should the steps fall behind anyway, a full
+	collection is forced once the memory reaches sv_lua_gc_backstop percent.
+
+	With sv_lua_gc_budget 0 lua paces itself like before.
+*/
+class CLuaGC
+{
+public:
+	enum
+	{
+		PAUSE=150, // percent of the live memory to wait for before the next cycle
+		STEPMUL=2, // bytes traversed per byte allocated, lua's default setstepmul is 200 as well
+		STEP_WORK=2048, // bytes traversed by a single LUA_GCSTEP with LuaJIT's default stepmul
+		MIN_MEMORY=1024*1024, // don't bother with the backstop below this
+	};
+
+	struct CStats
+	{
+		int64 m_Memory; // bytes
+		int64 m_LiveMemory; // bytes after the last finished cycle
+		int64 m_AllocRate; // bytes per frame, smoothed
+		int m_Cycles;
+		int m_FullCollects;
+		int m_Steps;
+		int64 m_Time; // total time spent in the collector
+		int64 m_MaxPause; // longest time spent in a single frame
+		int64 m_LastFullPause;
+	};
+
+private:
+	lua_State *m_pLua;
+	bool m_Paced; // automatic collector stopped by us
+	bool m_Stopped; // stopped via lua_status
+	bool m_InCycle;
+	int64 m_LastMemory;
+	int64 m_Debt;
+	CStats m_Stats;
+
+	int64 Memory() const;
+	void FullCollect();
+
+public:
+	CLuaGC();
+
+	void Init(lua_State *L);
+	void Step(int64 Deadline);
+
+	void Stop();
+	void Restart();
+	bool Stopped() const { return m_Stopped; }
+
+	const CStats *Stats();
+	void ResetStats();
+};
+
+#endif
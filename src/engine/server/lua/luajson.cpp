@@ -2,6 +2,7 @@
 #include <engine/external/json-builder/json-builder.h>
 #include <engine/lua_include.h>
 
+#include <base/math.h>
 #include <base/system.h>
 #include <base/system++/system++.h>
 #include <engine/server/luabinding.h>
@@ -22,17 +23,9 @@ static const json_serialize_opts json_opts_packed = {
 
 CJsonValue CLuaJson::Parse(const char *pJsonString, lua_State *L)
 {
+	// json_value_free and json-builder use malloc/free, so the parser has to as well
 	json_settings settings = {};
 	settings.value_extra = json_builder_extra; // space for json-builder state
-	settings.mem_alloc = [](size_t size, int zero, void * user_data) -> void* {
-		void *p = mem_alloc((unsigned)size, 0);
-		if(zero)
-			mem_zero(p, (unsigned)size);
-		return p;
-	};
-	settings.mem_free = [](void *p, void * user_data) {
-		mem_free(p);
-	};
 
 	char aErrorBuf[json_error_max];
 	aErrorBuf[0] = '\0';
@@ -58,34 +51,6 @@ std::string CLuaJson::Serialize(const CJsonValue& json_value, bool shorten, lua_
 	return Result;
 }
 
-luabridge::LuaRef CLuaJson::Read(const char *pJsonString, lua_State *L)
-{
-	CJsonValue json_value = Parse(pJsonString, L);
-
-	json_value.CheckValid(L);
-	switch(json_value.m_pValue->type)
-	{
-		case json_object:
-			return json_value.ToObject(L);
-		case json_array:
-			return json_value.ToTable(L);
-		case json_integer:
-		case json_double:
-			return luabridge::LuaRef(L, json_value.ToNumber(L));
-		case json_string:
-			return luabridge::LuaRef(L, json_value.ToString(L));
-		case json_boolean:
-			return luabridge::LuaRef(L, json_value.ToBoolean(L));
-		case json_none:
-		case json_null:
-			return luabridge::LuaRef(L, luabridge::Nil());
-	}
-
-	luaL_error(L, "Automatic conversion of json string failed: %s", pJsonString);
-	return luabridge::LuaRef(L);
-}
-
-
 //
 // CJsonValue
 //
@@ -286,3 +251,652 @@ CJsonValue CLuaJson::Convert(luabridge::LuaRef data)
 	Result.m_pValue = ConvertSomething(data);
 	return Result;
 }
+
+
+//
+// streaming conversion
+//
+
+/*
+	Both directions work on the lua stack directly: the reader pushes every
+	value as soon as it has been parsed and the writer walks the tables and
+	appends to a buffer that is kept across calls. Neither builds a json_value
+	tree in between, the only allocations are the lua values themselves.
+*/
+
+namespace
+{
+
+enum
+{
+	JSON_MAX_DEPTH=200,
+};
+
+// grows as needed and is reused by every call
+class CJsonBuffer
+{
+	char *m_pData;
+	int m_Size;
+	int m_Capacity;
+
+public:
+	CJsonBuffer() : m_pData(0), m_Size(0), m_Capacity(0) {}
+	~CJsonBuffer() { mem_free(m_pData); }
+
+	void Clear() { m_Size = 0; }
+	const char *Data() const { return m_pData; }
+	int Size() const { return m_Size; }
+
+	char *Reserve(int Size)
+	{
+		if(m_Size+Size > m_Capacity)
+		{
+			int Capacity = max(m_Capacity*2, max(m_Size+Size, 1024));
+			char *pData = (char *)mem_alloc(Capacity, 1);
+			if(m_pData)
+			{
+				mem_copy(pData, m_pData, m_Size);
+				mem_free(m_pData);
+			}
+			m_pData = pData;
+			m_Capacity = Capacity;
+		}
+		return m_pData+m_Size;
+	}
+
+	void Append(const char *pStr, int Length) { mem_copy(Reserve(Length), pStr, Length); m_Size += Length; }
+	void Append(char c) { *Reserve(1) = c; m_Size++; }
+	void Commit(int Length) { m_Size += Length; }
+};
+
+static CJsonBuffer s_JsonBuffer;
+
+class CJsonReader
+{
+	lua_State *L;
+	const char *m_pStart;
+	const char *m_pCur;
+	int m_Depth;
+
+	void Error(const char *pWhat)
+	{
+		// count the lines for a message comparable to json-parser's
+		int Line = 1, Col = 1;
+		for(const char *p = m_pStart; p < m_pCur; p++)
+		{
+			if(*p == '\n')
+			{
+				Line++;
+				Col = 1;
+			}
+			else
+				Col++;
+		}
+		luaL_error(L, "json parsing error: %d:%d: %s", Line, Col, pWhat);
+	}
+
+	void SkipWhitespace()
+	{
+		while(*m_pCur == ' ' || *m_pCur == '\t' || *m_pCur == '\n' || *m_pCur == '\r')
+			m_pCur++;
+	}
+
+	void Expect(const char *pWord, int Length)
+	{
+		if(str_comp_num(m_pCur, pWord, Length) != 0)
+			Error("unknown value");
+		m_pCur += Length;
+	}
+
+	static int HexDigit(char c)
+	{
+		if(c >= '0' && c <= '9') return c-'0';
+		if(c >= 'a' && c <= 'f') return c-'a'+10;
+		if(c >= 'A' && c <= 'F') return c-'A'+10;
+		return -1;
+	}
+
+	unsigned ReadHex4()
+	{
+		unsigned Code = 0;
+		for(int i = 0; i < 4; i++)
+		{
+			int Digit = HexDigit(m_pCur[i]);
+			if(Digit < 0)
+				Error("invalid unicode escape");
+			Code = Code<<4 | Digit;
+		}
+		m_pCur += 4;
+		return Code;
+	}
+
+	void PushString()
+	{
+		m_pCur++; // opening quote
+		const char *pBegin = m_pCur;
+		while(*m_pCur != '"' && *m_pCur != '\\')
+		{
+			if((unsigned char)*m_pCur < 0x20)
+				Error(*m_pCur ? "control character in string" : "unterminated string");
+			m_pCur++;
+		}
+
+		// the usual case, straight from the input
+		if(*m_pCur == '"')
+		{
+			lua_pushlstring(L, pBegin, m_pCur-pBegin);
+			m_pCur++;
+			return;
+		}
+
+		s_JsonBuffer.Clear();
+		s_JsonBuffer.Append(pBegin, m_pCur-pBegin);
+		while(*m_pCur != '"')
+		{
+			if((unsigned char)*m_pCur < 0x20)
+				Error(*m_pCur ? "control character in string" : "unterminated string");
+
+			if(*m_pCur != '\\')
+			{
+				s_JsonBuffer.Append(*m_pCur++);
+				continue;
+			}
+
+			m_pCur++;
+			switch(*m_pCur++)
+			{
+			case '"': s_JsonBuffer.Append('"'); break;
+			case '\\': s_JsonBuffer.Append('\\'); break;
+			case '/': s_JsonBuffer.Append('/'); break;
+			case 'b': s_JsonBuffer.Append('\b'); break;
+			case 'f': s_JsonBuffer.Append('\f'); break;
+			case 'n': s_JsonBuffer.Append('\n'); break;
+			case 'r': s_JsonBuffer.Append('\r'); break;
+			case 't': s_JsonBuffer.Append('\t'); break;
+			case 'u':
+			{
+				unsigned Code = ReadHex4();
+				if(Code >= 0xD800 && Code <= 0xDBFF && m_pCur[0] == '\\' && m_pCur[1] == 'u')
+				{
+					m_pCur += 2;
+					unsigned Low = ReadHex4();
+					if(Low < 0xDC00 || Low > 0xDFFF)
+						Error("invalid utf-16 surrogate pair");
+					Code = 0x10000 + ((Code-0xD800)<<10) + (Low-0xDC00);
+				}
+				s_JsonBuffer.Commit(str_utf8_encode(s_JsonBuffer.Reserve(4), Code));
+			} break;
+			default:
+				m_pCur--;
+				Error("invalid escape sequence");
+			}
+		}
+		m_pCur++;
+		lua_pushlstring(L, s_JsonBuffer.Data(), s_JsonBuffer.Size());
+	}
+
+	void PushNumber()
+	{
+		const char *pBegin = m_pCur;
+		bool Negative = *m_pCur == '-';
+		if(Negative)
+			m_pCur++;
+		if(*m_pCur < '0' || *m_pCur > '9' || (m_pCur[0] == '0' && m_pCur[1] >= '0' && m_pCur[1] <= '9'))
+			Error("invalid number");
+
+		// integers that fit into a double exactly don't need strtod
+		double Value = 0;
+		int Digits = 0;
+		while(*m_pCur >= '0' && *m_pCur <= '9')
+		{
+			Value = Value*10 + (*m_pCur++ - '0');
+			Digits++;
+		}
+
+		bool Fraction = *m_pCur == '.';
+		if(Fraction)
+		{
+			m_pCur++;
+			if(*m_pCur < '0' || *m_pCur > '9')
+				Error("invalid number");
+			while(*m_pCur >= '0' && *m_pCur <= '9')
+				m_pCur++;
+		}
+		bool Exponent = *m_pCur == 'e' || *m_pCur == 'E';
+		if(Exponent)
+		{
+			m_pCur++;
+			if(*m_pCur == '+' || *m_pCur == '-')
+				m_pCur++;
+			if(*m_pCur < '0' || *m_pCur > '9')
+				Error("invalid number");
+			while(*m_pCur >= '0' && *m_pCur <= '9')
+				m_pCur++;
+		}
+
+		if(Fraction || Exponent || Digits > 15)
+			Value = strtod(pBegin, 0);
+		else if(Negative)
+			Value = -Value;
+		lua_pushnumber(L, Value);
+	}
+
+	void PushArray()
+	{
+		m_pCur++;
+		lua_newtable(L);
+		SkipWhitespace();
+		if(*m_pCur == ']')
+		{
+			m_pCur++;
+			return;
+		}
+
+		// zero-based like the tree conversion
+		for(int i = 0; ; i++)
+		{
+			PushValue();
+			lua_rawseti(L, -2, i);
+
+			SkipWhitespace();
+			if(*m_pCur == ']')
+			{
+				m_pCur++;
+				return;
+			}
+			if(*m_pCur != ',')
+				Error("expected ',' or ']'");
+			m_pCur++;
+		}
+	}
+
+	void PushObject()
+	{
+		m_pCur++;
+		lua_newtable(L);
+		SkipWhitespace();
+		if(*m_pCur == '}')
+		{
+			m_pCur++;
+			return;
+		}
+
+		while(true)
+		{
+			SkipWhitespace();
+			if(*m_pCur != '"')
+				Error("expected a string as key");
+			PushString();
+
+			SkipWhitespace();
+			if(*m_pCur != ':')
+				Error("expected ':'");
+			m_pCur++;
+
+			PushValue();
+			lua_rawset(L, -3);
+
+			SkipWhitespace();
+			if(*m_pCur == '}')
+			{
+				m_pCur++;
+				return;
+			}
+			if(*m_pCur != ',')
+				Error("expected ',' or '}'");
+			m_pCur++;
+		}
+	}
+
+public:
+	CJsonReader(lua_State *L, const char *pJson) : L(L), m_pStart(pJson), m_pCur(pJson), m_Depth(0) {}
+
+	void PushValue()
+	{
+		SkipWhitespace();
+		if(m_Depth >= JSON_MAX_DEPTH)
+			Error("nested too deeply");
+		luaL_checkstack(L, 3, "json value nested too deeply");
+
+		switch(*m_pCur)
+		{
+		case '{': m_Depth++; PushObject(); m_Depth--; break;
+		case '[': m_Depth++; PushArray(); m_Depth--; break;
+		case '"': PushString(); break;
+		case 't': Expect("true", 4); lua_pushboolean(L, 1); break;
+		case 'f': Expect("false", 5); lua_pushboolean(L, 0); break;
+		case 'n': Expect("null", 4); lua_pushnil(L); break;
+		case '\0': Error("unexpected end of data"); break;
+		default:
+			if(*m_pCur == '-' || (*m_pCur >= '0' && *m_pCur <= '9'))
+				PushNumber();
+			else
+				Error("unexpected character");
+		}
+	}
+
+	void PushDocument()
+	{
+		PushValue();
+		SkipWhitespace();
+		if(*m_pCur != '\0')
+			Error("trailing garbage");
+	}
+};
+
+class CJsonWriter
+{
+	lua_State *L;
+	bool m_Packed;
+	int m_Depth;
+
+	void Newline()
+	{
+		if(m_Packed)
+			return;
+		s_JsonBuffer.Append('\n');
+		for(int i = 0; i < m_Depth; i++)
+			s_JsonBuffer.Append("  ", 2);
+	}
+
+	void WriteString(const char *pStr, size_t Length)
+	{
+		s_JsonBuffer.Append('"');
+		const char *pEnd = pStr+Length;
+		while(pStr < pEnd)
+		{
+			// copy the runs that don't need escaping at once
+			const char *pRun = pStr;
+			while(pStr < pEnd && *pStr != '"' && *pStr != '\\' && (unsigned char)*pStr >= 0x20)
+				pStr++;
+			s_JsonBuffer.Append(pRun, pStr-pRun);
+			if(pStr == pEnd)
+				break;
+
+			char c = *pStr++;
+			switch(c)
+			{
+			case '"': s_JsonBuffer.Append("\\\"", 2); break;
+			case '\\': s_JsonBuffer.Append("\\\\", 2); break;
+			case '\b': s_JsonBuffer.Append("\\b", 2); break;
+			case '\f': s_JsonBuffer.Append("\\f", 2); break;
+			case '\n': s_JsonBuffer.Append("\\n", 2); break;
+			case '\r': s_JsonBuffer.Append("\\r", 2); break;
+			case '\t': s_JsonBuffer.Append("\\t", 2); break;
+			default:
+			{
+				char aBuf[8];
+				str_format(aBuf, sizeof(aBuf), "\\u%04x", (unsigned char)c);
+				s_JsonBuffer.Append(aBuf, 6);
+			}
+			}
+		}
+		s_JsonBuffer.Append('"');
+	}
+
+	void WriteNumber(double Value)
+	{
+		char *pBuf = s_JsonBuffer.Reserve(32);
+		if(Value != Value || Value-Value != Value-Value) // nan and inf are no json
+			s_JsonBuffer.Append("null", 4);
+		else if(Value > -1e15 && Value < 1e15 && Value == (double)(int64)Value)
+			s_JsonBuffer.Commit(snprintf(pBuf, 32, "%.0f", Value));
+		else
+		{
+			// shortest of the two that reads back the same
+			int Length = snprintf(pBuf, 32, "%.15g", Value);
+			if(strtod(pBuf, 0) != Value)
+				Length = snprintf(pBuf, 32, "%.17g", Value);
+			s_JsonBuffer.Commit(Length);
+		}
+	}
+
+	// whether all keys are numbers, which is what makes a table an array.
+	// *pStart is set to the first index if the keys form a sequence, -1 otherwise
+	bool IsArray(int Index, int *pNum, int *pStart)
+	{
+		*pNum = 0;
+		bool Array = true;
+		bool Integers = true;
+		double Min = 0, Max = 0;
+		lua_pushnil(L);
+		while(lua_next(L, Index) != 0)
+		{
+			lua_pop(L, 1);
+			if(lua_type(L, -1) != LUA_TNUMBER)
+			{
+				Array = false;
+				lua_pop(L, 1);
+				break;
+			}
+
+			double Key = lua_tonumber(L, -1);
+			if(Key < 0 || Key > 0x7fffffff || Key != (double)(int)Key)
+				Integers = false;
+			if((*pNum)++ == 0 || Key < Min)
+				Min = Key;
+			if(*pNum == 1 || Key > Max)
+				Max = Key;
+		}
+
+		*pStart = Integers && (Min == 0 || Min == 1) && Max-Min+1 == *pNum ? (int)Min : -1;
+		return Array;
+	}
+
+	void WriteArray(int Index, int Num, int Start)
+	{
+		s_JsonBuffer.Append('[');
+		m_Depth++;
+
+		// write sequences in order, no matter whether they start at 0 or 1
+		if(Start >= 0)
+		{
+			for(int i = 0; i < Num; i++)
+			{
+				if(i > 0)
+					s_JsonBuffer.Append(',');
+				Newline();
+				lua_rawgeti(L, Index, Start+i);
+				WriteValue(lua_gettop(L));
+				lua_pop(L, 1);
+			}
+		}
+		else
+		{
+			// sparse, keep the table's order like the tree conversion does
+			int i = 0;
+			lua_pushnil(L);
+			while(lua_next(L, Index) != 0)
+			{
+				if(i++ > 0)
+					s_JsonBuffer.Append(',');
+				Newline();
+				WriteValue(lua_gettop(L));
+				lua_pop(L, 1);
+			}
+		}
+
+		m_Depth--;
+		Newline();
+		s_JsonBuffer.Append(']');
+	}
+
+	void WriteObject(int Index)
+	{
+		s_JsonBuffer.Append('{');
+		m_Depth++;
+
+		int i = 0;
+		lua_pushnil(L);
+		while(lua_next(L, Index) != 0)
+		{
+			if(i++ > 0)
+				s_JsonBuffer.Append(',');
+			Newline();
+
+			size_t Length;
+			if(lua_type(L, -2) == LUA_TSTRING)
+			{
+				const char *pKey = lua_tolstring(L, -2, &Length);
+				WriteString(pKey, Length);
+			}
+			else if(lua_type(L, -2) == LUA_TNUMBER)
+			{
+				// lua_tolstring would turn the key itself into a string and break lua_next
+				lua_pushvalue(L, -2);
+				const char *pKey = lua_tolstring(L, -1, &Length);
+				WriteString(pKey, Length);
+				lua_pop(L, 1);
+			}
+			else
+				luaL_error(L, "key of type %s cannot be converted to json", luaL_typename(L, -2));
+
+			s_JsonBuffer.Append(':');
+			if(!m_Packed)
+				s_JsonBuffer.Append(' ');
+			WriteValue(lua_gettop(L));
+			lua_pop(L, 1);
+		}
+
+		m_Depth--;
+		Newline();
+		s_JsonBuffer.Append('}');
+	}
+
+public:
+	CJsonWriter(lua_State *L, bool Packed) : L(L), m_Packed(Packed), m_Depth(0) {}
+
+	void WriteValue(int Index)
+	{
+		switch(lua_type(L, Index))
+		{
+		case LUA_TNONE:
+		case LUA_TNIL:
+			s_JsonBuffer.Append("null", 4);
+			break;
+		case LUA_TNUMBER:
+			WriteNumber(lua_tonumber(L, Index));
+			break;
+		case LUA_TBOOLEAN:
+			if(lua_toboolean(L, Index))
+				s_JsonBuffer.Append("true", 4);
+			else
+				s_JsonBuffer.Append("false", 5);
+			break;
+		case LUA_TSTRING:
+		{
+			size_t Length;
+			const char *pStr = lua_tolstring(L, Index, &Length);
+			WriteString(pStr, Length);
+		} break;
+		case LUA_TTABLE:
+		{
+			if(m_Depth >= JSON_MAX_DEPTH)
+				luaL_error(L, "table is nested too deeply or contains itself");
+			luaL_checkstack(L, 4, "table nested too deeply");
+
+			int Num, Start;
+			if(IsArray(Index, &Num, &Start))
+			{
+				if(Num == 0)
+					s_JsonBuffer.Append("[]", 2);
+				else
+					WriteArray(Index, Num, Start);
+			}
+			else
+				WriteObject(Index);
+		} break;
+		default:
+			// handles function, userdata, thread
+			luaL_error(L, "value of type %s cannot be converted to json", luaL_typename(L, Index));
+		}
+	}
+};
+
+}
+
+int CLuaJson::Read(lua_State *L)
+{
+	const char *pJsonString = luaL_checkstring(L, 1);
+	CJsonReader Reader(L, pJsonString);
+	Reader.PushDocument();
+	return 1;
+}
+
+int CLuaJson::Write(lua_State *L)
+{
+	luaL_checkany(L, 1);
+	bool Packed = lua_toboolean(L, 2);
+	lua_settop(L, 1);
+
+	s_JsonBuffer.Clear();
+	CJsonWriter Writer(L, Packed);
+	Writer.WriteValue(1);
+	lua_pushlstring(L, s_JsonBuffer.Data(), s_JsonBuffer.Size());
+	return 1;
+}
+
+void CLuaJson::Benchmark(lua_State *L, int Iterations, CBenchmark *pResult)
+{
+	// roughly what a mod persists at the end of a round
+	static const char s_aSample[] =
+		"local t = {} "
+		"for i = 1, 64 do "
+		"  t['player' .. i] = { name = 'nameless tee ' .. i, clan = 'clan \\\"' .. i % 8 .. '\\\"', "
+		"    score = i * 3, kills = i * 7, deaths = i % 13, time = i * 123.25, ready = i % 2 == 0, "
+		"    weapons = { 1, 2, 3, 4, 5, i }, "
+		"    rounds = { { map = 'dm1', score = i }, { map = 'ctf2', score = i * 2 } } } "
+		"end "
+		"return t";
+
+	mem_zero(pResult, sizeof(*pResult));
+	if(Iterations <= 0 || luaL_loadstring(L, s_aSample) != 0 || lua_pcall(L, 0, 1, 0) != 0)
+	{
+		lua_settop(L, 0);
+		return;
+	}
+	int Data = lua_gettop(L);
+	luabridge::LuaRef DataRef = luabridge::LuaRef::fromStack(L, Data);
+
+	// lua to string
+	std::string Json;
+	int64 Start = time_get();
+	for(int i = 0; i < Iterations; i++)
+	{
+		CJsonValue Value = Convert(DataRef);
+		Json = Serialize(Value, false, L);
+	}
+	pResult->m_TreeWrite = time_get()-Start;
+	pResult->m_TreeSize = (int)Json.size();
+
+	Start = time_get();
+	for(int i = 0; i < Iterations; i++)
+	{
+		s_JsonBuffer.Clear();
+		CJsonWriter Writer(L, false);
+		Writer.WriteValue(Data);
+	}
+	pResult->m_StreamWrite = time_get()-Start;
+	pResult->m_StreamSize = s_JsonBuffer.Size();
+
+	// string to lua, both parse the same text
+	Start = time_get();
+	for(int i = 0; i < Iterations; i++)
+	{
+		CJsonValue Value = Parse(Json.c_str(), L);
+		CJsonValue::PushJsonValueSelect(L, *Value.m_pValue);
+		lua_pop(L, 1);
+	}
+	pResult->m_TreeRead = time_get()-Start;
+
+	Start = time_get();
+	for(int i = 0; i < Iterations; i++)
+	{
+		CJsonReader Reader(L, Json.c_str());
+		Reader.PushDocument();
+		lua_pop(L, 1);
+	}
+	pResult->m_StreamRead = time_get()-Start;
+
+	lua_settop(L, Data-1);
+}
@@ -2,6 +2,7 @@
 #define ENGINE_CLIENT_LUA_LUAJSON_H
 
 #include <string>
+#include <base/system.h>
 #include <engine/external/json-parser/json.hpp>
 #include <engine/lua_include.h>
 
@@ -9,7 +10,7 @@
 class CJsonValue
 {
 	friend class CLuaJson;
-	json_value *m_pValue;
+	mutable json_value *m_pValue;
 
 public:
 	CJsonValue()
@@ -17,6 +18,14 @@ public:
 		m_pValue = NULL;
 	}
 
+	// the handle owns the tree, so a copy (like the one luabridge makes when
+	// a value is returned to lua) takes it over instead of freeing it twice
+	CJsonValue(const CJsonValue& Other)
+	{
+		m_pValue = Other.m_pValue;
+		Other.m_pValue = NULL;
+	}
+
 	~CJsonValue();
 
 	void Destroy(lua_State *L);
@@ -71,8 +80,22 @@ public:
 	/** json to string */
 	static std::string Serialize(const CJsonValue& json_value, bool shorten, lua_State *L);
 	/* (json to lua is in CJsonValue) */
-	/** string to lua: low-level function for automatic conversion */
-	static luabridge::LuaRef Read(const char *pJsonString, lua_State *L);
+	/** string to lua: parses straight onto the lua stack without building a json tree */
+	static int Read(lua_State *L);
+	/** lua to string: walks the given value and writes the json text directly, packed if the second argument is true */
+	static int Write(lua_State *L);
+
+	struct CBenchmark
+	{
+		int64 m_TreeWrite; // Convert + Serialize
+		int64 m_StreamWrite;
+		int64 m_TreeRead; // Parse + ToObject
+		int64 m_StreamRead;
+		int m_TreeSize;
+		int m_StreamSize;
+	};
+	/** compares the json_value based conversion to the streaming one on a sample table */
+	static void Benchmark(lua_State *L, int Iterations, CBenchmark *pResult);
 };
 
 #endif
@@ -0,0 +1,85 @@
+#include <base/system.h>
+#include <engine/shared/profiler.h>
+#include <engine/shared/snapstats.h>
+
+#include "../lua.h"
+#include "luaperf.h"
+
+static luabridge::LuaRef PhaseTable(int Phase, lua_State *L)
+{
+	CProfiler::CStats Stats;
+	CProfiler::GetStats(Phase, &Stats);
+
+	luabridge::LuaRef Table = luabridge::newTable(L);
+	Table["avg"] = Stats.m_Avg;
+	Table["p50"] = Stats.m_P50;
+	Table["p99"] = Stats.m_P99;
+	Table["max"] = Stats.m_Max;
+	return Table;
+}
+
+luabridge::LuaRef CLuaPerf::Get(lua_State *L)
+{
+	luabridge::LuaRef Table = luabridge::newTable(L);
+	for(int i = 0; i < CProfiler::NUM_PHASES; i++)
+		Table[CProfiler::PhaseName(i)] = PhaseTable(i, L);
+	return Table;
+}
+
+luabridge::LuaRef CLuaPerf::GetPhase(const char *pPhase, lua_State *L)
+{
+	for(int i = 0; i < CProfiler::NUM_PHASES; i++)
+		if(str_comp(CProfiler::PhaseName(i), pPhase) == 0)
+			return PhaseTable(i, L);
+	return luabridge::LuaRef(L);
+}
+
+void CLuaPerf::Reset()
+{
+	CProfiler::Reset();
+}
+
+luabridge::LuaRef CLuaPerf::GetSnapStats(int ClientID, lua_State *L)
+{
+	if(ClientID < -1 || ClientID >= MAX_CLIENTS)
+		luaL_error(L, "invalid client id %d", ClientID);
+
+	CSnapStats::CCounters Counters;
+	CSnapStats::Get(ClientID, &Counters);
+
+	luabridge::LuaRef Types = luabridge::newTable(L);
+	for(int i = 0; i < CSnapStats::MAX_TYPES; i++)
+		if(Counters.m_aTypes[i])
+			Types[i] = Counters.m_aTypes[i];
+	if(Counters.m_aTypes[CSnapStats::TYPE_OTHER])
+		Types["other"] = Counters.m_aTypes[CSnapStats::TYPE_OTHER];
+
+	luabridge::LuaRef Classes = luabridge::newTable(L);
+	for(int i = 0; i < CSnapStats::NumOwners(); i++)
+		if(Counters.m_aOwners[i])
+			Classes[CSnapStats::OwnerName(i)] = Counters.m_aOwners[i];
+
+	luabridge::LuaRef Table = luabridge::newTable(L);
+	Table["total"] = Counters.m_Total;
+	Table["types"] = Types;
+	Table["classes"] = Classes;
+	return Table;
+}
+
+luabridge::LuaRef CLuaPerf::GetGC(lua_State *L)
+{
+	const CLuaGC::CStats *pStats = CLua::Lua()->GC()->Stats();
+	const double ToUs = 1000000.0/time_freq();
+
+	luabridge::LuaRef Table = luabridge::newTable(L);
+	Table["memory"] = (double)pStats->m_Memory;
+	Table["live"] = (double)pStats->m_LiveMemory;
+	Table["alloc_rate"] = (double)pStats->m_AllocRate;
+	Table["cycles"] = pStats->m_Cycles;
+	Table["steps"] = pStats->m_Steps;
+	Table["full_collects"] = pStats->m_FullCollects;
+	Table["time"] = pStats->m_Time*ToUs;
+	Table["max_pause"] = pStats->m_MaxPause*ToUs;
+	Table["last_full_pause"] = pStats->m_LastFullPause*ToUs;
+	return Table;
+}
@@ -0,0 +1,26 @@
+#ifndef ENGINE_SERVER_LUA_LUAPERF_H
+#define ENGINE_SERVER_LUA_LUAPERF_H
+
+#include <engine/lua_include.h>
+
+
+// namespace-global
+
+class CLuaPerf
+{
+public:
+	/** timings of all phases: { tick = { avg=, p50=, p99=, max= }, ... } in microseconds per tick */
+	static luabridge::LuaRef Get(lua_State *L);
+	/** timings of a single phase, nil if there is no phase with that name */
+	static luabridge::LuaRef GetPhase(const char *pPhase, lua_State *L);
+	/** start measuring from scratch */
+	static void Reset();
+
+	/** snapshot bandwidth of the last second in bytes: { total=, types = { [type]= }, classes = { [name]= } }, ClientID -1 for all clients */
+	static luabridge::LuaRef GetSnapStats(int ClientID, lua_State *L);
+
+	/** garbage collector statistics: { memory=, live=, alloc_rate=, cycles=, steps=, full_collects=, time=, max_pause=, last_full_pause= } in bytes and microseconds */
+	static luabridge::LuaRef GetGC(lua_State *L);
+};
+
+#endif
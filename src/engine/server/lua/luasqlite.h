@@ -26,6 +26,8 @@ public:
 	void Clear() { m_pDb->Clear(); }
 
 	const char *GetDatabasePath() const { return m_aPath; }
+
+	CSql *Db() { return m_pDb; }
 };
 
 // invisible to lua
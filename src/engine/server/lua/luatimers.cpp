@@ -0,0 +1,354 @@
+#include <base/math.h>
+#include <engine/server.h>
+#include <engine/shared/profiler.h>
+
+#include "../lua.h"
+#include "../lua_class.h"
+#include "luatimers.h"
+
+CLuaTimers::CLuaTimers()
+{
+	m_pLua = 0;
+	Clear();
+}
+
+void CLuaTimers::Clear()
+{
+	// the references die with the lua state, but the ids handed out must not match anything anymore
+	m_FirstFree = -1;
+	for(int i = (int)m_lTimers.size()-1; i >= 0; i--)
+	{
+		CTimer *pTimer = &m_lTimers[i];
+		pTimer->m_Generation = max((pTimer->m_Generation+1)&GENERATION_MASK, 1);
+		pTimer->m_Ref = LUA_NOREF;
+		pTimer->m_Slot = -1;
+		pTimer->m_pOwner = 0;
+		pTimer->m_Next = m_FirstFree;
+		m_FirstFree = i;
+	}
+
+	for(int i = 0; i < NUM_SLOTS; i++)
+		m_aSlots[i] = -1;
+	m_NumActive = 0;
+	m_Now = 0;
+	m_lExpired.clear();
+	m_pLua = 0;
+}
+
+void CLuaTimers::Init(lua_State *L, int64 Now)
+{
+	Clear();
+	m_pLua = L;
+	m_Now = Now;
+}
+
+int CLuaTimers::Lookup(int ID) const
+{
+	int Index = ID&(MAX_TIMERS-1);
+	if(ID <= 0 || Index >= (int)m_lTimers.size())
+		return -1;
+	const CTimer *pTimer = &m_lTimers[Index];
+	if(pTimer->m_Ref == LUA_NOREF || pTimer->m_Generation != (ID>>INDEX_BITS))
+		return -1;
+	return Index;
+}
+
+void CLuaTimers::Link(int Index)
+{
+	CTimer *pTimer = &m_lTimers[Index];
+
+	// timers too far out go into the last slot and get another round when it comes up
+	int64 Delta = clamp(pTimer->m_Expires-m_Now, (int64)0, (int64)MAX_DELAY);
+	int64 Expires = m_Now+Delta;
+	int Slot;
+	if(Delta < ROOT_SIZE)
+		Slot = Expires&(ROOT_SIZE-1);
+	else
+	{
+		int Level = 1;
+		while(Level < NUM_LEVELS-1 && Delta >= (int64)1<<(ROOT_BITS+Level*LEVEL_BITS))
+			Level++;
+		Slot = ROOT_SIZE+(Level-1)*LEVEL_SIZE + ((Expires>>(ROOT_BITS+(Level-1)*LEVEL_BITS))&(LEVEL_SIZE-1));
+	}
+
+	pTimer->m_Slot = Slot;
+	pTimer->m_Prev = -1;
+	pTimer->m_Next = m_aSlots[Slot];
+	if(pTimer->m_Next != -1)
+		m_lTimers[pTimer->m_Next].m_Prev = Index;
+	m_aSlots[Slot] = Index;
+}
+
+void CLuaTimers::Unlink(int Index)
+{
+	CTimer *pTimer = &m_lTimers[Index];
+	if(pTimer->m_Slot == -1)
+		return;
+
+	if(pTimer->m_Prev != -1)
+		m_lTimers[pTimer->m_Prev].m_Next = pTimer->m_Next;
+	else
+		m_aSlots[pTimer->m_Slot] = pTimer->m_Next;
+	if(pTimer->m_Next != -1)
+		m_lTimers[pTimer->m_Next].m_Prev = pTimer->m_Prev;
+	pTimer->m_Slot = -1;
+}
+
+void CLuaTimers::Cascade(int Level, int SlotIndex)
+{
+	// everything in there expires within the range of the levels below now
+	int Slot = ROOT_SIZE+(Level-1)*LEVEL_SIZE+SlotIndex;
+	int Index = m_aSlots[Slot];
+	m_aSlots[Slot] = -1;
+	while(Index != -1)
+	{
+		int Next = m_lTimers[Index].m_Next;
+		Link(Index);
+		Index = Next;
+	}
+}
+
+void CLuaTimers::Free(int Index)
+{
+	Unlink(Index);
+
+	CTimer *pTimer = &m_lTimers[Index];
+	if(pTimer->m_pOwner)
+	{
+		if(pTimer->m_OwnerPrev != -1)
+			m_lTimers[pTimer->m_OwnerPrev].m_OwnerNext = pTimer->m_OwnerNext;
+		else
+			pTimer->m_pOwner->m_FirstTimer = pTimer->m_OwnerNext != -1 ? MakeID(pTimer->m_OwnerNext) : 0;
+		if(pTimer->m_OwnerNext != -1)
+			m_lTimers[pTimer->m_OwnerNext].m_OwnerPrev = pTimer->m_OwnerPrev;
+		pTimer->m_pOwner = 0;
+	}
+
+	luaL_unref(m_pLua, LUA_REGISTRYINDEX, pTimer->m_Ref);
+	pTimer->m_Ref = LUA_NOREF;
+	pTimer->m_Generation = max((pTimer->m_Generation+1)&GENERATION_MASK, 1);
+	pTimer->m_Next = m_FirstFree;
+	m_FirstFree = Index;
+	m_NumActive--;
+}
+
+int CLuaTimers::Start(int Delay, int Interval, CLuaClass *pOwner)
+{
+	if(!m_pLua)
+		return 0;
+
+	int Index = m_FirstFree;
+	if(Index != -1)
+		m_FirstFree = m_lTimers[Index].m_Next;
+	else if((int)m_lTimers.size() < MAX_TIMERS)
+	{
+		Index = (int)m_lTimers.size();
+		m_lTimers.push_back(CTimer());
+		m_lTimers[Index].m_Generation = 1;
+	}
+	else
+	{
+		lua_pop(m_pLua, 1);
+		return 0;
+	}
+
+	CTimer *pTimer = &m_lTimers[Index];
+	pTimer->m_Ref = luaL_ref(m_pLua, LUA_REGISTRYINDEX);
+	// a sleeping instance only catches up on its idle ticks, count from the tick the server is at
+	pTimer->m_Expires = max(m_Now, (int64)CLua::Lua()->Server()->Tick())+max(Delay, 1);
+	pTimer->m_Interval = Interval;
+	pTimer->m_pOwner = pOwner;
+	pTimer->m_OwnerPrev = -1;
+	pTimer->m_OwnerNext = -1;
+	if(pOwner)
+	{
+		pTimer->m_OwnerNext = Lookup(pOwner->m_FirstTimer);
+		if(pTimer->m_OwnerNext != -1)
+			m_lTimers[pTimer->m_OwnerNext].m_OwnerPrev = Index;
+		pOwner->m_FirstTimer = MakeID(Index);
+	}
+	Link(Index);
+	m_NumActive++;
+	return MakeID(Index);
+}
+
+bool CLuaTimers::Stop(int ID)
+{
+	int Index = Lookup(ID);
+	if(Index == -1)
+		return false;
+	Free(Index);
+	return true;
+}
+
+void CLuaTimers::StopOwner(CLuaClass *pOwner)
+{
+	// a stale id from before a reload is not found and ends it right away
+	int Index;
+	while((Index = Lookup(pOwner->m_FirstTimer)) != -1)
+		Free(Index);
+	pOwner->m_FirstTimer = 0;
+}
+
+void CLuaTimers::Tick(int64 Now)
+{
+	if(!m_pLua)
+		return;
+
+	if(m_NumActive == 0)
+	{
+		m_Now = max(m_Now, Now);
+		return;
+	}
+
+	while(m_Now < Now)
+	{
+		m_Now++;
+		int RootIndex = m_Now&(ROOT_SIZE-1);
+		if(RootIndex == 0)
+		{
+			for(int Level = 1; Level < NUM_LEVELS; Level++)
+			{
+				int SlotIndex = (m_Now>>(ROOT_BITS+(Level-1)*LEVEL_BITS))&(LEVEL_SIZE-1);
+				Cascade(Level, SlotIndex);
+				if(SlotIndex != 0)
+					break;
+			}
+		}
+
+		int Index = m_aSlots[RootIndex];
+		while(Index != -1)
+		{
+			CTimer *pTimer = &m_lTimers[Index];
+			int Next = pTimer->m_Next;
+			Unlink(Index);
+			m_lExpired.push_back(MakeID(Index));
+
+			// rearm right away so that the callback can stop it, ticks that were skipped are not made up for
+			if(pTimer->m_Interval)
+			{
+				pTimer->m_Expires = max(pTimer->m_Expires+pTimer->m_Interval, Now+1);
+				Link(Index);
+			}
+			Index = Next;
+		}
+	}
+
+	if(m_lExpired.empty())
+		return;
+
+	PROFILE_SCOPE(PHASE_LUA);
+	for(unsigned i = 0; i < m_lExpired.size(); i++)
+		Dispatch(m_lExpired[i]);
+	m_lExpired.clear();
+}
+
+void CLuaTimers::Dispatch(int ID)
+{
+	// stopped by an earlier callback of the same batch?
+	int Index = Lookup(ID);
+	if(Index == -1)
+		return;
+
+	// a class disabled by the watchdog doesn't get its timers either, the interval ones wait for it to be enabled again
+	const char *pClass = m_lTimers[Index].m_pOwner ? m_lTimers[Index].m_pOwner->GetLuaClassName() : "timers";
+	if(CLua::Lua()->Watchdog()->IsDisabled(pClass))
+	{
+		if(m_lTimers[Index].m_Interval == 0)
+			Free(Index);
+		return;
+	}
+
+	lua_State *L = m_pLua;
+	int Top = lua_gettop(L);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, m_lTimers[Index].m_Ref);
+	int Data = Top+1;
+
+	lua_rawgeti(L, Data, 3);
+	int NumArgs = (int)lua_tointeger(L, -1);
+	lua_pop(L, 1);
+
+	lua_rawgeti(L, Data, 1);
+	lua_rawgeti(L, Data, 2);
+	int NumSelf = 1;
+	if(lua_isnil(L, -1))
+	{
+		lua_pop(L, 1);
+		NumSelf = 0;
+	}
+	for(int i = 0; i < NumArgs; i++)
+		lua_rawgeti(L, Data, 4+i);
+
+	// held against the owner's class by the watchdog
+	CLuaWatchdog::CScope WatchdogScope(CLua::Lua()->Watchdog(), pClass);
+
+	// the data stays on the stack for the call
+	if(m_lTimers[Index].m_Interval == 0)
+		Free(Index);
+
+	int Status = lua_pcall(L, NumSelf+NumArgs, 0, 0);
+	if(Status != 0)
+	{
+		luabridge::LuaException e(L, Status);
+		CLua::HandleException(e);
+	}
+	lua_settop(L, Top);
+}
+
+int CLuaTimers::LuaStart(lua_State *L)
+{
+	int Delay = luaL_checkint(L, 1);
+	int Interval = luaL_optint(L, 2, 0);
+	luaL_checktype(L, 3, LUA_TFUNCTION);
+	if(Delay < 0)
+		return luaL_error(L, "delay may not be negative, got %d", Delay);
+	if(Interval < 0)
+		return luaL_error(L, "interval may not be negative, got %d", Interval);
+
+	// the self table of an object owns the timer
+	CLuaClass *pOwner = 0;
+	if(lua_istable(L, 4))
+	{
+		lua_pushstring(L, "__dbgLC");
+		lua_rawget(L, 4);
+		if(lua_isuserdata(L, -1))
+			pOwner = const_cast<CLuaClass *>(luabridge::Stack<const CLuaClass *>::get(L, lua_gettop(L)));
+		lua_pop(L, 1);
+	}
+
+	int Top = lua_gettop(L);
+	int NumArgs = max(Top-4, 0);
+	lua_createtable(L, NumArgs+3, 0);
+	lua_pushvalue(L, 3);
+	lua_rawseti(L, -2, 1);
+	if(Top >= 4)
+	{
+		lua_pushvalue(L, 4);
+		lua_rawseti(L, -2, 2);
+	}
+	lua_pushinteger(L, NumArgs);
+	lua_rawseti(L, -2, 3);
+	for(int i = 0; i < NumArgs; i++)
+	{
+		lua_pushvalue(L, 5+i);
+		lua_rawseti(L, -2, 4+i);
+	}
+
+	int ID = CLua::Lua()->Timers()->Start(Delay, Interval, pOwner);
+	if(ID == 0)
+		return luaL_error(L, "too many timers");
+	lua_pushinteger(L, ID);
+	return 1;
+}
+
+int CLuaTimers::LuaStop(lua_State *L)
+{
+	lua_pushboolean(L, CLua::Lua()->Timers()->Stop(luaL_checkint(L, 1)));
+	return 1;
+}
+
+int CLuaTimers::LuaCount(lua_State *L)
+{
+	lua_pushinteger(L, CLua::Lua()->Timers()->NumActive());
+	return 1;
+}
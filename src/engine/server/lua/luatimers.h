@@ -0,0 +1,98 @@
+#ifndef ENGINE_SERVER_LUA_LUATIMERS_H
+#define ENGINE_SERVER_LUA_LUATIMERS_H
+
+#include <vector>
+#include <base/system.h>
+#include <engine/lua_include.h>
+
+/*
+	Timers for lua, counted in server ticks and kept in a hierarchical timer
+	wheel: the next ROOT_SIZE ticks have a slot each, every further level
+	covers LEVEL_SIZE times the range of the one below it. Starting and
+	stopping a timer is a list insert/unlink, a tick only looks at the slot
+	that is due and every LEVEL_SIZE ticks moves the next slot of the level
+	above down.
+
+	Tick() collects everything that expired and runs the callbacks in one
+	go. A timer may belong to a CLuaClass object, it is stopped together with
+	the object.
+
+	Ids carry a generation, stopping a timer that already finished is a
+	harmless no-op.
+*/
+class CLuaTimers
+{
+public:
+	enum
+	{
+		ROOT_BITS=8,
+		LEVEL_BITS=6,
+		NUM_LEVELS=4, // including the root
+		ROOT_SIZE=1<<ROOT_BITS,
+		LEVEL_SIZE=1<<LEVEL_BITS,
+		NUM_SLOTS=ROOT_SIZE+(NUM_LEVELS-1)*LEVEL_SIZE,
+		MAX_DELAY=(1<<(ROOT_BITS+(NUM_LEVELS-1)*LEVEL_BITS))-1, // ~15 days at 50 ticks, longer ones take several rounds
+
+		INDEX_BITS=20,
+		MAX_TIMERS=1<<INDEX_BITS,
+		GENERATION_MASK=(1<<(31-INDEX_BITS))-1,
+	};
+
+private:
+	struct CTimer
+	{
+		int m_Next; // in its slot or in the free list
+		int m_Prev;
+		int m_Slot; // -1 if it's not in the wheel
+		int m_OwnerNext;
+		int m_OwnerPrev;
+		class CLuaClass *m_pOwner;
+		int64 m_Expires;
+		int m_Interval; // 0 for one-shot timers
+		int m_Ref; // registry reference to { callback, self, numargs, args... }
+		int m_Generation;
+	};
+
+	lua_State *m_pLua;
+	std::vector<CTimer> m_lTimers;
+	int m_aSlots[NUM_SLOTS];
+	int m_FirstFree;
+	int m_NumActive;
+	int64 m_Now; // last tick that was run
+	std::vector<int> m_lExpired; // ids, reused every tick
+
+	int MakeID(int Index) const { return (m_lTimers[Index].m_Generation<<INDEX_BITS)|Index; }
+	int Lookup(int ID) const;
+
+	void Link(int Index);
+	void Unlink(int Index);
+	void Cascade(int Level, int SlotIndex);
+	void Free(int Index);
+	void Dispatch(int ID);
+
+public:
+	CLuaTimers();
+
+	/** drops every timer without touching the lua state, which is about to be closed */
+	void Clear();
+	void Init(lua_State *L, int64 Now);
+
+	/** takes the { callback, self, numargs, args... } table on top of the stack, returns the id or 0 if out of timers */
+	int Start(int Delay, int Interval, class CLuaClass *pOwner);
+	bool Stop(int ID);
+	void StopOwner(class CLuaClass *pOwner);
+
+	/** advances the wheel up to the given tick and runs everything that expired */
+	void Tick(int64 Now);
+
+	int NumActive() const { return m_NumActive; }
+
+	// lua
+	/** timers.Start(delay, interval, callback, self, ...) with delay and interval in ticks, interval 0 for a one-shot timer */
+	static int LuaStart(lua_State *L);
+	/** timers.Stop(id), returns whether the timer was still running */
+	static int LuaStop(lua_State *L);
+	static int LuaCount(lua_State *L);
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include <base/math.h>
+#include <engine/console.h>
+#include <engine/shared/config.h>
+
+#include "../lua.h"
+#include "luawatchdog.h"
+
+CLuaWatchdog::CScope::CScope(CLuaWatchdog *pWatchdog, const char *pClass)
+{
+	m_pWatchdog = Enabled() || pWatchdog->m_Depth > 0 ? pWatchdog : 0;
+	if(!m_pWatchdog)
+		return;
+
+	// the object may be destroyed by its own callback, so the name is copied
+	str_copyb(m_aPrevClass, m_pWatchdog->m_aClass);
+	str_copyb(m_pWatchdog->m_aClass, pClass);
+	m_pWatchdog->Enter();
+}
+
+CLuaWatchdog::CScope::~CScope()
+{
+	if(!m_pWatchdog)
+		return;
+
+	m_pWatchdog->Leave();
+	str_copyb(m_pWatchdog->m_aClass, m_aPrevClass);
+}
+
+CLuaWatchdog::CLuaWatchdog()
+{
+	m_pLua = 0;
+	m_Depth = 0;
+	m_aClass[0] = '\0';
+	m_aOuterClass[0] = '\0';
+	m_Deadline = 0;
+	m_TickUsed = 0;
+	Reset();
+}
+
+void CLuaWatchdog::Init(lua_State *L)
+{
+	// a reload is a fresh chance for every class
+	m_pLua = L;
+	m_Depth = 0;
+	m_Deadline = 0;
+	m_TickUsed = 0;
+	Reset();
+}
+
+void CLuaWatchdog::Reset()
+{
+	m_Stats.clear();
+	m_NumDisabled = 0;
+}
+
+bool CLuaWatchdog::Enabled()
+{
+	return g_Config.m_SvLuaCallbackBudget > 0 || g_Config.m_SvLuaTickBudget > 0;
+}
+
+bool CLuaWatchdog::CheckDisabled(const char *pClass) const
+{
+	std::map<std::string, CClassStats>::const_iterator it = m_Stats.find(pClass);
+	return it != m_Stats.end() && it->second.m_Disabled;
+}
+
+CLuaWatchdog::CClassStats *CLuaWatchdog::ClassStats(const char *pClass)
+{
+	std::map<std::string, CClassStats>::iterator it = m_Stats.find(pClass);
+	if(it == m_Stats.end())
+	{
+		CClassStats Stats;
+		mem_zero(&Stats, sizeof(Stats));
+		it = m_Stats.insert(std::make_pair(std::string(pClass), Stats)).first;
+	}
+	return &it->second;
+}
+
+void CLuaWatchdog::Enter()
+{
+	// nested callbacks run on the deadline of the outermost one
+	if(m_Depth++ > 0 || !m_pLua)
+		return;
+
+	// the deadline is this one's, so is the blame for running over it
+	str_copyb(m_aOuterClass, m_aClass);
+	m_Start = time_get();
+	m_Deadline = 0;
+	m_TickLimited = false;
+	m_Expired = false;
+	if(g_Config.m_SvLuaCallbackBudget)
+		m_Deadline = m_Start+time_freq()*g_Config.m_SvLuaCallbackBudget/1000;
+	if(g_Config.m_SvLuaTickBudget)
+	{
+		int64 TickDeadline = m_Start+max(time_freq()*g_Config.m_SvLuaTickBudget/1000-m_TickUsed, (int64)0);
+		if(!m_Deadline || TickDeadline < m_Deadline)
+		{
+			m_Deadline = TickDeadline;
+			m_TickLimited = true;
+		}
+	}
+
+	if(m_Deadline)
+		lua_sethook(m_pLua, Hook, LUA_MASKCOUNT, HOOK_COUNT);
+}
+
+void CLuaWatchdog::Leave()
+{
+	if(--m_Depth > 0 || !m_Deadline)
+		return;
+
+	lua_sethook(m_pLua, 0, 0, 0);
+	m_Deadline = 0;
+
+	int64 Elapsed = time_get()-m_Start;
+	m_TickUsed += Elapsed;
+	if(g_Config.m_SvLuaCallbackBudget && Elapsed*2000 > time_freq()*g_Config.m_SvLuaCallbackBudget)
+	{
+		CClassStats *pStats = ClassStats(m_aOuterClass);
+		pStats->m_SlowCalls++;
+		pStats->m_MaxTime = max(pStats->m_MaxTime, Elapsed);
+	}
+}
+
+void CLuaWatchdog::Hook(lua_State *L, lua_Debug *ar)
+{
+	CLuaWatchdog *pSelf = CLua::Lua()->Watchdog();
+	if(!pSelf->m_Expired)
+	{
+		if(time_get() < pSelf->m_Deadline)
+			return;
+		pSelf->m_Expired = true;
+		pSelf->OnExpired();
+
+		// from now on every instruction fails, a pcall in the script can't keep it going
+		lua_sethook(L, Hook, LUA_MASKCOUNT, 1);
+	}
+
+	if(pSelf->m_TickLimited)
+		luaL_error(L, "watchdog: '%s' aborted, the lua time budget of this tick (%d ms) is used up", pSelf->m_aOuterClass, g_Config.m_SvLuaTickBudget);
+	else
+		luaL_error(L, "watchdog: '%s' ran for more than %d ms and was aborted", pSelf->m_aOuterClass, g_Config.m_SvLuaCallbackBudget);
+}
+
+void CLuaWatchdog::OnExpired()
+{
+	CClassStats *pStats = ClassStats(m_aOuterClass);
+	if(m_TickLimited)
+	{
+		pStats->m_TickAborts++;
+		return;
+	}
+
+	pStats->m_Aborts++;
+	if(g_Config.m_SvLuaWatchdogStrikes && pStats->m_Aborts >= g_Config.m_SvLuaWatchdogStrikes && !pStats->m_Disabled)
+	{
+		pStats->m_Disabled = true;
+		m_NumDisabled++;
+		CLua::Lua()->Console()->Printf(IConsole::OUTPUT_LEVEL_STANDARD, "lua/watchdog", "class '%s' was aborted %d times, its events are disabled until the gametype is reloaded",
+									   m_aOuterClass, pStats->m_Aborts);
+	}
+}
@@ -0,0 +1,91 @@
+#ifndef ENGINE_SERVER_LUA_LUAWATCHDOG_H
+#define ENGINE_SERVER_LUA_LUAWATCHDOG_H
+
+#include <map>
+#include <string>
+#include <base/system.h>
+#include <engine/lua_include.h>
+
+/*
+	Keeps a script from hanging the server. Every callback into lua runs in a
+	CScope, the outermost one arms a count hook that looks at the clock every
+	HOOK_COUNT instructions and raises an error once the callback ran for more
+	than sv_lua_callback_budget, or longer than what is left of
+	sv_lua_tick_budget for this tick. The error unwinds to the pcall of the
+	callback and gets reported like any other script error.
+
+	Aborts are counted per lua class. A class that got aborted
+	sv_lua_watchdog_strikes times is disabled until the gametype is reloaded,
+	its events are no longer called and the C++ defaults take over. Its
+	timers and async tasks are held back as well.
+
+	Hooks don't run inside compiled traces, so the gametype scripts are loaded
+	with the JIT off while the watchdog is on (see CLua::LoadLuaFile).
+*/
+class CLuaWatchdog
+{
+public:
+	enum
+	{
+		HOOK_COUNT=1000, // instructions between two looks at the clock
+	};
+
+	struct CClassStats
+	{
+		int m_Aborts; // ran over the callback budget
+		int m_TickAborts; // cut short because the tick budget was used up, not held against the class
+		int m_SlowCalls; // took more than half of the callback budget
+		int64 m_MaxTime; // longest of the slow calls
+		bool m_Disabled;
+	};
+
+	class CScope
+	{
+		CLuaWatchdog *m_pWatchdog; // 0 if not watched
+		char m_aPrevClass[64];
+
+	public:
+		CScope(CLuaWatchdog *pWatchdog, const char *pClass);
+		~CScope();
+	};
+
+private:
+	lua_State *m_pLua;
+	std::map<std::string, CClassStats> m_Stats;
+	int m_NumDisabled;
+
+	int m_Depth;
+	char m_aClass[64]; // of the innermost running callback
+	char m_aOuterClass[64]; // of the outermost one, which the deadline and the aborts belong to
+	int64 m_Start; // of the outermost one
+	int64 m_Deadline; // 0 if it isn't watched
+	bool m_TickLimited; // the deadline comes from the tick budget
+	bool m_Expired;
+	int64 m_TickUsed;
+
+	static void Hook(lua_State *L, lua_Debug *ar);
+
+	void Enter();
+	void Leave();
+	void OnExpired();
+	bool CheckDisabled(const char *pClass) const;
+	CClassStats *ClassStats(const char *pClass);
+
+public:
+	CLuaWatchdog();
+
+	void Init(lua_State *L);
+	void NextTick() { m_TickUsed = 0; }
+
+	/** whether callbacks are watched at all, the scripts have to be loaded without the JIT then */
+	static bool Enabled();
+	bool IsDisabled(const char *pClass) const { return m_NumDisabled > 0 && CheckDisabled(pClass); }
+	/** the class of the innermost running callback, empty if none is running or nothing is watched */
+	const char *CurrentClass() const { return m_aClass; }
+
+	const std::map<std::string, CClassStats> &Stats() const { return m_Stats; }
+	/** forgets the statistics and enables every class again */
+	void Reset();
+};
+
+#endif
@@ -20,6 +20,10 @@
 #include "luabinding.h"
 #include "lua/lua_config.h"
 #include "lua/luajson.h"
+#include "lua/luaffi.h"
+#include "lua/luaasync.h"
+#include "lua/luaperf.h"
+#include "lua/luatimers.h"
 #include "engine/server/lua/luasqlite.h"
 #include "lua_class.h"
 #include "lua.h"
@@ -113,7 +117,8 @@ void CLua::RegisterLuaCallbacks()
 			.addFunction("Parse", &CLuaJson::Parse)
 			.addFunction("Convert", &CLuaJson::Convert)
 			.addFunction("Serialize", &CLuaJson::Serialize)
-			.addFunction("Read", &CLuaJson::Read)
+			.addCFunction("Read", &CLuaJson::Read)
+			.addCFunction("Write", &CLuaJson::Write)
 		.endNamespace()
 
 		// sql
@@ -156,6 +161,27 @@ void CLua::RegisterLuaCallbacks()
 			.addFunction("Clear", &CLuaSql::Clear)
 		.endNamespace()
 
+		.beginNamespace("perf")
+			.addFunction("Get", &CLuaPerf::Get)
+			.addFunction("GetPhase", &CLuaPerf::GetPhase)
+			.addFunction("Reset", &CLuaPerf::Reset)
+			.addFunction("GetSnapStats", &CLuaPerf::GetSnapStats)
+			.addFunction("GetGC", &CLuaPerf::GetGC)
+		.endNamespace()
+
+		.beginNamespace("timers")
+			.addCFunction("Start", &CLuaTimers::LuaStart)
+			.addCFunction("Stop", &CLuaTimers::LuaStop)
+			.addCFunction("Count", &CLuaTimers::LuaCount)
+		.endNamespace()
+
+		.beginNamespace("async")
+			.addCFunction("Run", &CLuaAsync::LuaRun)
+			.addCFunction("ReadFile", &CLuaAsync::LuaReadFile)
+			.addCFunction("Listdir", &CLuaAsync::LuaListdir)
+			.addCFunction("Query", &CLuaAsync::LuaQuery)
+		.endNamespace()
+
 
 		.beginClass< CProjectileProperties>("CProjectileProperties")
 			.addConstructor <void (*) (int, int, bool, float)> ()
@@ -218,6 +244,17 @@ void CLua::RegisterLuaCallbacks()
 #undef MACRO_TUNING_PARAM
 
 		/// Srv.Game.World
+		/// Srv.Game:SnapContext(ClientID)
+		.beginClass<CSnapContext>("CSnapContext")
+			.addData("ClientID", &CSnapContext::m_ClientID, false)
+			.addData("ViewPos", &CSnapContext::m_ViewPos, false)
+			.addData("Is64", &CSnapContext::m_Is64, false)
+			.addData("Is128", &CSnapContext::m_Is128, false)
+			.addFunction("Clipped", &CSnapContext::ClippedLua)
+			.addFunction("Translate", &CSnapContext::TranslateLua) // -> translated ID or -1 if the client can't see them
+			.addFunction("Latency", &CSnapContext::LatencyLua)
+		.endClass()
+
 		.beginClass<CGameWorld>("CGameWorld")
 			.addData("ResetRequested", &CGameWorld::m_ResetRequested)
 			.addData("Paused", &CGameWorld::m_Paused)
@@ -229,10 +266,11 @@ void CLua::RegisterLuaCallbacks()
 			.addFunction("cast_Projectile", &CGameWorld::cast_CProjectile)
 			.addFunction("IntersectCharacter", &CGameWorld::IntersectCharacter)
 			.addFunction("ClosestCharacter", &CGameWorld::ClosestCharacter)
+			.addCFunction("Query", &CGameWorld::QueryLua) // bulk read of all entities of a type
 			.addFunction("InsertEntity", &CGameWorld::InsertEntity) // inserts an entity into the world
 			.addFunction("RemoveEntity", &CGameWorld::RemoveEntity) // remove the reference from the world
 			.addFunction("DestroyEntity", &CGameWorld::DestroyEntity) // marks the entity for deletion
-			.addFunction("Snap", &CGameWorld::Snap)
+			.addFunction("Snap", &CGameWorld::SnapLua)
 			.addFunction("Tick", &CGameWorld::Tick)
 		.endClass()
 
@@ -241,6 +279,7 @@ void CLua::RegisterLuaCallbacks()
 			.addProperty("Collision", &CGameContext::LuaGetCollision)
 			.addProperty("Tuning", &CGameContext::LuaGetTuning)
 			.addProperty("World", &CGameContext::LuaGetWorld)
+			.addFunction("SnapContext", &CGameContext::SnapContext) // -> [CSnapContext], only valid until the next call
 			.addFunction("GetPlayer", &CGameContext::GetPlayer) // -> [CPlayer]
 			.addFunction("GetPlayerChar", &CGameContext::GetPlayerChar) // [CCharacter]
 
@@ -357,7 +396,7 @@ void CLua::RegisterLuaCallbacks()
 
 			.addFunction("Tick", &CPlayer::Tick)
 			.addFunction("PostTick", &CPlayer::PostTick)
-			.addFunction("Snap", &CPlayer::Snap)
+			.addFunction("Snap", &CPlayer::SnapLua)
 			// Needed for manual lua snapping!
 			.addFunction("AddClientInfoSnap", &CPlayer::AddClientInfoSnap)
 			.addFunction("AddPlayerInfoSnap", &CPlayer::AddPlayerInfoSnap)
@@ -618,22 +657,9 @@ void CLua::RegisterLuaCallbacks()
 			.addVariable("Storage", &CLua::ms_pSelf->m_pStorage, false)
 		.endNamespace()
 
-		/// Config.<var_name>
-#define MACRO_CONFIG_STR(Name,ScriptName,Len,Def,Save,Desc) \
-			.addStaticProperty(#Name, &CConfigProperties::GetConfig_##Name) \
-			.addStaticProperty(#ScriptName, &CConfigProperties::GetConfig_##Name)
-
-#define MACRO_CONFIG_INT(Name,ScriptName,Def,Min,Max,Save,Desc) \
-			.addStaticProperty(#Name, &CConfigProperties::GetConfig_##Name) \
-			.addStaticProperty(#ScriptName, &CConfigProperties::GetConfig_##Name)
-
-		.beginClass<CConfigProperties>("Config")
-			#include <engine/shared/config_variables.h>
-		.endClass()
-
-#undef MACRO_CONFIG_STR
-#undef MACRO_CONFIG_INT
-
-
 	; // end global namespace
+
+	/// Config.<var_name>
+	CConfigProperties::Register(L);
+	CLuaFFI::Register(L);
 }
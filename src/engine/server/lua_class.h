@@ -12,26 +12,38 @@
 class CLuaClass
 {
 	friend class CLua;
+	friend class CLuaTimers;
+	friend class CLuaAsync;
 
 	std::string m_LuaClass;
 	volatile int m_IntegrityCheck;
+	int m_FirstTimer; // id of the newest timer this object owns, see CLuaTimers
+	int m_NumAsyncTasks; // coroutines started from its events, see CLuaAsync
 
 protected:
 	CLuaClass(const char *pClassName)
 	{
 		m_LuaClass = std::string(pClassName);
 		m_IntegrityCheck = 0x539;
+		m_FirstTimer = 0;
+		m_NumAsyncTasks = 0;
 	}
 
 	virtual ~CLuaClass()
 	{
+		CLua::Lua()->Timers()->StopOwner(this);
+		if(m_NumAsyncTasks)
+			CLua::Lua()->Async()->StopOwner(this);
 		CLua::FreeSelfTable(CLua::Lua()->L(), this);
 	}
 
 	inline const char *GetLuaClassName() const { dbg_assert_strict(m_IntegrityCheck == 0x539, "bad mem"); return m_LuaClass.c_str(); }
 
+	// called after the object got bound to another lua class
+	virtual void OnLuaClassBound() {}
+
 public:
-	inline void LuaBindClass(const char *pClassName) { m_LuaClass = std::string(pClassName); }
+	inline void LuaBindClass(const char *pClassName) { m_LuaClass = std::string(pClassName); OnLuaClassBound(); }
 
 	luabridge::LuaRef GetSelf(lua_State *L)
 	{
@@ -22,8 +22,10 @@
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/packer.h>
+#include <engine/shared/profiler.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/snapshot.h>
+#include <engine/shared/snapstats.h>
 
 #include <mastersrv/mastersrv.h>
 #include <engine/lua.h>
@@ -33,6 +35,7 @@
 #include "register.h"
 #include "server.h"
 #include "luabinding.h"
+#include "lua/luajson.h"
 
 #if defined(CONF_FAMILY_WINDOWS)
 	#define _WIN32_WINNT 0x0501
@@ -279,6 +282,9 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 	m_TickSpeed = SERVER_TICK_SPEED;
 
 	m_pGameServer = 0;
+	m_NumInstances = 0;
+	m_ActiveInstance = 0;
+	m_pNetWait = 0;
 
 	m_CurrentGameTick = 0;
 	m_RunServer = SERVER_RUNNING;
@@ -289,6 +295,10 @@ CServer::CServer() : m_DemoRecorder(&m_SnapshotDelta)
 
 	m_MapReload = 0;
 	m_LuaReinit = 0;
+	m_Benchmark = false;
+
+	m_SnapOwner = 0;
+	m_NumSnapItems = 0;
 
 	m_RconExecClientID = IServer::RCON_CID_SERV;
 
@@ -493,6 +503,7 @@ int CServer::Init()
 		m_aClients[i].m_aClan[0] = 0;
 		m_aClients[i].m_Country = -1;
 		m_aClients[i].m_ClientSupportFlags = 0;
+		m_aClients[i].m_Instance = 0;
 		m_aClients[i].m_Snapshots.Init();
 	}
 
@@ -501,6 +512,87 @@ int CServer::Init()
 	return 0;
 }
 
+void CServer::ActivateInstance(int Instance)
+{
+	m_ActiveInstance = Instance;
+	m_pGameServer = m_aInstances[Instance].m_pGameServer;
+	m_aInstances[Instance].m_pLua->Activate();
+}
+
+void CServer::ForEachInstance(void (*pfnFunc)(void *pUser), void *pUser)
+{
+	for(int i = 0; i < m_NumInstances; i++)
+	{
+		CInstanceScope Scope(this, i);
+		pfnFunc(pUser);
+	}
+}
+
+void CServer::CreateInstances()
+{
+	// the first instance is the one registered with the kernel
+	for(int i = m_NumInstances; i < g_Config.m_SvInstances; i++)
+	{
+		m_aInstances[i].m_pGameServer = CreateGameServer();
+		m_aInstances[i].m_pLua = CreateLua();
+		Kernel()->ReregisterInterface(m_aInstances[i].m_pGameServer);
+		Kernel()->ReregisterInterface(m_aInstances[i].m_pLua);
+		m_NumInstances++;
+	}
+
+	if(m_NumInstances > 1)
+		Console()->Printf(IConsole::OUTPUT_LEVEL_STANDARD, "server", "hosting %d game instances", m_NumInstances);
+}
+
+void CServer::DestroyInstances()
+{
+	ActivateInstance(0);
+	for(int i = 1; i < m_NumInstances; i++)
+	{
+		// like the first one, the lua states live until the process ends
+		delete m_aInstances[i].m_pGameServer;
+		m_aInstances[i].m_pGameServer = 0;
+	}
+	m_NumInstances = 1;
+}
+
+int CServer::NumInstanceClients(int Instance) const
+{
+	int Num = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		if(m_aClients[i].m_State != CClient::STATE_EMPTY && m_aClients[i].m_State != CClient::STATE_DUMMY && m_aClients[i].m_Instance == Instance)
+			Num++;
+	return Num;
+}
+
+int CServer::ChooseInstance() const
+{
+	int aNumClients[MAX_INSTANCES];
+	int Fewest = 0;
+	for(int i = 0; i < m_NumInstances; i++)
+	{
+		aNumClients[i] = NumInstanceClients(i);
+		if(aNumClients[i] < aNumClients[Fewest])
+			Fewest = i;
+	}
+
+	if(g_Config.m_SvInstanceRoute == 1)
+	{
+		// the first one with room, the emptiest if they are all full
+		for(int i = 0; i < m_NumInstances; i++)
+			if(!g_Config.m_SvInstanceMaxClients || aNumClients[i] < g_Config.m_SvInstanceMaxClients)
+				return i;
+	}
+	return Fewest;
+}
+
+bool CServer::InstanceAwake(int Instance) const
+{
+	if(!g_Config.m_SvIdle && (m_NumInstances == 1 || !g_Config.m_SvInstanceSleep))
+		return true;
+	return NumInstanceClients(Instance) > 0;
+}
+
 void CServer::SetRconCID(int ClientID)
 {
 	m_RconExecClientID = ClientID;
@@ -523,7 +615,7 @@ int CServer::GetClientInfo(int ClientID, CClientInfo *pInfo) const
 	dbg_assert(ClientID >= 0 && ClientID < MAX_CLIENTS, "client_id is not valid");
 	dbg_assert(pInfo != 0, "info can not be null");
 
-	if(m_aClients[ClientID].m_State == CClient::STATE_INGAME)
+	if(m_aClients[ClientID].m_State == CClient::STATE_INGAME || (m_Benchmark && m_aClients[ClientID].m_State == CClient::STATE_DUMMY))
 	{
 		pInfo->m_pName = m_aClients[ClientID].m_aName;
 		pInfo->m_Latency = m_aClients[ClientID].m_Latency;
@@ -587,7 +679,9 @@ int CServer::ClientCountry(int ClientID)
 
 bool CServer::ClientIngame(int ClientID)
 {
-	return ClientID >= 0 && ClientID < MAX_CLIENTS && m_aClients[ClientID].m_State >= CServer::CClient::STATE_INGAME;
+	// the game only gets to see the clients of its own instance
+	return ClientID >= 0 && ClientID < MAX_CLIENTS && m_aClients[ClientID].m_State >= CServer::CClient::STATE_INGAME &&
+		m_aClients[ClientID].m_Instance == m_ActiveInstance;
 }
 
 bool CServer::ClientIsDummy(int ClientID)
@@ -595,8 +689,15 @@ bool CServer::ClientIsDummy(int ClientID)
 	return ClientID >= 0 && ClientID < MAX_CLIENTS && m_aClients[ClientID].m_State == CServer::CClient::STATE_DUMMY;
 }
 
+bool CServer::ClientSlotFree(int ClientID)
+{
+	return ClientID >= 0 && ClientID < MAX_CLIENTS && m_aClients[ClientID].m_State == CServer::CClient::STATE_EMPTY;
+}
+
 int CServer::MaxClients() const
 {
+	if(m_Benchmark)
+		return MAX_CLIENTS;
 	return m_NetServer.MaxClients();
 }
 
@@ -806,18 +907,18 @@ int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 	if(Flags&MSGFLAG_FLUSH)
 		Packet.m_Flags |= NETSENDFLAG_FLUSH;
 
-	// write message to demo recorder
-	if(!(Flags&MSGFLAG_NORECORD))
+	// write message to demo recorder, it records the first instance
+	if(!(Flags&MSGFLAG_NORECORD) && m_ActiveInstance == 0)
 		m_DemoRecorder.RecordMessage(pMsg->Data(), pMsg->Size());
 
 	if(!(Flags&MSGFLAG_NOSEND))
 	{
 		if(ClientID == -1)
 		{
-			// broadcast
+			// broadcast to the active instance
 			int i;
 			for(i = 0; i < MAX_CLIENTS; i++)
-				if(m_aClients[i].m_State == CClient::STATE_INGAME)
+				if(m_aClients[i].m_State == CClient::STATE_INGAME && m_aClients[i].m_Instance == m_ActiveInstance)
 				{
 					Packet.m_ClientID = i;
 					m_NetServer.Send(&Packet);
@@ -829,18 +930,71 @@ int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 	return 0;
 }
 
+void CServer::SnapBuilderInit()
+{
+	m_SnapshotBuilder.Init();
+	m_SnapOwner = CSnapStats::OWNER_NONE;
+	m_NumSnapItems = 0;
+}
+
+void CServer::AccountSnapshot(int ClientID, CSnapshot *pData, const void *pDeltaData, int DeltaSize, int CompressedSize)
+{
+	// walk the delta like the client unpacks it and count the compressed size of every int
+	const CSnapshotDelta::CData *pDelta = (const CSnapshotDelta::CData *)pDeltaData;
+	const int *pInt = pDelta->m_pData;
+	const int *pEnd = (const int *)((const char *)pDeltaData + DeltaSize);
+	unsigned char aPacked[8];
+
+	CSnapStats::AddTotal(ClientID, CompressedSize);
+
+	// deleted items only tell their key
+	for(int i = 0; i < pDelta->m_NumDeletedItems && pInt < pEnd; i++, pInt++)
+		CSnapStats::Add(ClientID, (*pInt)>>16, CSnapStats::OWNER_NONE, (int)(CVariableInt::Pack(aPacked, *pInt)-aPacked));
+
+	// updated items appear in the same order as in the snapshot
+	int Index = 0;
+	for(int i = 0; i < pDelta->m_NumUpdateItems && pInt+2 <= pEnd; i++)
+	{
+		const int Type = pInt[0];
+		const int Key = (Type<<16)|pInt[1];
+		const int StaticSize = Type < CSnapStats::MAX_TYPES ? m_SnapshotDelta.GetStaticsize(Type) : 0;
+		const int NumInts = 2 + (StaticSize ? StaticSize/4 : 1+pInt[2]);
+
+		int Bytes = 0;
+		for(int k = 0; k < NumInts && pInt < pEnd; k++, pInt++)
+			Bytes += (int)(CVariableInt::Pack(aPacked, *pInt)-aPacked);
+
+		while(Index < pData->NumItems() && pData->GetItem(Index)->Key() != Key)
+			Index++;
+		int Owner = Index < m_NumSnapItems ? m_aSnapItemOwners[Index] : (int)CSnapStats::OWNER_NONE;
+
+		CSnapStats::Add(ClientID, Type, Owner, Bytes);
+	}
+}
+
 void CServer::DoSnapshot()
 {
-	GameServer()->OnPreSnap();
+	PROFILE_SCOPE(PHASE_SNAP);
+
+	if(Tick()%SERVER_TICK_SPEED == 0)
+		CSnapStats::NextSecond();
+
+	for(int i = 0; i < m_NumInstances; i++)
+	{
+		if(!InstanceAwake(i))
+			continue;
+		CInstanceScope Scope(this, i);
+		GameServer()->OnPreSnap();
+	}
 
-	// create snapshot for demo recording
+	// create snapshot for demo recording, of the first instance
 	if(m_DemoRecorder.IsRecording())
 	{
 		char aData[CSnapshot::MAX_SIZE];
 		int SnapshotSize;
 
 		// build snap and possibly add some messages
-		m_SnapshotBuilder.Init();
+		SnapBuilderInit();
 		GameServer()->OnSnap(-1);
 		SnapshotSize = m_SnapshotBuilder.Finish(aData);
 
@@ -852,7 +1006,8 @@ void CServer::DoSnapshot()
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		// client must be ingame (and not a dummy) to recive snapshots
-		if(m_aClients[i].m_State != CClient::STATE_INGAME)
+		// the benchmark dummies stand in for real clients though
+		if(m_aClients[i].m_State != CClient::STATE_INGAME && !(m_Benchmark && m_aClients[i].m_State == CClient::STATE_DUMMY))
 			continue;
 
 		// this client is trying to recover, don't spam snapshots
@@ -876,9 +1031,12 @@ void CServer::DoSnapshot()
 			int DeltaTick = -1;
 			int DeltaSize;
 
-			m_SnapshotBuilder.Init();
+			SnapBuilderInit();
 
-			GameServer()->OnSnap(i);
+			{
+				CInstanceScope Scope(this, m_aClients[i].m_Instance);
+				GameServer()->OnSnap(i);
+			}
 
 			// finish snapshot
 			SnapshotSize = m_SnapshotBuilder.Finish(pData);
@@ -907,7 +1065,10 @@ void CServer::DoSnapshot()
 			}
 
 			// create delta
-			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+			{
+				PROFILE_SCOPE(PHASE_DELTA);
+				DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+			}
 
 			if(DeltaSize)
 			{
@@ -916,7 +1077,11 @@ void CServer::DoSnapshot()
 				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
 				int NumPackets;
 
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData);
+				{
+					PROFILE_SCOPE(PHASE_COMPRESS);
+					SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData);
+				}
+				AccountSnapshot(i, pData, aDeltaData, DeltaSize, SnapshotSize);
 				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
 
 				for(int n = 0, Left = SnapshotSize; Left; n++)
@@ -958,13 +1123,20 @@ void CServer::DoSnapshot()
 		}
 	}
 
-	GameServer()->OnPostSnap();
+	for(int i = 0; i < m_NumInstances; i++)
+	{
+		if(!InstanceAwake(i))
+			continue;
+		CInstanceScope Scope(this, i);
+		GameServer()->OnPostSnap();
+	}
 }
 
 
 int CServer::NewClientCallback(int ClientID, void *pUser)
 {
 	CServer *pThis = (CServer *)pUser;
+	pThis->m_aClients[ClientID].m_Instance = pThis->ChooseInstance();
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_AUTH;
 	pThis->m_aClients[ClientID].m_aName[0] = 0;
 	pThis->m_aClients[ClientID].m_aClan[0] = 0;
@@ -975,6 +1147,7 @@ int CServer::NewClientCallback(int ClientID, void *pUser)
 	pThis->m_aClients[ClientID].m_pRconCmdToSend = NULL;
 	pThis->m_aClients[ClientID].m_ClientSupportFlags = 0;
 	pThis->m_aClients[ClientID].Reset();
+	CSnapStats::ResetClient(ClientID);
 	return 0;
 }
 
@@ -990,7 +1163,10 @@ int CServer::DelClientCallback(int ClientID, const char *pReason, void *pUser)
 
 	// notify the mod about the drop
 	if(pThis->m_aClients[ClientID].m_State >= CClient::STATE_READY)
+	{
+		CInstanceScope Scope(pThis, pThis->m_aClients[ClientID].m_Instance);
 		pThis->GameServer()->OnClientDrop(ClientID, pReason);
+	}
 
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_EMPTY;
 	pThis->m_aClients[ClientID].m_aName[0] = 0;
@@ -1007,6 +1183,7 @@ int CServer::DelClientCallback(int ClientID, const char *pReason, void *pUser)
 void CServer::InitDummy(int ClientID)
 {
 	m_aClients[ClientID].m_State = CClient::STATE_DUMMY;
+	m_aClients[ClientID].m_Instance = m_ActiveInstance;
 
 	char aDummyName[MAX_NAME_LENGTH];
 	str_formatb(aDummyName, "Dummy %i", ClientID);
@@ -1116,6 +1293,9 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 	CUnpacker Unpacker;
 	Unpacker.Reset(pPacket->m_pData, pPacket->m_DataSize);
 
+	// the game messages and rcon commands go to the instance of the client
+	CInstanceScope Scope(this, m_aClients[ClientID].m_Instance);
+
 	// unpack msgid and system flag
 	int Msg = Unpacker.GetInt();
 	int Sys = Msg&1;
@@ -1478,7 +1658,7 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int InfoType, int
 	{
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
 		{
-			if(GameServer()->IsClientPlayer(i))
+			if(m_aInstances[m_aClients[i].m_Instance].m_pGameServer->IsClientPlayer(i))
 				PlayerCount++;
 
 			ClientCount++;
@@ -1584,7 +1764,7 @@ void CServer::SendServerInfo(const NETADDR *pAddr, int Token, int InfoType, int
 			p.AddString(ClientClan(i), MAX_CLAN_LENGTH); // client clan
 			str_format(aBuf, sizeof(aBuf), "%d", m_aClients[i].m_Country); p.AddString(aBuf, 6); // client country
 			str_format(aBuf, sizeof(aBuf), "%d", m_aClients[i].m_Score); p.AddString(aBuf, 6); // client score
-			str_format(aBuf, sizeof(aBuf), "%d", GameServer()->IsClientPlayer(i)?1:0); p.AddString(aBuf, 2); // is player?
+			str_format(aBuf, sizeof(aBuf), "%d", m_aInstances[m_aClients[i].m_Instance].m_pGameServer->IsClientPlayer(i)?1:0); p.AddString(aBuf, 2); // is player?
 		}
 	}
 
@@ -1726,6 +1906,10 @@ int CServer::Run()
 		return 0;
 	}
 
+	// headless benchmark, doesn't touch the network at all
+	if(g_Config.m_DbgBenchTicks > 0)
+		return RunBenchmark();
+
 	// start server
 	NETADDR BindAddr;
 	if(g_Config.m_Bindaddr[0] && net_host_lookup(g_Config.m_Bindaddr, &BindAddr, NETTYPE_ALL) == 0)
@@ -1741,7 +1925,10 @@ int CServer::Run()
 		BindAddr.port = g_Config.m_SvPort;
 	}
 
-	if(!m_NetServer.Open(BindAddr, &m_ServerBan, g_Config.m_SvMaxClients, g_Config.m_SvMaxClientsPerIP, 0))
+	// falls back to waiting on the game socket alone
+	m_pNetWait = net_wait_create();
+
+	if(!m_NetServer.Open(BindAddr, &m_ServerBan, g_Config.m_SvMaxClients, g_Config.m_SvMaxClientsPerIP, m_pNetWait, g_Config.m_SvNetThread ? NETCREATE_FLAG_THREADED : 0))
 	{
 		dbg_msg("server", "couldn't open socket. port %d might already be in use", g_Config.m_SvPort);
 		return 0;
@@ -1749,10 +1936,15 @@ int CServer::Run()
 
 	m_NetServer.SetCallbacks(NewClientCallback, DelClientCallback, this);
 
-	m_Econ.Init(Console(), &m_ServerBan);
+	m_Econ.Init(Console(), &m_ServerBan, m_pNetWait);
 
-	if(!GameServer()->OnInit())
-		return 0;
+	CreateInstances();
+	for(int i = 0; i < m_NumInstances; i++)
+	{
+		CInstanceScope Scope(this, i);
+		if(!GameServer()->OnInit())
+			return 0;
+	}
 
 	Console()->Printf(IConsole::OUTPUT_LEVEL_STANDARD, "server", "server name is '%s'", g_Config.m_SvName);
 	Console()->Printf(IConsole::OUTPUT_LEVEL_STANDARD, "server", "version %s", GameServer()->NetVersion());
@@ -1764,6 +1956,7 @@ int CServer::Run()
 	{
 		int64 ReportTime = time_get();
 		int ReportInterval = 3;
+		bool Idle = false;
 
 		m_Lastheartbeat = 0;
 		m_GameStartTime = time_get();
@@ -1786,7 +1979,11 @@ int CServer::Run()
 				if(LoadMap(g_Config.m_SvMap))
 				{
 					// new map loaded
-					GameServer()->OnShutdown();
+					for(int i = 0; i < m_NumInstances; i++)
+					{
+						CInstanceScope Scope(this, i);
+						GameServer()->OnShutdown();
+					}
 
 					for(int c = 0; c < MAX_CLIENTS; c++)
 					{
@@ -1800,8 +1997,12 @@ int CServer::Run()
 
 					m_GameStartTime = time_get();
 					m_CurrentGameTick = 0;
-					Kernel()->ReregisterInterface(GameServer());
-					GameServer()->OnInit();
+					for(int i = 0; i < m_NumInstances; i++)
+					{
+						CInstanceScope Scope(this, i);
+						Kernel()->ReregisterInterface(GameServer());
+						GameServer()->OnInit();
+					}
 					UpdateServerInfo();
 				}
 				else
@@ -1816,32 +2017,64 @@ int CServer::Run()
 			{
 				int ID = m_LuaReinit-1;
 				m_LuaReinit = 0;
-				CLua::Lua()->ReloadSingleObject(ID);
+				for(int i = 0; i < m_NumInstances; i++)
+				{
+					CInstanceScope Scope(this, i);
+					CLua::Lua()->ReloadSingleObject(ID);
+				}
 			}
 
+			// sleeping instances only get the idle ticks
+			int IdleInterval = g_Config.m_SvIdleTickrate ? max(1, TickSpeed()/g_Config.m_SvIdleTickrate) : 0;
+			int IdleTicked = 0;
+
 			// main loop
 			while(t > TickStartTime(m_CurrentGameTick+1))
 			{
 				m_CurrentGameTick++;
 				NewTicks++;
+				if(!Idle)
+					CProfiler::Add(CProfiler::PHASE_LATE, time_get()-TickStartTime(m_CurrentGameTick));
 
 				// apply new input
-				for(int c = 0; c < MAX_CLIENTS; c++)
 				{
-					if(m_aClients[c].m_State == CClient::STATE_EMPTY)
-						continue;
-					for(int i = 0; i < 200; i++)
+					PROFILE_SCOPE(PHASE_INPUT);
+					for(int c = 0; c < MAX_CLIENTS; c++)
 					{
-						if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
+						if(m_aClients[c].m_State == CClient::STATE_EMPTY)
+							continue;
+						for(int i = 0; i < 200; i++)
 						{
-							if(m_aClients[c].m_State == CClient::STATE_INGAME)
-								GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
-							break;
+							if(m_aClients[c].m_aInputs[i].m_GameTick == Tick())
+							{
+								if(m_aClients[c].m_State == CClient::STATE_INGAME)
+								{
+									CInstanceScope Scope(this, m_aClients[c].m_Instance);
+									GameServer()->OnClientPredictedInput(c, m_aClients[c].m_aInputs[i].m_aData);
+								}
+								break;
+							}
 						}
 					}
 				}
 
-				GameServer()->OnTick();
+				{
+					PROFILE_SCOPE(PHASE_TICK);
+					for(int i = 0; i < m_NumInstances; i++)
+					{
+						if(InstanceAwake(i))
+						{
+							CInstanceScope Scope(this, i);
+							GameServer()->OnTick();
+						}
+						else if(IdleInterval && m_CurrentGameTick%IdleInterval == 0)
+						{
+							CInstanceScope Scope(this, i);
+							GameServer()->OnIdleTick();
+							IdleTicked |= 1<<i;
+						}
+					}
+				}
 			}
 
 			// snap game
@@ -1851,40 +2084,62 @@ int CServer::Run()
 					DoSnapshot();
 
 				UpdateClientRconCommands();
+
+				// let the lua gc use the slack until the next tick, within its budget
+				// the instances take turns in being first, so none of them starves
+				int64 Deadline = min(time_get()+time_freq()*g_Config.m_SvLuaGcBudget/1000000, TickStartTime(m_CurrentGameTick+1));
+				for(int n = 0; n < m_NumInstances; n++)
+				{
+					int i = (m_CurrentGameTick+n)%m_NumInstances;
+					if(!InstanceAwake(i) && !(IdleTicked&(1<<i)))
+						continue;
+					CInstanceScope Scope(this, i);
+					CLua::Lua()->GC()->Step(Deadline);
+				}
+
+				CProfiler::NextFrame();
 			}
 
 			// master server stuff
-			m_Register.RegisterUpdate(m_NetServer.NetType());
+			{
+				PROFILE_SCOPE(PHASE_REGISTER);
+				m_Register.RegisterUpdate(m_NetServer.NetType());
+			}
 
-			PumpNetwork();
+			{
+				PROFILE_SCOPE(PHASE_NETWORK);
+				PumpNetwork();
+			}
 
 			if(ReportTime < time_get())
 			{
-				if(g_Config.m_Debug)
-				{
-					/*
-					static NETSTATS prev_stats;
-					NETSTATS stats;
-					netserver_stats(net, &stats);
-
-					perf_next();
-
-					if(config.dbg_pref)
-						perf_dump(&rootscope);
-
-					dbg_msg("server", "send=%8d recv=%8d",
-						(stats.send_bytes - prev_stats.send_bytes)/reportinterval,
-						(stats.recv_bytes - prev_stats.recv_bytes)/reportinterval);
-
-					prev_stats = stats;
-					*/
-				}
+				if(g_Config.m_DbgPref)
+					PrintPerfLine();
 
 				ReportTime += time_freq()*ReportInterval;
 			}
 
-			// wait for incomming data
-			net_socket_read_wait(m_NetServer.Socket(), 5);
+			// with every instance asleep there is nothing to do until a packet or the next idle tick arrives
+			bool WasIdle = Idle;
+			Idle = true;
+			for(int i = 0; i < m_NumInstances && Idle; i++)
+				Idle = !InstanceAwake(i);
+			if(Idle != WasIdle)
+				Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", Idle ? "nobody is connected, suspending the game" : "resuming the game");
+
+			// wait for incomming data or the next tick, whichever comes first
+			int64 Deadline = TickStartTime(m_CurrentGameTick+1);
+			if(Idle)
+			{
+				Deadline = time_get()+time_freq()*IDLE_MAX_WAIT/1000;
+				if(IdleInterval)
+					Deadline = min(Deadline, TickStartTime((m_CurrentGameTick/IdleInterval+1)*IdleInterval));
+			}
+
+			if(m_pNetWait)
+				net_wait(m_pNetWait, Deadline);
+			else
+				net_socket_read_wait(m_NetServer.Socket(), clamp((int)((Deadline-time_get())*1000/time_freq())+1, 0, (int)IDLE_MAX_WAIT));
 		}
 	}
 
@@ -1911,7 +2166,18 @@ int CServer::Run()
 
 	m_Econ.Shutdown();
 
-	GameServer()->OnShutdown();
+	if(m_pNetWait)
+	{
+		net_wait_destroy(m_pNetWait);
+		m_pNetWait = 0;
+	}
+
+	for(int i = 0; i < m_NumInstances; i++)
+	{
+		CInstanceScope Scope(this, i);
+		GameServer()->OnShutdown();
+	}
+	DestroyInstances();
 	m_pMap->Unload();
 
 	if(m_pCurrentMapData)
@@ -1920,6 +2186,243 @@ int CServer::Run()
 	return m_RunServer == SERVER_REBOOT ? 1 : 0;
 }
 
+int CServer::RunBenchmark()
+{
+	m_Benchmark = true;
+
+	if(!GameServer()->OnInit())
+		return 0;
+
+	// process pending commands
+	m_pConsole->StoreCommands(false);
+
+	// spawn the dummies like CGameContext::CreateBot does, but mark them as dummies
+	// first so that nothing tries to send the welcome messages over the network
+	int aDummies[MAX_CLIENTS];
+	int NumDummies = 0;
+	for(int i = 0; i < MAX_CLIENTS && NumDummies < g_Config.m_DbgBenchDummies; i++)
+	{
+		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
+			continue;
+
+		InitDummy(i);
+		GameServer()->OnClientConnected(i);
+
+		// snap for them like for a client that sees everyone, no id translation
+		m_aClients[i].m_ClientSupportFlags = CClient::SUPPORTS_128P;
+		m_aClients[i].Reset();
+		CSnapStats::ResetClient(i);
+		aDummies[NumDummies++] = i;
+	}
+
+	dbg_msg("bench", "running %d ticks on '%s' (%s) with %d dummies", g_Config.m_DbgBenchTicks, m_aCurrentMap, GameServer()->GameType(), NumDummies);
+
+	CNetObj_PlayerInput aInputs[MAX_CLIENTS];
+	int aInputChange[MAX_CLIENTS];
+	mem_zero(aInputs, sizeof(aInputs));
+	mem_zero(aInputChange, sizeof(aInputChange));
+	unsigned Seed = (unsigned)g_Config.m_DbgBenchSeed;
+
+	m_GameStartTime = time_get();
+	CProfiler::Reset();
+	int64 StartTime = time_get();
+
+	for(int t = 0; t < g_Config.m_DbgBenchTicks; t++)
+	{
+		m_CurrentGameTick++;
+
+		// randomized input, every dummy keeps doing the same thing for a short while
+		CProfiler::Begin(CProfiler::PHASE_INPUT);
+		for(int d = 0; d < NumDummies; d++)
+		{
+			CNetObj_PlayerInput *pInput = &aInputs[d];
+			if(aInputChange[d]-- <= 0)
+			{
+				Seed = Seed*1103515245+12345;
+				unsigned r = Seed>>8;
+				aInputChange[d] = 5+r%45;
+				pInput->m_Direction = (int)(r%3)-1;
+				pInput->m_Jump = (r>>2)%4 == 0;
+				pInput->m_Hook = (r>>4)%3 == 0;
+				pInput->m_TargetX = (int)((r>>6)%512)-256;
+				pInput->m_TargetY = (int)((r>>15)%512)-256;
+				// r only has 24 bits, the weapon switch gets a step of its own
+				Seed = Seed*1103515245+12345;
+				r = Seed>>8;
+				if((r>>16)%8 == 0)
+					pInput->m_WantedWeapon = 1+(r>>19)%NUM_WEAPONS;
+			}
+
+			// fire is a press counter, odd means pressed
+			if((m_CurrentGameTick+d)%10 == 0)
+				pInput->m_Fire = (pInput->m_Fire+1)&INPUT_STATE_MASK;
+
+			GameServer()->OnClientDirectInput(aDummies[d], pInput);
+			GameServer()->OnClientPredictedInput(aDummies[d], pInput);
+		}
+		CProfiler::End(CProfiler::PHASE_INPUT);
+
+		{
+			PROFILE_SCOPE(PHASE_TICK);
+			GameServer()->OnTick();
+		}
+
+		if(g_Config.m_SvHighBandwidth || (m_CurrentGameTick%2) == 0)
+		{
+			DoSnapshot();
+
+			// pretend every snapshot got acked right away
+			for(int d = 0; d < NumDummies; d++)
+			{
+				m_aClients[aDummies[d]].m_LastAckedSnapshot = m_CurrentGameTick;
+				m_aClients[aDummies[d]].m_SnapRate = CClient::SNAPRATE_FULL;
+			}
+		}
+
+		// nothing to wait for, so the gc gets exactly its budget
+		CLua::Lua()->GC()->Step(time_get()+time_freq()*g_Config.m_SvLuaGcBudget/1000000);
+
+		CProfiler::NextFrame();
+	}
+
+	int64 Duration = time_get()-StartTime;
+	WriteBenchmarkResults(NumDummies, Duration);
+
+	GameServer()->OnShutdown();
+	m_pMap->Unload();
+
+	if(m_pCurrentMapData)
+		mem_free(m_pCurrentMapData);
+
+	m_Benchmark = false;
+	return 0;
+}
+
+void CServer::WriteBenchmarkResults(int NumDummies, int64 Duration)
+{
+	const int Ticks = g_Config.m_DbgBenchTicks;
+	const double Freq = (double)time_freq();
+
+	dbg_msg("bench", "%d ticks in %.2f ms, %.1f ticks/s", Ticks, Duration*1000.0/Freq, Ticks/(Duration/Freq));
+	for(int i = 0; i < CProfiler::NUM_PHASES; i++)
+	{
+		const CProfiler::CPhase *pPhase = CProfiler::Phase(i);
+		dbg_msg("bench", "%-10s %8.1f us/tick, max %8.1f us, %d calls", CProfiler::PhaseName(i),
+			pPhase->m_Total*1000000.0/Freq/Ticks, pPhase->m_Max*1000000.0/Freq, pPhase->m_Calls);
+	}
+
+	IOHANDLE File = Storage()->OpenFile(g_Config.m_DbgBenchOutput, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+	{
+		dbg_msg("bench", "failed to open '%s' for writing", g_Config.m_DbgBenchOutput);
+		return;
+	}
+
+	char aBuf[512];
+	str_format(aBuf, sizeof(aBuf), "{\n\t\"map\": \"%s\",\n\t\"gametype\": \"%s\",\n\t\"dummies\": %d,\n\t\"ticks\": %d,\n\t\"seed\": %d,\n\t\"duration_ms\": %.3f,\n\t\"phases\": {",
+		m_aCurrentMap, GameServer()->GameType(), NumDummies, Ticks, g_Config.m_DbgBenchSeed, Duration*1000.0/Freq);
+	io_write(File, aBuf, str_length(aBuf));
+
+	// the percentiles only cover the last CProfiler::HISTORY_SIZE ticks
+	for(int i = 0; i < CProfiler::NUM_PHASES; i++)
+	{
+		const CProfiler::CPhase *pPhase = CProfiler::Phase(i);
+		CProfiler::CStats Stats;
+		CProfiler::GetStats(i, &Stats);
+		str_format(aBuf, sizeof(aBuf), "%s\n\t\t\"%s\": { \"calls\": %d, \"total_us\": %.1f, \"per_tick_us\": %.3f, \"max_us\": %.1f, \"p50_us\": %.1f, \"p99_us\": %.1f }",
+			i == 0 ? "" : ",", CProfiler::PhaseName(i), pPhase->m_Calls,
+			pPhase->m_Total*1000000.0/Freq, pPhase->m_Total*1000000.0/Freq/Ticks, pPhase->m_Max*1000000.0/Freq, Stats.m_P50, Stats.m_P99);
+		io_write(File, aBuf, str_length(aBuf));
+	}
+
+	str_copy(aBuf, "\n\t}\n}", sizeof(aBuf));
+	io_write(File, aBuf, str_length(aBuf));
+	io_write_newline(File);
+	io_close(File);
+
+	dbg_msg("bench", "results written to '%s'", g_Config.m_DbgBenchOutput);
+}
+
+void CServer::PrintPerfLine()
+{
+	// one line for the log, only the phases that took any time
+	char aBuf[1024] = {0};
+	for(int i = 0; i < CProfiler::NUM_PHASES; i++)
+	{
+		CProfiler::CStats Stats;
+		CProfiler::GetStats(i, &Stats);
+		if(Stats.m_Max <= 0.0)
+			continue;
+
+		char aPhase[64];
+		str_format(aPhase, sizeof(aPhase), "%s%s=%.0f/%.0f/%.0f", aBuf[0] ? " " : "", CProfiler::PhaseName(i), Stats.m_P50, Stats.m_P99, Stats.m_Max);
+		str_append(aBuf, aPhase, sizeof(aBuf));
+	}
+	Console()->Printf(IConsole::OUTPUT_LEVEL_STANDARD, "perf", "p50/p99/max us: %s", aBuf);
+}
+
+void CServer::ConPerf(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pSelf = (CServer *)pUser;
+	int ClientID = pResult->GetCID();
+
+	if(pResult->NumArguments() > 0)
+	{
+		if(str_comp_nocase(pResult->GetString(0), "reset") == 0)
+		{
+			CProfiler::Reset();
+			pSelf->Console()->PrintTo(ClientID, "perf", "timings reset");
+		}
+		else
+			pSelf->Console()->PrintfTo(ClientID, "perf", "unknown argument '%s', try 'reset'", pResult->GetString(0));
+		return;
+	}
+
+	pSelf->Console()->PrintTo(ClientID, "perf", "phase          avg      p50      p99      max   (us per tick)");
+	for(int i = 0; i < CProfiler::NUM_PHASES; i++)
+	{
+		CProfiler::CStats Stats;
+		CProfiler::GetStats(i, &Stats);
+		pSelf->Console()->PrintfTo(ClientID, "perf", "%-10s %8.1f %8.1f %8.1f %8.1f", CProfiler::PhaseName(i), Stats.m_Avg, Stats.m_P50, Stats.m_P99, Stats.m_Max);
+	}
+}
+
+void CServer::ConSnapStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pSelf = (CServer *)pUser;
+	int ClientID = pResult->GetCID();
+	int Target = pResult->NumArguments() > 0 ? pResult->GetInteger(0) : -1;
+	if(Target < -1 || Target >= MAX_CLIENTS)
+	{
+		pSelf->Console()->PrintfTo(ClientID, "snap_stats", "invalid client id %d", Target);
+		return;
+	}
+
+	CSnapStats::CCounters Counters;
+	CSnapStats::Get(Target, &Counters);
+
+	if(Target == -1)
+		pSelf->Console()->PrintfTo(ClientID, "snap_stats", "all clients: %d bytes/s", Counters.m_Total);
+	else
+		pSelf->Console()->PrintfTo(ClientID, "snap_stats", "client %d '%s': %d bytes/s", Target, pSelf->ClientName(Target), Counters.m_Total);
+
+	static CNetObjHandler s_NetObjHandler;
+	for(int i = 0; i <= CSnapStats::MAX_TYPES; i++)
+	{
+		if(!Counters.m_aTypes[i])
+			continue;
+		if(i == CSnapStats::TYPE_OTHER)
+			pSelf->Console()->PrintfTo(ClientID, "snap_stats", "  type >=%-3d %-20s %8d bytes/s", i, "(other)", Counters.m_aTypes[i]);
+		else
+			pSelf->Console()->PrintfTo(ClientID, "snap_stats", "  type %-5d %-20s %8d bytes/s", i, i < NUM_NETOBJTYPES ? s_NetObjHandler.GetObjName(i) : "(custom)", Counters.m_aTypes[i]);
+	}
+	for(int i = 0; i < CSnapStats::NumOwners(); i++)
+	{
+		if(Counters.m_aOwners[i])
+			pSelf->Console()->PrintfTo(ClientID, "snap_stats", "  class %-25s %8d bytes/s", CSnapStats::OwnerName(i), Counters.m_aOwners[i]);
+	}
+}
+
 void CServer::ConKick(IConsole::IResult *pResult, void *pUser)
 {
 	if(pResult->NumArguments() > 1)
@@ -1957,6 +2460,12 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 			}
 			else
 				str_format(aBuf, sizeof(aBuf), "id=%d addr=%s connecting", i, aAddrStr);
+			if(pThis->m_NumInstances > 1)
+			{
+				char aInstanceStr[32];
+				str_formatb(aInstanceStr, " instance=%d", pThis->m_aClients[i].m_Instance);
+				str_appendb(aBuf, aInstanceStr);
+			}
 			pThis->Console()->PrintTo(pThis->m_RconExecClientID, "Server", aBuf);
 		}
 	}
@@ -2029,6 +2538,20 @@ void CServer::ConMapReload(IConsole::IResult *pResult, void *pUser)
 	((CServer *)pUser)->m_MapReload = 1;
 }
 
+void CServer::ConInstance(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	int Instance = pResult->GetInteger(0);
+	if(Instance < 0 || Instance >= pThis->m_NumInstances)
+	{
+		pThis->Console()->PrintfTo(pResult->GetCID(), "server", "there is no instance %d (0..%d)", Instance, pThis->m_NumInstances-1);
+		return;
+	}
+
+	CInstanceScope Scope(pThis, Instance);
+	pThis->Console()->ExecuteLine(pResult->GetString(1), pResult->GetCID());
+}
+
 int CServer::LuaConLuaDoStringPrintOverride(lua_State *L)
 {
 	CServer *pSelf = (CServer *)lua_touserdata(L, lua_upvalueindex(1));
@@ -2103,13 +2626,13 @@ void CServer::ConLuaStatus(IConsole::IResult *pResult, void *pUser)
 				[&](){
 					if(pResult->NumArguments() == 1)
 					{
-						pSelf->Console()->PrintTo(pResult->GetCID(), "lua_status/help", "Available commands: help, gc");
+						pSelf->Console()->PrintTo(pResult->GetCID(), "lua_status/help", "Available commands: help, gc, json, watchdog");
 						pSelf->Console()->PrintTo(pResult->GetCID(), "lua_status/help", "ONLY USE FOR DEBUGGING AND IF YOU KNOW WHAT YOU ARE DOING");
 					}
 					else
 					{
 						// help to a specific command
-						for(int i = 0; i < 2 /* XXX  increase this number when more commands are added */; i++)
+						for(int i = 0; i < 4 /* XXX  increase this number when more commands are added */; i++)
 						{
 							if(str_comp_nocase(pResult->GetString(1), aCommands[i].pCommand) == 0)
 							{
@@ -2123,19 +2646,36 @@ void CServer::ConLuaStatus(IConsole::IResult *pResult, void *pUser)
 			},
 			{
 				"gc",
-				"stop / restart / collect / step",
+				"stop / restart / collect / step / stats / reset",
 				"controls the garbage collector",
 				[&](){
 					if(str_comp_nocase(pResult->GetString(1), "stop") == 0)
 					{
-						lua_gc(L, LUA_GCSTOP, 0);
+						CLua::Lua()->GC()->Stop();
 						pSelf->Console()->PrintTo(pResult->GetCID(), "lua_status/gc", "garbage collector stopped!");
 					}
 					else if(str_comp_nocase(pResult->GetString(1), "restart") == 0)
 					{
-						lua_gc(L, LUA_GCRESTART, 0);
+						CLua::Lua()->GC()->Restart();
 						pSelf->Console()->PrintTo(pResult->GetCID(), "lua_status/gc", "garbage collector restarted!");
 					}
+					else if(str_comp_nocase(pResult->GetString(1), "stats") == 0)
+					{
+						const CLuaGC::CStats *pStats = CLua::Lua()->GC()->Stats();
+						const double ToMs = 1000.0/time_freq();
+						pSelf->Console()->PrintfTo(pResult->GetCID(), "lua_status/gc", "%s; %i KB in use, %i KB alive after the last cycle, allocating %i KB/s",
+												   CLua::Lua()->GC()->Stopped() ? "stopped" : g_Config.m_SvLuaGcBudget ? "paced by the server" : "paced by lua",
+												   (int)(pStats->m_Memory/1024), (int)(pStats->m_LiveMemory/1024), (int)(pStats->m_AllocRate*pSelf->TickSpeed()/1024));
+						pSelf->Console()->PrintfTo(pResult->GetCID(), "lua_status/gc", "%i cycles in %i steps, %.2fms total, longest tick %.2fms",
+												   pStats->m_Cycles, pStats->m_Steps, pStats->m_Time*ToMs, pStats->m_MaxPause*ToMs);
+						pSelf->Console()->PrintfTo(pResult->GetCID(), "lua_status/gc", "%i full collections as backstop, the last one took %.2fms",
+												   pStats->m_FullCollects, pStats->m_LastFullPause*ToMs);
+					}
+					else if(str_comp_nocase(pResult->GetString(1), "reset") == 0)
+					{
+						CLua::Lua()->GC()->ResetStats();
+						pSelf->Console()->PrintTo(pResult->GetCID(), "lua_status/gc", "statistics reset");
+					}
 					else if(str_comp_nocase(pResult->GetString(1), "collect") == 0)
 					{
 						int MemBefore = lua_gc(L, LUA_GCCOUNT, 0)*1024 + lua_gc(L, LUA_GCCOUNTB, 0);
@@ -2160,6 +2700,47 @@ void CServer::ConLuaStatus(IConsole::IResult *pResult, void *pUser)
 							pSelf->Console()->PrintfTo(pResult->GetCID(), "lua_status/gc", "invalid argument '%s'", pResult->GetString(1));
 					}
 				}
+			},
+			{
+				"json",
+				"[iterations]",
+				"benchmarks the json conversion on a sample table",
+				[&](){
+					int Iterations = pResult->GetString(1)[0] ? max(str_toint(pResult->GetString(1)), 1) : 100;
+					CLuaJson::CBenchmark Bench;
+					CLuaJson::Benchmark(L, Iterations, &Bench);
+					const double ToUs = 1000000.0/time_freq()/Iterations;
+					pSelf->Console()->PrintfTo(pResult->GetCID(), "lua_status/json", "lua to string: %.1fus with json_value (%i bytes), %.1fus streamed (%i bytes)",
+											   Bench.m_TreeWrite*ToUs, Bench.m_TreeSize, Bench.m_StreamWrite*ToUs, Bench.m_StreamSize);
+					pSelf->Console()->PrintfTo(pResult->GetCID(), "lua_status/json", "string to lua: %.1fus with json_value, %.1fus streamed",
+											   Bench.m_TreeRead*ToUs, Bench.m_StreamRead*ToUs);
+				}
+			},
+			{
+				"watchdog",
+				"stats / reset",
+				"shows which classes ran too long or enables the disabled ones again",
+				[&](){
+					if(str_comp_nocase(pResult->GetString(1), "reset") == 0)
+					{
+						CLua::Lua()->Watchdog()->Reset();
+						pSelf->Console()->PrintTo(pResult->GetCID(), "lua_status/watchdog", "statistics reset, all classes enabled");
+					}
+					else if(pResult->GetString(1)[0] == '\0' || str_comp_nocase(pResult->GetString(1), "stats") == 0)
+					{
+						const std::map<std::string, CLuaWatchdog::CClassStats> &Stats = CLua::Lua()->Watchdog()->Stats();
+						pSelf->Console()->PrintfTo(pResult->GetCID(), "lua_status/watchdog", "%s; %ims per callback, %ims per tick, disabling after %i aborts",
+												   CLuaWatchdog::Enabled() ? "watching" : "off", g_Config.m_SvLuaCallbackBudget, g_Config.m_SvLuaTickBudget, g_Config.m_SvLuaWatchdogStrikes);
+						if(Stats.empty())
+							pSelf->Console()->PrintTo(pResult->GetCID(), "lua_status/watchdog", "no class ran too long so far");
+						for(std::map<std::string, CLuaWatchdog::CClassStats>::const_iterator it = Stats.begin(); it != Stats.end(); ++it)
+							pSelf->Console()->PrintfTo(pResult->GetCID(), "lua_status/watchdog", "%s: %i aborts, %i over the tick budget, %i slow calls (longest %.2fms)%s",
+													   it->first.c_str(), it->second.m_Aborts, it->second.m_TickAborts, it->second.m_SlowCalls,
+													   it->second.m_MaxTime*1000.0/time_freq(), it->second.m_Disabled ? ", DISABLED" : "");
+					}
+					else
+						pSelf->Console()->PrintfTo(pResult->GetCID(), "lua_status/watchdog", "invalid argument '%s'", pResult->GetString(1));
+				}
 			}
 	};
 
@@ -2423,6 +3004,9 @@ void CServer::RegisterCommands()
 {
 	m_pConsole = Kernel()->RequestInterface<IConsole>();
 	m_pGameServer = Kernel()->RequestInterface<IGameServer>();
+	m_aInstances[0].m_pGameServer = m_pGameServer;
+	m_aInstances[0].m_pLua = Kernel()->RequestInterface<ILua>();
+	m_NumInstances = 1;
 	m_pMap = Kernel()->RequestInterface<IEngineMap>();
 	m_pStorage = Kernel()->RequestInterface<IStorage>();
 
@@ -2437,6 +3021,7 @@ void CServer::RegisterCommands()
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
 
 	Console()->Register("reload", "", CFGFLAG_SERVER, ConMapReload, this, "Reload the map");
+	Console()->Register("instance", "ir", CFGFLAG_SERVER, ConInstance, this, "Execute a command in the given game instance (see sv_instances)");
 
 	// lua
 	Console()->Register("lua", "r", CFGFLAG_SERVER, ConLuaDoString, this, "Execute the given line of lua code");
@@ -2448,6 +3033,8 @@ void CServer::RegisterCommands()
 
 	// debug
 	Console()->Register("debug_dump_id_map", "?i", CFGFLAG_SERVER, ConDbgDumpIDMap, this, "");
+	Console()->Register("perf", "?s", CFGFLAG_SERVER, ConPerf, this, "Show how long the phases of the recent ticks took (or 'perf reset')");
+	Console()->Register("snap_stats", "?i", CFGFLAG_SERVER, ConSnapStats, this, "Show the snapshot bandwidth by item type and lua class of a client (or of all clients)");
 
 	Console()->Chain("sv_name", ConchainSpecialInfoupdate, this);
 	Console()->Chain("password", ConchainSpecialInfoupdate, this);
@@ -2480,7 +3067,18 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 {
 	dbg_assert(Type >= 0 && Type <=0xffff, "incorrect type");
 	dbg_assert(ID >= 0 && ID <=0xffff, "incorrect id");
-	return ID < 0 ? 0 : m_SnapshotBuilder.NewItem(Type, ID, Size);
+	if(ID < 0)
+		return 0;
+
+	void *pItem = m_SnapshotBuilder.NewItem(Type, ID, Size);
+	if(pItem)
+		m_aSnapItemOwners[m_NumSnapItems++] = (unsigned char)m_SnapOwner;
+	return pItem;
+}
+
+void CServer::SnapSetOwner(const char *pLuaClass)
+{
+	m_SnapOwner = CSnapStats::OwnerIndex(pLuaClass);
 }
 
 void CServer::SnapSetStaticsize(int ItemType, int Size)
@@ -73,6 +73,7 @@ class CServer : public IServer
 	class IStorage *m_pStorage;
 public:
 	class IGameServer *GameServer() { return m_pGameServer; }
+	void ForEachInstance(void (*pfnFunc)(void *pUser), void *pUser);
 	class IConsole *Console() { return m_pConsole; }
 	class IStorage *Storage() { return m_pStorage; }
 
@@ -84,6 +85,8 @@ public:
 		AUTHED_CUSTOM,
 
 		MAX_RCONCMD_SEND=16,
+
+		IDLE_MAX_WAIT=1000, // ms, the econ and the master server registration still need their updates
 	};
 
 	class CClient
@@ -146,18 +149,57 @@ public:
 
 		const IConsole::CCommandInfo *m_pRconCmdToSend;
 
+		int m_Instance; // the game instance the client plays in
+
 		void Reset();
 	};
 
+	/*
+		The game instances (see sv_instances) share the socket, the clients,
+		the snapshot IDs and the map, but each has its own game context and lua
+		state. Exactly one of them is active at a time: GameServer() and
+		CLua::Lua() point to it, and broadcasts only reach its clients.
+	*/
+	class CInstance
+	{
+	public:
+		class IGameServer *m_pGameServer;
+		class ILua *m_pLua;
+	};
+	CInstance m_aInstances[MAX_INSTANCES];
+	int m_NumInstances;
+	int m_ActiveInstance;
+
+	// activates an instance until it goes out of scope
+	class CInstanceScope
+	{
+		class CServer *m_pServer;
+		int m_PrevInstance;
+	public:
+		CInstanceScope(class CServer *pServer, int Instance) : m_pServer(pServer), m_PrevInstance(pServer->m_ActiveInstance) { pServer->ActivateInstance(Instance); }
+		~CInstanceScope() { m_pServer->ActivateInstance(m_PrevInstance); }
+	};
+
+	void ActivateInstance(int Instance);
+	void CreateInstances();
+	void DestroyInstances();
+	int NumInstanceClients(int Instance) const; // without the dummies
+	int ChooseInstance() const;
+	bool InstanceAwake(int Instance) const;
+
 	CClient m_aClients[MAX_CLIENTS];
 	IDMapT m_aaIDMap[MAX_CLIENTS][DDNET_MAX_CLIENTS]; // for each client: Index=TranslatedID, Data=InternalID  --  "who is displayed as X?"
 	IDMapT m_aaIDMapReverse[MAX_CLIENTS][MAX_CLIENTS]; // reverse map for quick access: Index=InternalID, Data=MappedID  --  "as what is CID displayed?"
 
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+	int m_SnapOwner;
+	int m_NumSnapItems;
+	unsigned char m_aSnapItemOwners[CSnapshotBuilder::MAX_ITEMS]; // owner of each item in the builder, see CSnapStats
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
+	NETWAIT *m_pNetWait; // the game and econ sockets, the main loop sleeps on them
 	CServerBan m_ServerBan;
 
 	IEngineMap *m_pMap;
@@ -176,6 +218,7 @@ public:
 	char m_aShutdownReason[128];
 	int m_MapReload;
 	int m_LuaReinit; // 0 = off, <0 = all, >0 = ID
+	bool m_Benchmark;
 	int m_RconExecClientID;
 	int m_PrintCBIndex;
 	int m_PrintToCBIndex;
@@ -224,6 +267,7 @@ public:
 	int ClientCountry(int ClientID);
 	bool ClientIngame(int ClientID);
 	bool ClientIsDummy(int ClientID);
+	bool ClientSlotFree(int ClientID);
 	int MaxClients() const;
 
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID);
@@ -241,6 +285,8 @@ public:
 	int ResetIdMapSlotOf(int ClientID, int SlotOfWhom);
 	void DumpIdMap(int ForClientID) const;
 
+	void SnapBuilderInit();
+	void AccountSnapshot(int ClientID, class CSnapshot *pData, const void *pDeltaData, int DeltaSize, int CompressedSize);
 	void DoSnapshot();
 
 	static int NewClientCallback(int ClientID, void *pUser);
@@ -277,6 +323,9 @@ public:
 
 	void InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, IConsole *pConsole);
 	int Run();
+	int RunBenchmark();
+	void WriteBenchmarkResults(int NumDummies, int64 Duration);
+	void PrintPerfLine();
 
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
@@ -285,6 +334,7 @@ public:
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
+	static void ConInstance(IConsole::IResult *pResult, void *pUser);
 	static int LuaConLuaDoStringPrintOverride(class lua_State *L);
 	static void ConLuaDoString(IConsole::IResult *pResult, void *pUser);
 	static void ConLuaStatus(IConsole::IResult *pResult, void *pUser);
@@ -292,6 +342,8 @@ public:
 	static void ConLuaReinitQuick(IConsole::IResult *pResult, void *pUser);
 	static void ConLuaListClasses(IConsole::IResult *pResult, void *pUser);
 	static void ConDbgDumpIDMap(IConsole::IResult *pResult, void *pUser);
+	static void ConPerf(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapStats(IConsole::IResult *pResult, void *pUser);
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMapChange(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -306,6 +358,7 @@ public:
 	virtual void SnapFreeID(int ID);
 	virtual void *SnapNewItem(int Type, int ID, int Size);
 	void SnapSetStaticsize(int ItemType, int Size);
+	void SnapSetOwner(const char *pLuaClass);
 };
 
 #endif
@@ -4,6 +4,11 @@
 
 #include "compression.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define VARINT_SSE2
+#endif
+
 // Format: ESDDDDDD EDDDDDDD EDD... Extended, Data, Sign
 unsigned char *CVariableInt::Pack(unsigned char *pDst, int i)
 {
@@ -60,11 +65,84 @@ const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut
 }
 
 
+#if defined(VARINT_SSE2)
+// Most of a snapshot delta are small diffs that pack into a single byte (-64..63).
+// These helpers handle whole blocks of such values at once and report which lanes
+// did fit, so the caller can fall back to Pack/Unpack for the rest.
+
+// packs 8 ints into 8 bytes, returns a bitmask of the lanes that fit into a single byte
+static inline int PackBlock8(unsigned char *pDst, const int *pSrc)
+{
+	const __m128i Extend = _mm_set1_epi32(0x3F);
+	const __m128i SignBit = _mm_set1_epi32(0x40);
+
+	__m128i Lo = _mm_loadu_si128((const __m128i *)pSrc);
+	__m128i Hi = _mm_loadu_si128((const __m128i *)(pSrc+4));
+	__m128i SignLo = _mm_srai_epi32(Lo, 31);
+	__m128i SignHi = _mm_srai_epi32(Hi, 31);
+	Lo = _mm_xor_si128(Lo, SignLo); // if(i<0) i = ~i
+	Hi = _mm_xor_si128(Hi, SignHi);
+
+	int Fits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(Lo, Extend)));
+	Fits |= _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(Hi, Extend)))<<4;
+
+	Lo = _mm_or_si128(Lo, _mm_and_si128(SignLo, SignBit));
+	Hi = _mm_or_si128(Hi, _mm_and_si128(SignHi, SignBit));
+	__m128i Bytes = _mm_packus_epi16(_mm_packs_epi32(Lo, Hi), _mm_setzero_si128());
+	_mm_storel_epi64((__m128i *)pDst, Bytes);
+	return ~Fits&0xFF;
+}
+
+// unpacks 16 single byte values into 16 ints
+static inline void UnpackBlock16(int *pDst, __m128i Bytes)
+{
+	const __m128i DataMask = _mm_set1_epi8(0x3F);
+	const __m128i SignBit = _mm_set1_epi8(0x40);
+
+	__m128i Sign = _mm_cmpeq_epi8(_mm_and_si128(Bytes, SignBit), SignBit);
+	__m128i Values = _mm_xor_si128(_mm_and_si128(Bytes, DataMask), Sign); // if(sign) i = ~i
+
+	// sign extend 8bit -> 16bit -> 32bit
+	__m128i Lo = _mm_unpacklo_epi8(Values, Sign);
+	__m128i Hi = _mm_unpackhi_epi8(Values, Sign);
+	_mm_storeu_si128((__m128i *)pDst, _mm_unpacklo_epi16(Lo, _mm_srai_epi16(Lo, 15)));
+	_mm_storeu_si128((__m128i *)(pDst+4), _mm_unpackhi_epi16(Lo, _mm_srai_epi16(Lo, 15)));
+	_mm_storeu_si128((__m128i *)(pDst+8), _mm_unpacklo_epi16(Hi, _mm_srai_epi16(Hi, 15)));
+	_mm_storeu_si128((__m128i *)(pDst+12), _mm_unpackhi_epi16(Hi, _mm_srai_epi16(Hi, 15)));
+}
+#endif
+
 long CVariableInt::Decompress(const void *pSrc_, int Size, void *pDst_)
 {
 	const unsigned char *pSrc = (unsigned char *)pSrc_;
 	const unsigned char *pEnd = pSrc + Size;
 	int *pDst = (int *)pDst_;
+
+#if defined(VARINT_SSE2)
+	while(pEnd-pSrc >= 16)
+	{
+		__m128i Bytes = _mm_loadu_si128((const __m128i *)pSrc);
+		int Extended = _mm_movemask_epi8(Bytes);
+		if(Extended == 0)
+		{
+			UnpackBlock16(pDst, Bytes);
+			pSrc += 16;
+			pDst += 16;
+			continue;
+		}
+
+		// handle the leading single byte values, then the extended one
+		while(!(Extended&1))
+		{
+			Extended >>= 1;
+			pSrc = CVariableInt::Unpack(pSrc, pDst);
+			pDst++;
+		}
+		pSrc = CVariableInt::Unpack(pSrc, pDst);
+		pDst++;
+	}
+#endif
+
 	while(pSrc < pEnd)
 	{
 		pSrc = CVariableInt::Unpack(pSrc, pDst);
@@ -78,6 +156,34 @@ long CVariableInt::Compress(const void *pSrc_, int Size, void *pDst_)
 	int *pSrc = (int *)pSrc_;
 	unsigned char *pDst = (unsigned char *)pDst_;
 	Size /= 4;
+
+#if defined(VARINT_SSE2)
+	while(Size >= 8)
+	{
+		// the block always writes 8 bytes, but 8 ints never pack into less than that
+		int Fits = PackBlock8(pDst, pSrc);
+		if(Fits == 0xFF)
+		{
+			pDst += 8;
+			pSrc += 8;
+			Size -= 8;
+			continue;
+		}
+
+		// keep the leading single byte values, then pack the extended one
+		while(Fits&1)
+		{
+			Fits >>= 1;
+			pDst++;
+			pSrc++;
+			Size--;
+		}
+		pDst = CVariableInt::Pack(pDst, *pSrc);
+		pSrc++;
+		Size--;
+	}
+#endif
+
 	while(Size)
 	{
 		pDst = CVariableInt::Pack(pDst, *pSrc);
@@ -86,4 +192,3 @@ long CVariableInt::Compress(const void *pSrc_, int Size, void *pDst_)
 	}
 	return (long)(pDst-(unsigned char *)pDst_);
 }
-
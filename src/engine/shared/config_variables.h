@@ -85,6 +85,13 @@ MACRO_CONFIG_INT(SvExternalPort, sv_external_port, 0, 0, 0, CFGFLAG_SERVER, "Ext
 MACRO_CONFIG_STR(SvMap, sv_map, 128, "dm1", CFGFLAG_SERVER, "Map to use on the server")
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, 8, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIP, sv_max_clients_per_ip, 4, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
+MACRO_CONFIG_INT(SvInstances, sv_instances, 1, 1, MAX_INSTANCES, CFGFLAG_SERVER, "Number of separate game worlds the server hosts behind its port (takes effect on restart)")
+MACRO_CONFIG_INT(SvInstanceRoute, sv_instance_route, 0, 0, 1, CFGFLAG_SERVER, "How joining clients are put into the game instances (0 = the one with the fewest clients, 1 = fill them in order)")
+MACRO_CONFIG_INT(SvInstanceMaxClients, sv_instance_max_clients, 0, 0, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients per game instance, the rest go where there is room (0 = no limit)")
+MACRO_CONFIG_INT(SvInstanceSleep, sv_instance_sleep, 1, 0, 1, CFGFLAG_SERVER, "Stop ticking and snapping game instances nobody is connected to (with more than one instance)")
+MACRO_CONFIG_INT(SvIdle, sv_idle, 0, 0, 1, CFGFLAG_SERVER, "Suspend the game while nobody is connected and only wake up for network traffic")
+MACRO_CONFIG_INT(SvIdleTickrate, sv_idle_tickrate, 1, 0, SERVER_TICK_SPEED, CFGFLAG_SERVER, "How often per second a suspended game still gets the lua OnIdleTick callback, e.g. for its timers (0 = never)")
+MACRO_CONFIG_INT(SvNetThread, sv_net_thread, 0, 0, 1, CFGFLAG_SERVER, "Receive, unpack, compress and send the game packets on a thread of their own (takes effect on restart)")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 0, 0, 1, CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
 MACRO_CONFIG_INT(SvRegister, sv_register, 1, 0, 1, CFGFLAG_SERVER, "Register server with master server for public listing")
 MACRO_CONFIG_STR(SvRconPassword, sv_rcon_password, 32, "", CFGFLAG_SERVER, "Remote console password (full access)")
@@ -93,6 +100,13 @@ MACRO_CONFIG_INT(SvRconMaxTries, sv_rcon_max_tries, 3, 0, 100, CFGFLAG_SERVER, "
 MACRO_CONFIG_INT(SvRconBantime, sv_rcon_bantime, 5, 0, 1440, CFGFLAG_SERVER, "The time a client gets banned if remote console authentication fails. 0 makes it just use kick")
 MACRO_CONFIG_INT(SvAutoDemoRecord, sv_auto_demo_record, 0, 0, 1, CFGFLAG_SERVER, "Automatically record demos")
 MACRO_CONFIG_INT(SvAutoDemoMax, sv_auto_demo_max, 10, 0, 1000, CFGFLAG_SERVER, "Maximum number of automatically recorded demos (0 = no limit)")
+MACRO_CONFIG_INT(SvLuaGcBudget, sv_lua_gc_budget, 1000, 0, 20000, CFGFLAG_SERVER, "Time in microseconds per tick the lua garbage collector may use after the snapshots (0 = let lua pace it itself)")
+MACRO_CONFIG_INT(SvLuaBytecodeCache, sv_lua_bytecode_cache, 1, 0, 1, CFGFLAG_SERVER, "Keep the compiled gametype scripts in the save directory to speed up loading them")
+MACRO_CONFIG_INT(SvLuaAsyncBudget, sv_lua_async_budget, 2000, 0, 20000, CFGFLAG_SERVER, "Time in microseconds per tick for resuming lua coroutines whose async operation finished (at least one is resumed every tick)")
+MACRO_CONFIG_INT(SvLuaCallbackBudget, sv_lua_callback_budget, 0, 0, 10000, CFGFLAG_SERVER, "Time in milliseconds a single lua callback may run before the watchdog aborts it (0 = no limit). Turning on the watchdog loads the gametype scripts without the JIT, which makes them slower")
+MACRO_CONFIG_INT(SvLuaTickBudget, sv_lua_tick_budget, 0, 0, 10000, CFGFLAG_SERVER, "Time in milliseconds all lua callbacks of a tick may take together before the watchdog aborts them (0 = no limit). Turning on the watchdog loads the gametype scripts without the JIT, which makes them slower")
+MACRO_CONFIG_INT(SvLuaWatchdogStrikes, sv_lua_watchdog_strikes, 0, 0, 100, CFGFLAG_SERVER, "Disable the events of a lua class after the watchdog aborted it this many times, until the gametype is reloaded (0 = never)")
+MACRO_CONFIG_INT(SvLuaGcBackstop, sv_lua_gc_backstop, 400, 150, 10000, CFGFLAG_SERVER, "Force a full lua garbage collection once the memory reaches this percentage of what was alive after the last cycle")
 
 MACRO_CONFIG_STR(EcBindaddr, ec_bindaddr, 128, "localhost", CFGFLAG_ECON, "Address to bind the external console to. Anything but 'localhost' is dangerous")
 MACRO_CONFIG_INT(EcPort, ec_port, 0, 0, 0, CFGFLAG_ECON, "Port to use for the external console")
@@ -104,9 +118,13 @@ MACRO_CONFIG_INT(EcOutputLevel, ec_output_level, 1, 0, 2, CFGFLAG_ECON, "Adjusts
 MACRO_CONFIG_INT(Debug, debug, 0, 0, 1, CFGFLAG_CLIENT|CFGFLAG_SERVER, "Debug mode")
 MACRO_CONFIG_INT(DbgStress, dbg_stress, 0, 0, 0, CFGFLAG_CLIENT|CFGFLAG_SERVER, "Stress systems")
 MACRO_CONFIG_INT(DbgStressNetwork, dbg_stress_network, 0, 0, 0, CFGFLAG_CLIENT|CFGFLAG_SERVER, "Stress network")
-MACRO_CONFIG_INT(DbgPref, dbg_pref, 0, 0, 1, CFGFLAG_SERVER, "Performance outputs")
+MACRO_CONFIG_INT(DbgPref, dbg_pref, 0, 0, 1, CFGFLAG_SERVER, "Performance outputs (logs the tick phase timings every few seconds)")
 MACRO_CONFIG_INT(DbgGraphs, dbg_graphs, 0, 0, 1, CFGFLAG_CLIENT, "Performance graphs")
 MACRO_CONFIG_INT(DbgHitch, dbg_hitch, 0, 0, 0, CFGFLAG_SERVER, "Hitch warnings")
 MACRO_CONFIG_STR(DbgStressServer, dbg_stress_server, 32, "localhost", CFGFLAG_CLIENT, "Server to stress")
 MACRO_CONFIG_INT(DbgResizable, dbg_resizable, 0, 0, 0, CFGFLAG_CLIENT, "Enables window resizing")
+MACRO_CONFIG_INT(DbgBenchTicks, dbg_bench_ticks, 0, 0, 0, CFGFLAG_SERVER, "Run a headless benchmark for this many ticks and quit (0 = off)")
+MACRO_CONFIG_INT(DbgBenchDummies, dbg_bench_dummies, 16, 0, MAX_CLIENTS, CFGFLAG_SERVER, "Number of dummies to spawn for the benchmark")
+MACRO_CONFIG_INT(DbgBenchSeed, dbg_bench_seed, 1, 0, 0, CFGFLAG_SERVER, "Seed for the randomized input of the benchmark dummies")
+MACRO_CONFIG_STR(DbgBenchOutput, dbg_bench_output, 128, "bench.json", CFGFLAG_SERVER, "File to write the benchmark results to")
 #endif
@@ -924,25 +924,56 @@ void CConsole::RegisterLua(const char *pName, const char *pParams, const char *p
 	if(!LuaFunc.isFunction())
 		luaL_error(L, "parameter 3 must be a function");
 
+	CLua *pLua = CLua::Lua();
 	CCommand *pCommand = FindCommand(pName, CFGFLAG_SERVER);
 	if(pCommand)
 	{
 		if(!pCommand->m_Temp)
 			luaL_error(L, "the command '%s' can't be overwritten!", pName);
-		else
-			DeregisterTemp(pName);
+
+		// the lua state of another game instance has it already, share the entry
+		CLuaCommand *pLuaCommand = static_cast<CLuaCommand *>(pCommand->m_pUserData);
+		if(pLuaCommand && (pLuaCommand->m_lFuncs.size() > 1 || pLuaCommand->m_lFuncs[0].first != pLua))
+		{
+			for(unsigned i = 0; i < pLuaCommand->m_lFuncs.size(); i++)
+			{
+				if(pLuaCommand->m_lFuncs[i].first == pLua)
+				{
+					*pLuaCommand->m_lFuncs[i].second = LuaFunc;
+					return;
+				}
+			}
+
+			LuaRef *pCbRef = new luabridge::LuaRef(L);
+			*pCbRef = LuaFunc;
+			pLuaCommand->m_lFuncs.push_back(std::make_pair(pLua, pCbRef));
+			pLua->GetResMan()->RegisterConsoleCommand(pName);
+			return;
+		}
+
+		DeregisterTemp(pName);
 	}
 
 	LuaRef *pCbRef = new luabridge::LuaRef(L);
 	*pCbRef = LuaFunc;
+	CLuaCommand *pLuaCommand = new CLuaCommand;
+	pLuaCommand->m_lFuncs.push_back(std::make_pair(pLua, pCbRef));
 
-	RegisterTemp(pName, pParams, CFGFLAG_SERVER, pHelp, CConsole::LuaCommandCallback, pCbRef);
-	CLua::Lua()->GetResMan()->RegisterConsoleCommand(pName);
+	RegisterTemp(pName, pParams, CFGFLAG_SERVER, pHelp, CConsole::LuaCommandCallback, pLuaCommand);
+	pLua->GetResMan()->RegisterConsoleCommand(pName);
 }
 
 void CConsole::LuaCommandCallback(IResult *pResult, void *pUserData)
 {
-	LuaRef *pCbRef = static_cast<LuaRef *>(pUserData);
+	// run the function of the game instance the command was issued in
+	CLuaCommand *pLuaCommand = static_cast<CLuaCommand *>(pUserData);
+	LuaRef *pCbRef = 0;
+	for(unsigned i = 0; i < pLuaCommand->m_lFuncs.size(); i++)
+		if(pLuaCommand->m_lFuncs[i].first == CLua::Lua())
+			pCbRef = pLuaCommand->m_lFuncs[i].second;
+	if(!pCbRef)
+		return;
+
 	try
 	{
 		(*pCbRef)(pResult);
@@ -951,6 +982,32 @@ void CConsole::LuaCommandCallback(IResult *pResult, void *pUserData)
 	}
 }
 
+bool CConsole::ReleaseLuaCommand(CCommand *pCommand)
+{
+	// userdata for temp commands is only set for commands registered by lua
+	CLuaCommand *pLuaCommand = static_cast<CLuaCommand *>(pCommand->m_pUserData);
+	if(!pLuaCommand)
+		return false;
+
+	for(unsigned i = 0; i < pLuaCommand->m_lFuncs.size(); i++)
+	{
+		if(pLuaCommand->m_lFuncs[i].first == CLua::Lua())
+		{
+			delete pLuaCommand->m_lFuncs[i].second;
+			pLuaCommand->m_lFuncs.erase(pLuaCommand->m_lFuncs.begin()+i);
+			CLua::Lua()->GetResMan()->DeregisterConsoleCommand(pCommand->m_pName);
+			break;
+		}
+	}
+
+	if(!pLuaCommand->m_lFuncs.empty())
+		return true;
+
+	delete pLuaCommand;
+	pCommand->m_pUserData = NULL;
+	return false;
+}
+
 void CConsole::RegisterTemp(const char *pName, const char *pParams,	int Flags, const char *pHelp, FCommandCallback pfnCb, void *pUser)
 {
 	CCommand *pCommand;
@@ -990,6 +1047,17 @@ void CConsole::DeregisterTemp(const char *pName)
 	if(!m_pFirstCommand)
 		return;
 
+	// keep lua commands around while the lua state of another game instance still has them
+	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	{
+		if(pCommand->m_Temp && str_comp(pCommand->m_pName, pName) == 0)
+		{
+			if(ReleaseLuaCommand(pCommand))
+				return;
+			break;
+		}
+	}
+
 	CCommand *pRemoved = 0;
 
 	// remove temp entry from command list
@@ -1011,14 +1079,6 @@ void CConsole::DeregisterTemp(const char *pName)
 
 	if(pRemoved)
 	{
-		if(pRemoved->m_pUserData)
-		{
-			// userdata for temp commands is only set for commands registered by lua
-			delete static_cast<LuaRef *>(pRemoved->m_pUserData);
-			pRemoved->m_pUserData = NULL;
-			CLua::Lua()->GetResMan()->DeregisterConsoleCommand(pRemoved->m_pName);
-		}
-
 		// add to recycle list
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
@@ -3,6 +3,7 @@
 #ifndef ENGINE_SHARED_CONSOLE_H
 #define ENGINE_SHARED_CONSOLE_H
 
+#include <vector>
 #include <engine/console.h>
 #include "memheap.h"
 
@@ -177,7 +178,14 @@ class CConsole : public IConsole
 	CCommand *FindCommand(const char *pName, int FlagMask);
 
 	// lua
+	// every game instance has its own lua state, which all register the same commands
+	struct CLuaCommand
+	{
+		std::vector<std::pair<class CLua *, luabridge::LuaRef *> > m_lFuncs;
+	};
 	static void LuaCommandCallback(IResult *pResult, void *pUserData);
+	/** drops the function of the active lua state, returns whether another one still uses the command */
+	static bool ReleaseLuaCommand(CCommand *pCommand);
 
 public:
 	CConsole(int FlagMask);
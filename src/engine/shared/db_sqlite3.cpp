@@ -82,7 +82,7 @@ void CSql::InsertQuery(CQuery *pQuery)
 void CSql::InsertQuerySync(CQuery *pQuery)
 {
 	Flush();
-	LOCK_SECTION_MUTEX(m_Mutex);
+	LOCK_SECTION_MUTEX(m_ExecMutex);
 	ExecuteQuery(pQuery);
 	delete pQuery;
 }
@@ -125,6 +125,8 @@ void CSql::ExecuteQuery(CQuery *pQuery)
 
 unsigned int CSql::Work()
 {
+	// taken first, so that batches are executed in the order they left the queue
+	std::lock_guard<std::mutex> ExecLock(m_ExecMutex);
 	m_Mutex.lock();
 	if (!m_lpQueries.empty())
 	{
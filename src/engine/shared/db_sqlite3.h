@@ -41,7 +41,9 @@ public:
 
 	int GetID(const char *pName);
 	int GetInt(int i) { return sqlite3_column_int(m_pStatement, i); }
+	int64 GetInt64(int i) { return sqlite3_column_int64(m_pStatement, i); }
 	float GetFloat(int i) { return (float)sqlite3_column_double(m_pStatement, i); }
+	double GetDouble(int i) { return sqlite3_column_double(m_pStatement, i); }
 	const char *GetText(int i) { return (const char *)sqlite3_column_text(m_pStatement, i); }
 	const void *GetBlob(int i) { return sqlite3_column_blob(m_pStatement, i); }
 	int GetSize(int i) { return sqlite3_column_bytes(m_pStatement, i); }
@@ -57,7 +59,8 @@ class CSql
 {
 private:
 	sqlite3 *m_pDB;
-	std::mutex m_Mutex;
+	std::mutex m_Mutex; // guards the queue
+	std::mutex m_ExecMutex; // one thread executing on the connection at a time
 	std::atomic_bool m_Running;
 	void * volatile m_pThread;
 	std::queue<CQuery *> m_lpQueries;
@@ -74,7 +77,8 @@ public:
 
 	/**
 	 * Flushes the threaded query queue to retain order and then executes
-	 * the given query in the calling thread instead of a different one
+	 * the given query in the calling thread instead of a different one.
+	 * InsertQuery() does not have to wait for it.
 	 * @param pQuery pointer to the query to execute
 	 */
 	void InsertQuerySync(CQuery *pQuery);
@@ -56,10 +56,44 @@ int CNetBan::CNetHash::MakeHashArray(const NETADDR *pAddr, CNetHash aHash[17])
 }
 
 
+template<class T, int HashCount>
+CNetBan::CBanPool<T, HashCount>::CBanPool()
+{
+	m_Generation = 0;
+	Reset();
+}
+
+template<class T, int HashCount>
+CNetBan::CBanPool<T, HashCount>::~CBanPool()
+{
+	for(int i = 0; i < m_lpChunks.size(); ++i)
+		mem_free(m_lpChunks[i]);
+}
+
+template<class T, int HashCount>
+bool CNetBan::CBanPool<T, HashCount>::Grow()
+{
+	CBan<T> *pChunk = (CBan<T> *)mem_alloc(sizeof(CBan<T>)*CHUNK_SIZE, 1);
+	if(!pChunk)
+		return false;
+	mem_zero(pChunk, sizeof(CBan<T>)*CHUNK_SIZE);
+	m_lpChunks.add(pChunk);
+
+	for(int i = 0; i < CHUNK_SIZE; ++i)
+	{
+		pChunk[i].m_pPrev = i > 0 ? &pChunk[i-1] : 0;
+		pChunk[i].m_pNext = i < CHUNK_SIZE-1 ? &pChunk[i+1] : m_pFirstFree;
+	}
+	if(m_pFirstFree)
+		m_pFirstFree->m_pPrev = &pChunk[CHUNK_SIZE-1];
+	m_pFirstFree = &pChunk[0];
+	return true;
+}
+
 template<class T, int HashCount>
 typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Add(const T *pData, const CBanInfo *pInfo,  const CNetHash *pNetHash)
 {
-	if(!m_pFirstFree)
+	if(!m_pFirstFree && !Grow())
 		return 0;
 
 	// create new ban
@@ -117,6 +151,7 @@ typename CNetBan::CBan<T> *CNetBan::CBanPool<T, HashCount>::Add(const T *pData,
 
 	// update ban count
 	++m_CountUsed;
+	++m_Generation;
 
 	return pBan;
 }
@@ -153,6 +188,7 @@ int CNetBan::CBanPool<T, HashCount>::Remove(CBan<T> *pBan)
 
 	// update ban count
 	--m_CountUsed;
+	++m_Generation;
 
 	return 0;
 }
@@ -161,6 +197,7 @@ template<class T, int HashCount>
 void CNetBan::CBanPool<T, HashCount>::Update(CBan<CDataType> *pBan, const CBanInfo *pInfo)
 {
 	pBan->m_Info = *pInfo;
+	++m_Generation;
 
 	// remove from used list
 	if(pBan->m_pNext)
@@ -209,19 +246,13 @@ template<class T, int HashCount>
 void CNetBan::CBanPool<T, HashCount>::Reset()
 {
 	mem_zero(m_paaHashList, sizeof(m_paaHashList));
-	mem_zero(m_aBans, sizeof(m_aBans));
+	for(int i = 0; i < m_lpChunks.size(); ++i)
+		mem_free(m_lpChunks[i]);
+	m_lpChunks.clear();
+	m_pFirstFree = 0;
 	m_pFirstUsed = 0;
 	m_CountUsed = 0;
-
-	for(int i = 1; i < MAX_BANS-1; ++i)
-	{
-		m_aBans[i].m_pNext = &m_aBans[i+1];
-		m_aBans[i].m_pPrev = &m_aBans[i-1];
-	}
-
-	m_aBans[0].m_pNext = &m_aBans[1];
-	m_aBans[MAX_BANS-1].m_pPrev = &m_aBans[MAX_BANS-2];
-	m_pFirstFree = &m_aBans[0];
+	++m_Generation;
 }
 
 template<class T, int HashCount>
@@ -345,6 +376,12 @@ int CNetBan::Unban(T *pBanPool, const typename T::CDataType *pData)
 	return -1;
 }
 
+CNetBan::CNetBan()
+{
+	// generation 0 is never current, the pools are reset on construction
+	mem_zero(m_aVerdictCache, sizeof(m_aVerdictCache));
+}
+
 void CNetBan::Init(IConsole *pConsole, IStorage *pStorage)
 {
 	m_pConsole = pConsole;
@@ -443,8 +480,26 @@ int CNetBan::UnbanByIndex(int Index)
 	return Result;
 }
 
+unsigned CNetBan::VerdictSlot(const NETADDR *pAddr)
+{
+	// fnv-1a over the ip, the port doesn't matter for bans
+	unsigned Hash = 2166136261u;
+	int Length = pAddr->type==NETTYPE_IPV4 ? 4 : 16;
+	for(int i = 0; i < Length; ++i)
+		Hash = (Hash^pAddr->ip[i])*16777619u;
+	return (Hash^(Hash>>16))&(VERDICT_CACHE_SIZE-1);
+}
+
 bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) const
 {
+	if(m_BanAddrPool.Num() == 0 && m_BanRangePool.Num() == 0)
+		return false;
+
+	unsigned Generation = CNetBan::Generation();
+	CVerdict *pVerdict = &m_aVerdictCache[VerdictSlot(pAddr)];
+	if(pVerdict->m_Generation == Generation && NetComp(&pVerdict->m_Addr, pAddr) == 0)
+		return false;
+
 	CNetHash aHash[17];
 	int Length = CNetHash::MakeHashArray(pAddr, aHash);
 
@@ -468,7 +523,9 @@ bool CNetBan::IsBanned(const NETADDR *pAddr, char *pBuf, unsigned BufferSize) co
 			}
 		}
 	}
-	
+
+	pVerdict->m_Addr = *pAddr;
+	pVerdict->m_Generation = Generation;
 	return false;
 }
 
@@ -2,6 +2,7 @@
 #define ENGINE_SHARED_NETBAN_H
 
 #include <base/system.h>
+#include <base/tl/array.h>
 
 
 inline int NetComp(const NETADDR *pAddr1, const NETADDR *pAddr2)
@@ -107,13 +108,16 @@ protected:
 	public:
 		typedef T CDataType;
 
+		CBanPool();
+		~CBanPool();
+
 		CBan<CDataType> *Add(const CDataType *pData, const CBanInfo *pInfo, const CNetHash *pNetHash);
 		int Remove(CBan<CDataType> *pBan);
 		void Update(CBan<CDataType> *pBan, const CBanInfo *pInfo);
 		void Reset();
 	
 		int Num() const { return m_CountUsed; }
-		bool IsFull() const { return m_CountUsed == MAX_BANS; }
+		unsigned Generation() const { return m_Generation; }
 
 		CBan<CDataType> *First() const { return m_pFirstUsed; }
 		CBan<CDataType> *First(const CNetHash *pNetHash) const { return m_paaHashList[pNetHash->m_HashIndex][pNetHash->m_Hash]; }
@@ -132,14 +136,17 @@ protected:
 	private:
 		enum
 		{
-			MAX_BANS=1024,
+			CHUNK_SIZE=256, // bans are allocated in chunks of this many on demand
 		};
 
+		bool Grow();
+
 		CBan<CDataType> *m_paaHashList[HashCount][256];
-		CBan<CDataType> m_aBans[MAX_BANS];
+		array<CBan<CDataType> *> m_lpChunks;
 		CBan<CDataType> *m_pFirstFree;
 		CBan<CDataType> *m_pFirstUsed;
 		int m_CountUsed;
+		unsigned m_Generation; // changes with every modification
 	};
 
 	typedef CBanPool<NETADDR, 1> CBanAddrPool;
@@ -157,6 +164,25 @@ protected:
 	CBanRangePool m_BanRangePool;
 	NETADDR m_LocalhostIPV4, m_LocalhostIPV6;
 
+	// addresses recently found not to be banned, so that the regular traffic
+	// gets through IsBanned with a single lookup. an entry is only valid as
+	// long as none of the pools changed since it was made.
+	enum
+	{
+		VERDICT_CACHE_SIZE=1024,
+	};
+
+	struct CVerdict
+	{
+		NETADDR m_Addr;
+		unsigned m_Generation;
+	};
+
+	mutable CVerdict m_aVerdictCache[VERDICT_CACHE_SIZE];
+
+	static unsigned VerdictSlot(const NETADDR *pAddr);
+	unsigned Generation() const { return m_BanAddrPool.Generation() + m_BanRangePool.Generation(); }
+
 public:
 	enum
 	{
@@ -169,6 +195,7 @@ public:
 	class IConsole *Console() const { return m_pConsole; }
 	class IStorage *Storage() const { return m_pStorage; }
 
+	CNetBan();
 	virtual ~CNetBan() {}
 	void Init(class IConsole *pConsole, class IStorage *pStorage);
 	void Update();
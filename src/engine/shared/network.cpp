@@ -89,6 +89,22 @@ int CNetRecvUnpacker::FetchChunk(CNetChunk *pChunk)
 
 // packs the data tight and sends it
 void CNetBase::SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize)
+{
+	if(ms_pThread)
+	{
+		CNetPacketConstruct Packet;
+		Packet.m_Flags = NET_PACKETFLAG_CONNLESS;
+		Packet.m_Ack = 0;
+		Packet.m_NumChunks = 0;
+		Packet.m_DataSize = DataSize;
+		mem_copy(Packet.m_aChunkData, pData, DataSize);
+		if(ms_pThread->QueueSend(Socket, pAddr, &Packet))
+			return;
+	}
+	SendPacketConnlessDirect(Socket, pAddr, pData, DataSize);
+}
+
+void CNetBase::SendPacketConnlessDirect(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int DataSize)
 {
 	unsigned char aBuffer[NET_MAX_PACKETSIZE];
 	aBuffer[0] = 0xff;
@@ -102,6 +118,13 @@ void CNetBase::SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *
 }
 
 void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket)
+{
+	if(ms_pThread && ms_pThread->QueueSend(Socket, pAddr, pPacket))
+		return;
+	SendPacketDirect(Socket, pAddr, pPacket);
+}
+
+void CNetBase::SendPacketDirect(NETSOCKET Socket, const NETADDR *pAddr, CNetPacketConstruct *pPacket)
 {
 	unsigned char aBuffer[NET_MAX_PACKETSIZE];
 	int CompressedSize = -1;
@@ -291,6 +314,7 @@ int CNetBase::IsSeqInBackroom(int Seq, int Ack)
 IOHANDLE CNetBase::ms_DataLogSent = 0;
 IOHANDLE CNetBase::ms_DataLogRecv = 0;
 CHuffman CNetBase::ms_Huffman;
+CNetThread *CNetBase::ms_pThread = 0;
 
 
 void CNetBase::OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv)
@@ -5,6 +5,7 @@
 
 #include "ringbuffer.h"
 #include "huffman.h"
+#include "spscqueue.h"
 
 /*
 
@@ -38,7 +39,8 @@ enum
 	NETBANTYPE_SOFT=1,
 	NETBANTYPE_DROP=2,
 
-	NETCREATE_FLAG_RANDOMPORT=1
+	NETCREATE_FLAG_RANDOMPORT=1,
+	NETCREATE_FLAG_THREADED=2,
 };
 
 
@@ -219,6 +221,7 @@ public:
 	int State() const { return m_State; }
 	const NETADDR *PeerAddress() const { return &m_PeerAddr; }
 	const char *ErrorString() const { return m_aErrorString; }
+	NETSOCKET Socket() const { return m_Socket; }
 
 	void Reset();
 	int Update();
@@ -244,6 +247,55 @@ public:
 	int FetchChunk(CNetChunk *pChunk);
 };
 
+/*
+	Owns the socket of a threaded CNetServer: receives and unpacks the
+	packets for the game thread and compresses and sends what the game
+	thread queued, so neither of it eats into the tick.
+
+	Everything else stays on the game thread, including the ban checks and
+	the info replies, since they read state only the game thread changes.
+*/
+class CNetThread
+{
+public:
+	enum
+	{
+		QUEUE_SIZE=1024,
+		MAX_RECV_BATCH=256, // packets to receive before the sends get their turn
+	};
+
+	// connless packets carry their payload as it is
+	struct CPacket
+	{
+		NETADDR m_Addr;
+		CNetPacketConstruct m_Data;
+	};
+
+private:
+	NETSOCKET m_Socket;
+	NETWAIT *m_pWait;
+	NETWAIT *m_pGameWait; // woken up when there are packets for the game thread
+	void *m_pThread;
+	std::atomic<bool> m_Running;
+
+	TSpscQueue<CPacket, QUEUE_SIZE> m_RecvQueue;
+	TSpscQueue<CPacket, QUEUE_SIZE> m_SendQueue;
+
+	static void ThreadFunc(void *pUser);
+	void SendQueued();
+	void RecvPackets();
+
+public:
+	CNetThread();
+
+	bool Start(NETSOCKET Socket, NETWAIT *pGameWait);
+	void Stop();
+
+	// game thread, false if the socket isn't ours or the queue is full
+	bool QueueSend(NETSOCKET Socket, const NETADDR *pAddr, const CNetPacketConstruct *pPacket);
+	bool Recv(NETADDR *pAddr, CNetPacketConstruct *pPacket);
+};
+
 // server side
 class CNetServer
 {
@@ -264,12 +316,16 @@ class CNetServer
 	void *m_UserPtr;
 
 	CNetRecvUnpacker m_RecvUnpacker;
+	NETWAIT *m_pWait;
+	CNetThread *m_pThread;
+
+	bool FetchPacket(NETADDR *pAddr);
 
 public:
 	int SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 
 	//
-	bool Open(NETADDR BindAddr, class CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP, int Flags);
+	bool Open(NETADDR BindAddr, class CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP, NETWAIT *pWait, int Flags);
 	int Close();
 
 	//
@@ -300,6 +356,7 @@ class CNetConsole
 
 	NETSOCKET m_Socket;
 	class CNetBan *m_pNetBan;
+	NETWAIT *m_pWait; // the sockets are kept in it, if any
 	CSlot m_aSlots[NET_MAX_CONSOLE_CLIENTS];
 
 	NETFUNC_NEWCLIENT m_pfnNewClient;
@@ -312,7 +369,7 @@ public:
 	void SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 
 	//
-	bool Open(NETADDR BindAddr, class CNetBan *pNetBan, int Flags);
+	bool Open(NETADDR BindAddr, class CNetBan *pNetBan, NETWAIT *pWait, int Flags);
 	int Close();
 
 	//
@@ -372,6 +429,7 @@ class CNetBase
 	static IOHANDLE ms_DataLogSent;
 	static IOHANDLE ms_DataLogRecv;
 	static CHuffman ms_Huffman;
+	static CNetThread *ms_pThread; // takes over the sends on its socket
 public:
 	static void OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv);
 	static void CloseLog();
@@ -379,9 +437,14 @@ public:
 	static int Compress(const void *pData, int DataSize, void *pOutput, int OutputSize);
 	static int Decompress(const void *pData, int DataSize, void *pOutput, int OutputSize);
 
+	static void SetThread(CNetThread *pThread) { ms_pThread = pThread; }
+
 	static void SendControlMsg(NETSOCKET Socket, NETADDR *pAddr, int Ack, int ControlMsg, const void *pExtra, int ExtraSize);
 	static void SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize);
 	static void SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket);
+	// what the two above do when there is no thread to hand the packet to
+	static void SendPacketConnlessDirect(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int DataSize);
+	static void SendPacketDirect(NETSOCKET Socket, const NETADDR *pAddr, CNetPacketConstruct *pPacket);
 	static int UnpackPacket(unsigned char *pBuffer, int Size, CNetPacketConstruct *pPacket);
 
 	// The backroom is ack-NET_MAX_SEQUENCE/2. Used for knowing if we acked a packet or not
@@ -8,7 +8,7 @@
 #include "network.h"
 
 
-bool CNetConsole::Open(NETADDR BindAddr, CNetBan *pNetBan, int Flags)
+bool CNetConsole::Open(NETADDR BindAddr, CNetBan *pNetBan, NETWAIT *pWait, int Flags)
 {
 	// zero out the whole structure
 	mem_zero(this, sizeof(*this));
@@ -25,6 +25,10 @@ bool CNetConsole::Open(NETADDR BindAddr, CNetBan *pNetBan, int Flags)
 		return false;
 	net_set_non_blocking(m_Socket);
 
+	m_pWait = pWait;
+	if(m_pWait)
+		net_wait_add(m_pWait, m_Socket);
+
 	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
 		m_aSlots[i].m_Connection.Reset();
 
@@ -41,8 +45,14 @@ void CNetConsole::SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT
 int CNetConsole::Close()
 {
 	for(int i = 0; i < NET_MAX_CONSOLE_CLIENTS; i++)
+	{
+		if(m_pWait && m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE)
+			net_wait_remove(m_pWait, m_aSlots[i].m_Connection.Socket());
 		m_aSlots[i].m_Connection.Disconnect("closing console");
+	}
 
+	if(m_pWait)
+		net_wait_remove(m_pWait, m_Socket);
 	net_tcp_close(m_Socket);
 
 	return 0;
@@ -53,6 +63,8 @@ int CNetConsole::Drop(int ClientID, const char *pReason)
 	if(m_pfnDelClient)
 		m_pfnDelClient(ClientID, pReason, m_UserPtr);
 
+	if(m_pWait)
+		net_wait_remove(m_pWait, m_aSlots[ClientID].m_Connection.Socket());
 	m_aSlots[ClientID].m_Connection.Disconnect(pReason);
 
 	return 0;
@@ -82,6 +94,8 @@ int CNetConsole::AcceptClient(NETSOCKET Socket, const NETADDR *pAddr)
 	if(!aError[0] && FreeSlot != -1)
 	{
 		m_aSlots[FreeSlot].m_Connection.Init(Socket, pAddr);
+		if(m_pWait)
+			net_wait_add(m_pWait, Socket);
 		if(m_pfnNewClient)
 			m_pfnNewClient(FreeSlot, m_UserPtr);
 		return 0;
@@ -9,7 +9,7 @@
 #include "network.h"
 
 
-bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP, int Flags)
+bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP, NETWAIT *pWait, int Flags)
 {
 	// zero out the whole structure
 	mem_zero(this, sizeof(*this));
@@ -33,6 +33,23 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 	for(int i = 0; i < NET_MAX_CLIENTS; i++)
 		m_aSlots[i].m_Connection.Init(m_Socket, true);
 
+	// the thread wakes the waiting game thread up itself
+	m_pWait = pWait;
+	if(m_pWait && (Flags&NETCREATE_FLAG_THREADED))
+	{
+		m_pThread = new CNetThread();
+		if(m_pThread->Start(m_Socket, m_pWait))
+			CNetBase::SetThread(m_pThread);
+		else
+		{
+			dbg_msg("netserver", "failed to start the network thread");
+			delete m_pThread;
+			m_pThread = 0;
+		}
+	}
+	if(m_pWait && !m_pThread)
+		net_wait_add(m_pWait, m_Socket);
+
 	return true;
 }
 
@@ -46,6 +63,16 @@ int CNetServer::SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT p
 
 int CNetServer::Close()
 {
+	if(m_pThread)
+	{
+		m_pThread->Stop();
+		CNetBase::SetThread(0);
+		delete m_pThread;
+		m_pThread = 0;
+	}
+	else if(m_pWait)
+		net_wait_remove(m_pWait, m_Socket);
+
 	net_udp_close(m_Socket);
 	return 0;
 }
@@ -89,6 +116,23 @@ int CNetServer::Update()
 	return 0;
 }
 
+// unpacks the next packet into the recv unpacker
+bool CNetServer::FetchPacket(NETADDR *pAddr)
+{
+	// the thread has done the unpacking already
+	if(m_pThread)
+		return m_pThread->Recv(pAddr, &m_RecvUnpacker.m_Data);
+
+	while(1)
+	{
+		int Bytes = net_udp_recv(m_Socket, pAddr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE);
+		if(Bytes <= 0)
+			return false;
+		if(CNetBase::UnpackPacket(m_RecvUnpacker.m_aBuffer, Bytes, &m_RecvUnpacker.m_Data) == 0)
+			return true;
+	}
+}
+
 /*
 	TODO: chopp up this function into smaller working parts
 */
@@ -102,108 +146,107 @@ int CNetServer::Recv(CNetChunk *pChunk)
 		if(m_RecvUnpacker.FetchChunk(pChunk))
 			return 1;
 
-		// TODO: empty the recvinfo
-		int Bytes = net_udp_recv(m_Socket, &Addr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE);
-
 		// no more packets for now
-		if(Bytes <= 0)
+		if(!FetchPacket(&Addr))
 			break;
 
-		if(CNetBase::UnpackPacket(m_RecvUnpacker.m_aBuffer, Bytes, &m_RecvUnpacker.m_Data) == 0)
+		// check if we just should drop the packet
+		char aBuf[128];
+		if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
 		{
-			// check if we just should drop the packet
-			char aBuf[128];
-			if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
-			{
-				// banned, reply with a message
-				CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf)+1);
-				continue;
-			}
+			// banned, reply with a message
+			CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf)+1);
+			continue;
+		}
 
-			if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS)
-			{
-				pChunk->m_Flags = NETSENDFLAG_CONNLESS;
-				pChunk->m_ClientID = -1;
-				pChunk->m_Address = Addr;
-				pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
-				pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
-				return 1;
-			}
-			else
+		if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS)
+		{
+			pChunk->m_Flags = NETSENDFLAG_CONNLESS;
+			pChunk->m_ClientID = -1;
+			pChunk->m_Address = Addr;
+			pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
+			pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
+			return 1;
+		}
+		else
+		{
+			// TODO: check size here
+			if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONTROL && m_RecvUnpacker.m_Data.m_aChunkData[0] == NET_CTRLMSG_CONNECT)
 			{
-				// TODO: check size here
-				if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONTROL && m_RecvUnpacker.m_Data.m_aChunkData[0] == NET_CTRLMSG_CONNECT)
-				{
-					bool Found = false;
+				bool Found = false;
 
-					// check if we already got this client
-					for(int i = 0; i < MaxClients(); i++)
+				// check if we already got this client
+				for(int i = 0; i < MaxClients(); i++)
+				{
+					if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE &&
+						net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
 					{
-						if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE &&
-							net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
-						{
-							Found = true; // silent ignore.. we got this client already
-							break;
-						}
+						Found = true; // silent ignore.. we got this client already
+						break;
 					}
+				}
 
-					// client that wants to connect
-					if(!Found)
+				// client that wants to connect
+				if(!Found)
+				{
+					// only allow a specific number of players with the same ip
+					NETADDR ThisAddr = Addr, OtherAddr;
+					int FoundAddr = 1;
+					bool TooMany = false;
+					ThisAddr.port = 0;
+					for(int i = 0; i < MaxClients(); ++i)
 					{
-						// only allow a specific number of players with the same ip
-						NETADDR ThisAddr = Addr, OtherAddr;
-						int FoundAddr = 1;
-						ThisAddr.port = 0;
-						for(int i = 0; i < MaxClients(); ++i)
-						{
-							if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
-								continue;
-
-							OtherAddr = *m_aSlots[i].m_Connection.PeerAddress();
-							OtherAddr.port = 0;
-							if(!net_addr_comp(&ThisAddr, &OtherAddr))
-							{
-								if(FoundAddr++ >= m_MaxClientsPerIP)
-								{
-									char aBuf[128];
-									str_format(aBuf, sizeof(aBuf), "Only %d players with the same IP are allowed", m_MaxClientsPerIP);
-									CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf) + 1);
-									return 0;
-								}
-							}
-						}
+						if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
+							continue;
 
-						for(int i = 0; i < MaxClients(); i++)
+						OtherAddr = *m_aSlots[i].m_Connection.PeerAddress();
+						OtherAddr.port = 0;
+						if(!net_addr_comp(&ThisAddr, &OtherAddr))
 						{
-							if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
+							if(FoundAddr++ >= m_MaxClientsPerIP)
 							{
-								Found = true;
-								m_aSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr);
-								if(m_pfnNewClient)
-									m_pfnNewClient(i, m_UserPtr);
+								char aBuf[128];
+								str_format(aBuf, sizeof(aBuf), "Only %d players with the same IP are allowed", m_MaxClientsPerIP);
+								CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf) + 1);
+								TooMany = true;
 								break;
 							}
 						}
+					}
+					// keep reading, with the net thread nothing would wake us up for the rest of the ring
+					if(TooMany)
+						continue;
 
-						if(!Found)
+					for(int i = 0; i < MaxClients(); i++)
+					{
+						if(m_aSlots[i].m_Connection.State() == NET_CONNSTATE_OFFLINE)
 						{
-							const char FullMsg[] = "This server is full";
-							CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, FullMsg, sizeof(FullMsg));
+							Found = true;
+							m_aSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr);
+							if(m_pfnNewClient)
+								m_pfnNewClient(i, m_UserPtr);
+							break;
 						}
 					}
+
+					if(!Found)
+					{
+						const char FullMsg[] = "This server is full";
+						CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, FullMsg, sizeof(FullMsg));
+					}
 				}
-				else
+			}
+			else
+			{
+				// normal packet, find matching slot
+				for(int i = 0; i < MaxClients(); i++)
 				{
-					// normal packet, find matching slot
-					for(int i = 0; i < MaxClients(); i++)
+					if(net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
 					{
-						if(net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
+						if(m_aSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr))
 						{
-							if(m_aSlots[i].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr))
-							{
-								if(m_RecvUnpacker.m_Data.m_DataSize)
-									m_RecvUnpacker.Start(&Addr, &m_aSlots[i].m_Connection, i);
-							}
+							if(m_RecvUnpacker.m_Data.m_DataSize)
+								m_RecvUnpacker.Start(&Addr, &m_aSlots[i].m_Connection, i);
 						}
 					}
 				}
@@ -0,0 +1,136 @@
+#include <base/system.h>
+
+#include "network.h"
+
+
+CNetThread::CNetThread() : m_Running(false)
+{
+	m_pWait = 0;
+	m_pGameWait = 0;
+	m_pThread = 0;
+}
+
+bool CNetThread::Start(NETSOCKET Socket, NETWAIT *pGameWait)
+{
+	m_Socket = Socket;
+	m_pGameWait = pGameWait;
+	m_pWait = net_wait_create();
+	if(!m_pWait || net_wait_add(m_pWait, m_Socket) != 0)
+	{
+		if(m_pWait)
+			net_wait_destroy(m_pWait);
+		m_pWait = 0;
+		return false;
+	}
+
+	m_Running = true;
+	m_pThread = thread_init_named(ThreadFunc, this, "network");
+	return true;
+}
+
+void CNetThread::Stop()
+{
+	if(!m_pThread)
+		return;
+
+	m_Running = false;
+	net_wait_wake(m_pWait);
+	thread_wait(m_pThread);
+	m_pThread = 0;
+
+	// the last goodbyes of a shutdown were queued after the thread had its last look
+	SendQueued();
+
+	net_wait_destroy(m_pWait);
+	m_pWait = 0;
+}
+
+void CNetThread::ThreadFunc(void *pUser)
+{
+	CNetThread *pSelf = (CNetThread *)pUser;
+	while(pSelf->m_Running)
+	{
+		// woken up by incoming packets, queued sends and Stop()
+		net_wait(pSelf->m_pWait, -1);
+		pSelf->SendQueued();
+		pSelf->RecvPackets();
+	}
+}
+
+void CNetThread::SendQueued()
+{
+	CPacket *pPacket;
+	while((pPacket = m_SendQueue.Front()))
+	{
+		if(pPacket->m_Data.m_Flags&NET_PACKETFLAG_CONNLESS)
+			CNetBase::SendPacketConnlessDirect(m_Socket, &pPacket->m_Addr, pPacket->m_Data.m_aChunkData, pPacket->m_Data.m_DataSize);
+		else
+			CNetBase::SendPacketDirect(m_Socket, &pPacket->m_Addr, &pPacket->m_Data);
+		m_SendQueue.Pop();
+	}
+}
+
+void CNetThread::RecvPackets()
+{
+	unsigned char aBuffer[NET_MAX_PACKETSIZE];
+	NETADDR Addr;
+	bool Wake = false;
+
+	// the rest of a flood is left for the next round, the wait returns right away for it
+	for(int i = 0; i < MAX_RECV_BATCH; i++)
+	{
+		int Bytes = net_udp_recv(m_Socket, &Addr, aBuffer, sizeof(aBuffer));
+		if(Bytes <= 0)
+			break;
+
+		// with the game thread this far behind, dropping it here is the cheapest
+		CPacket *pPacket = m_RecvQueue.Prepare();
+		if(!pPacket)
+			continue;
+
+		if(CNetBase::UnpackPacket(aBuffer, Bytes, &pPacket->m_Data) != 0)
+			continue;
+		pPacket->m_Addr = Addr;
+		if(m_RecvQueue.Push())
+			Wake = true;
+	}
+
+	if(Wake)
+		net_wait_wake(m_pGameWait);
+}
+
+bool CNetThread::QueueSend(NETSOCKET Socket, const NETADDR *pAddr, const CNetPacketConstruct *pPacket)
+{
+	if(!m_Running || Socket.ipv4sock != m_Socket.ipv4sock || Socket.ipv6sock != m_Socket.ipv6sock)
+		return false;
+
+	CPacket *pSlot = m_SendQueue.Prepare();
+	if(!pSlot)
+		return false;
+
+	pSlot->m_Addr = *pAddr;
+	pSlot->m_Data.m_Flags = pPacket->m_Flags;
+	pSlot->m_Data.m_Ack = pPacket->m_Ack;
+	pSlot->m_Data.m_NumChunks = pPacket->m_NumChunks;
+	pSlot->m_Data.m_DataSize = pPacket->m_DataSize;
+	mem_copy(pSlot->m_Data.m_aChunkData, pPacket->m_aChunkData, pPacket->m_DataSize);
+	if(m_SendQueue.Push())
+		net_wait_wake(m_pWait);
+	return true;
+}
+
+bool CNetThread::Recv(NETADDR *pAddr, CNetPacketConstruct *pPacket)
+{
+	CPacket *pSlot = m_RecvQueue.Front();
+	if(!pSlot)
+		return false;
+
+	*pAddr = pSlot->m_Addr;
+	pPacket->m_Flags = pSlot->m_Data.m_Flags;
+	pPacket->m_Ack = pSlot->m_Data.m_Ack;
+	pPacket->m_NumChunks = pSlot->m_Data.m_NumChunks;
+	pPacket->m_DataSize = pSlot->m_Data.m_DataSize;
+	mem_copy(pPacket->m_aChunkData, pSlot->m_Data.m_aChunkData, pSlot->m_Data.m_DataSize);
+	m_RecvQueue.Pop();
+	return true;
+}
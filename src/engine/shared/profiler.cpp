@@ -0,0 +1,80 @@
+#include <algorithm>
+
+#include "profiler.h"
+
+CProfiler::CPhase CProfiler::ms_aPhases[NUM_PHASES];
+int CProfiler::ms_HistoryPos = 0;
+int CProfiler::ms_HistoryNum = 0;
+
+void CProfiler::Reset()
+{
+	for(int i = 0; i < NUM_PHASES; i++)
+	{
+		// keep the depth, we might be reset from within a running scope
+		int Depth = ms_aPhases[i].m_Depth;
+		mem_zero(&ms_aPhases[i], sizeof(ms_aPhases[i]));
+		ms_aPhases[i].m_Depth = Depth;
+		if(Depth)
+			ms_aPhases[i].m_Start = time_get();
+	}
+	ms_HistoryPos = 0;
+	ms_HistoryNum = 0;
+}
+
+void CProfiler::NextFrame()
+{
+	for(int i = 0; i < NUM_PHASES; i++)
+	{
+		ms_aPhases[i].m_aHistory[ms_HistoryPos] = ms_aPhases[i].m_Frame;
+		ms_aPhases[i].m_Frame = 0;
+	}
+	ms_HistoryPos = (ms_HistoryPos+1)%HISTORY_SIZE;
+	if(ms_HistoryNum < HISTORY_SIZE)
+		ms_HistoryNum++;
+}
+
+void CProfiler::GetStats(int Phase, CStats *pStats)
+{
+	mem_zero(pStats, sizeof(*pStats));
+	if(ms_HistoryNum == 0)
+		return;
+
+	// the order in the ring doesn't matter for percentiles
+	int64 aSorted[HISTORY_SIZE];
+	mem_copy(aSorted, ms_aPhases[Phase].m_aHistory, ms_HistoryNum*sizeof(int64));
+	std::sort(aSorted, aSorted+ms_HistoryNum);
+
+	int64 Sum = 0;
+	for(int i = 0; i < ms_HistoryNum; i++)
+		Sum += aSorted[i];
+
+	const double Scale = 1000000.0/time_freq();
+	pStats->m_Avg = Sum*Scale/ms_HistoryNum;
+	pStats->m_P50 = aSorted[(ms_HistoryNum-1)/2]*Scale;
+	pStats->m_P99 = aSorted[(ms_HistoryNum-1)*99/100]*Scale;
+	pStats->m_Max = aSorted[ms_HistoryNum-1]*Scale;
+}
+
+const char *CProfiler::PhaseName(int Phase)
+{
+	static const char *s_apNames[NUM_PHASES] = {
+		"input",
+		"tick",
+		"world",
+		"projectile", // entity types
+		"laser",
+		"pickup",
+		"flag",
+		"character",
+		"custom",
+		"lua",
+		"gc",
+		"snap",
+		"delta",
+		"compress",
+		"network",
+		"register",
+		"late"
+	};
+	return s_apNames[Phase];
+}
@@ -0,0 +1,111 @@
+#ifndef ENGINE_SHARED_PROFILER_H
+#define ENGINE_SHARED_PROFILER_H
+
+#include <base/system.h>
+
+/*
+	Accumulates the time spent in the phases of a server tick.
+	Phases may nest into themselves (e.g. lua calling back into c++ which calls lua again),
+	only the outermost scope of each phase is measured. Different phases overlap though,
+	the world tick contains the entities which contain lua callbacks.
+
+	Besides the totals, the time of each phase per frame (everything between two
+	NextFrame() calls) is kept for the last HISTORY_SIZE frames to get percentiles.
+*/
+class CProfiler
+{
+public:
+	enum
+	{
+		NUM_ENTITY_PHASES=6, // CGameWorld::NUM_ENTTYPES
+		HISTORY_SIZE=512,
+	};
+
+	enum
+	{
+		PHASE_INPUT=0,
+		PHASE_TICK,
+		PHASE_WORLD,
+		PHASE_ENTITIES, // one per entity type of the game world
+		PHASE_LUA=PHASE_ENTITIES+NUM_ENTITY_PHASES,
+		PHASE_GC,
+		PHASE_SNAP,
+		PHASE_DELTA,
+		PHASE_COMPRESS,
+		PHASE_NETWORK,
+		PHASE_REGISTER,
+		PHASE_LATE, // not a phase but how long after its scheduled time a tick started
+		NUM_PHASES
+	};
+
+	struct CPhase
+	{
+		int64 m_Total;
+		int64 m_Max;
+		int m_Calls;
+
+		int m_Depth;
+		int64 m_Start;
+
+		int64 m_Frame;
+		int64 m_aHistory[HISTORY_SIZE];
+	};
+
+	// per frame statistics over the history, in microseconds
+	struct CStats
+	{
+		double m_Avg;
+		double m_P50;
+		double m_P99;
+		double m_Max;
+	};
+
+private:
+	static CPhase ms_aPhases[NUM_PHASES];
+	static int ms_HistoryPos;
+	static int ms_HistoryNum;
+
+public:
+	static void Reset();
+	static void NextFrame();
+	static const char *PhaseName(int Phase);
+	static const CPhase *Phase(int Phase) { return &ms_aPhases[Phase]; }
+	static void GetStats(int Phase, CStats *pStats);
+
+	static void Begin(int Phase)
+	{
+		CPhase *p = &ms_aPhases[Phase];
+		if(p->m_Depth++ == 0)
+			p->m_Start = time_get();
+	}
+
+	static void End(int Phase)
+	{
+		CPhase *p = &ms_aPhases[Phase];
+		if(--p->m_Depth == 0)
+			Add(Phase, time_get()-p->m_Start);
+	}
+
+	// for times that weren't measured by a scope
+	static void Add(int Phase, int64 Time)
+	{
+		CPhase *p = &ms_aPhases[Phase];
+		p->m_Total += Time;
+		p->m_Frame += Time;
+		if(Time > p->m_Max)
+			p->m_Max = Time;
+		p->m_Calls++;
+	}
+};
+
+class CProfileScope
+{
+	int m_Phase;
+public:
+	CProfileScope(int Phase) : m_Phase(Phase) { CProfiler::Begin(Phase); }
+	~CProfileScope() { CProfiler::End(m_Phase); }
+};
+
+#define PROFILE_SCOPE(PHASE) CProfileScope _ProfileScope##PHASE(CProfiler::PHASE)
+
+#endif
@@ -82,6 +82,7 @@ enum
 	DDNET_MAX_CLIENTS=64,
 	EXTENDED_MAX_CLIENTS=128,
 	MAX_CLIENTS=EXTENDED_MAX_CLIENTS,
+	MAX_INSTANCES=16, // game worlds per server, see sv_instances
 
 	// fake IDs for chat messages
 	FAKE_ID_VANILLA = VANILLA_MAX_CLIENTS - 1,
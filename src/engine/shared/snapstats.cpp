@@ -0,0 +1,66 @@
+#include <base/system.h>
+
+#include "snapstats.h"
+
+char CSnapStats::ms_aaOwnerNames[MAX_OWNERS][32] = {"(none)"};
+int CSnapStats::ms_NumOwners = 1;
+CSnapStats::CCounters CSnapStats::ms_aCurrent[MAX_CLIENTS];
+CSnapStats::CCounters CSnapStats::ms_aLast[MAX_CLIENTS];
+
+int CSnapStats::OwnerIndex(const char *pLuaClass)
+{
+	if(!pLuaClass || !pLuaClass[0])
+		return OWNER_NONE;
+
+	// entities get snapped grouped by type, so it's most likely the same as last time
+	static int s_Last = OWNER_NONE;
+	if(str_comp(ms_aaOwnerNames[s_Last], pLuaClass) == 0)
+		return s_Last;
+
+	for(int i = 1; i < ms_NumOwners; i++)
+	{
+		if(str_comp(ms_aaOwnerNames[i], pLuaClass) == 0)
+		{
+			s_Last = i;
+			return i;
+		}
+	}
+
+	if(ms_NumOwners == MAX_OWNERS)
+		return OWNER_NONE;
+
+	str_copy(ms_aaOwnerNames[ms_NumOwners], pLuaClass, sizeof(ms_aaOwnerNames[ms_NumOwners]));
+	s_Last = ms_NumOwners++;
+	return s_Last;
+}
+
+void CSnapStats::NextSecond()
+{
+	mem_copy(ms_aLast, ms_aCurrent, sizeof(ms_aLast));
+	mem_zero(ms_aCurrent, sizeof(ms_aCurrent));
+}
+
+void CSnapStats::ResetClient(int ClientID)
+{
+	mem_zero(&ms_aCurrent[ClientID], sizeof(ms_aCurrent[ClientID]));
+	mem_zero(&ms_aLast[ClientID], sizeof(ms_aLast[ClientID]));
+}
+
+void CSnapStats::Get(int ClientID, CCounters *pCounters)
+{
+	if(ClientID >= 0)
+	{
+		mem_copy(pCounters, &ms_aLast[ClientID], sizeof(*pCounters));
+		return;
+	}
+
+	mem_zero(pCounters, sizeof(*pCounters));
+	for(int c = 0; c < MAX_CLIENTS; c++)
+	{
+		pCounters->m_Total += ms_aLast[c].m_Total;
+		for(int i = 0; i <= MAX_TYPES; i++)
+			pCounters->m_aTypes[i] += ms_aLast[c].m_aTypes[i];
+		for(int i = 0; i < MAX_OWNERS; i++)
+			pCounters->m_aOwners[i] += ms_aLast[c].m_aOwners[i];
+	}
+}
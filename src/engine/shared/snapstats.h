@@ -0,0 +1,57 @@
+#ifndef ENGINE_SHARED_SNAPSTATS_H
+#define ENGINE_SHARED_SNAPSTATS_H
+
+#include "protocol.h"
+
+/*
+	Snapshot bandwidth per client, split up by item type and by the lua class
+	that snapped the items. Counted in bytes of the delta after the variable
+	int compression, that is what goes into the snap messages (minus the
+	message headers and the huffman compression of the network layer).
+	Each counter holds the bytes of the last full second.
+*/
+class CSnapStats
+{
+public:
+	enum
+	{
+		MAX_TYPES=64,
+		TYPE_OTHER=MAX_TYPES, // types >= MAX_TYPES
+		MAX_OWNERS=32,
+		OWNER_NONE=0, // not snapped by a lua class or there are too many of them
+	};
+
+	struct CCounters
+	{
+		int m_Total;
+		int m_aTypes[MAX_TYPES+1];
+		int m_aOwners[MAX_OWNERS];
+	};
+
+private:
+	static char ms_aaOwnerNames[MAX_OWNERS][32];
+	static int ms_NumOwners;
+	static CCounters ms_aCurrent[MAX_CLIENTS];
+	static CCounters ms_aLast[MAX_CLIENTS];
+
+public:
+	static int OwnerIndex(const char *pLuaClass);
+	static const char *OwnerName(int Owner) { return ms_aaOwnerNames[Owner]; }
+	static int NumOwners() { return ms_NumOwners; }
+
+	static void Add(int ClientID, int Type, int Owner, int Bytes)
+	{
+		CCounters *pCounters = &ms_aCurrent[ClientID];
+		pCounters->m_aTypes[Type < MAX_TYPES ? Type : TYPE_OTHER] += Bytes;
+		pCounters->m_aOwners[Owner] += Bytes;
+	}
+	static void AddTotal(int ClientID, int Bytes) { ms_aCurrent[ClientID].m_Total += Bytes; }
+
+	static void NextSecond();
+	static void ResetClient(int ClientID);
+
+	// counters of the last second, ClientID -1 sums up all clients
+	static void Get(int ClientID, CCounters *pCounters);
+};
+
+#endif
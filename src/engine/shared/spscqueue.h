@@ -0,0 +1,56 @@
+#ifndef ENGINE_SHARED_SPSCQUEUE_H
+#define ENGINE_SHARED_SPSCQUEUE_H
+
+#include <atomic>
+
+/*
+	Fixed size ring that hands items from exactly one producer thread to
+	exactly one consumer thread without taking a lock. The producer fills
+	the slot it gets from Prepare() and publishes it with Push(), the
+	consumer reads the slot it gets from Front() and frees it with Pop().
+
+	N has to be a power of two so the counters can wrap around.
+*/
+template<class T, unsigned N>
+class TSpscQueue
+{
+	T m_aItems[N];
+	std::atomic<unsigned> m_Head; // next slot to fill, only written by the producer
+	std::atomic<unsigned> m_Tail; // next slot to read, only written by the consumer
+
+public:
+	TSpscQueue() : m_Head(0), m_Tail(0) {}
+
+	// producer, NULL if the queue is full
+	T *Prepare()
+	{
+		unsigned Head = m_Head.load(std::memory_order_relaxed);
+		if(Head-m_Tail.load(std::memory_order_acquire) == N)
+			return 0;
+		return &m_aItems[Head%N];
+	}
+
+	// returns whether the consumer had taken everything before, it might be asleep then
+	bool Push()
+	{
+		unsigned Head = m_Head.load(std::memory_order_relaxed);
+		m_Head.store(Head+1);
+		return m_Tail.load() == Head;
+	}
+
+	// consumer, NULL if the queue is empty
+	T *Front()
+	{
+		unsigned Tail = m_Tail.load(std::memory_order_relaxed);
+		if(Tail == m_Head.load())
+			return 0;
+		return &m_aItems[Tail%N];
+	}
+
+	void Pop()
+	{
+		m_Tail.store(m_Tail.load(std::memory_order_relaxed)+1);
+	}
+};
+
+#endif
@@ -917,7 +917,7 @@ void CGameClient::OnPredict()
 			continue;
 
 		g_GameClient.m_aClients[i].m_Predicted.Init(&World, Collision());
-		World.m_apCharacters[i] = &g_GameClient.m_aClients[i].m_Predicted;
+		World.SetCharacter(i, &g_GameClient.m_aClients[i].m_Predicted);
 		g_GameClient.m_aClients[i].m_Predicted.Read(&m_Snap.m_aCharacters[i].m_Cur);
 	}
 
@@ -45,6 +45,9 @@ void CCollision::Init(class CLayers *pLayers)
 		case TILE_NOHOOK:
 			m_pTiles[i].m_Index = COLFLAG_SOLID|COLFLAG_NOHOOK;
 			break;
+		case COLFLAG_SOLID|COLFLAG_NOHOOK:
+			// the map data is shared by the game instances, this one is converted already
+			break;
 		default:
 			m_pTiles[i].m_Index = 0;
 		}
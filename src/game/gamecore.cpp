@@ -55,6 +55,54 @@ float VelocityRamp(float Value, float Start, float Range, float Curvature)
 	return 1.0f/powf(Curvature, (Value-Start)/Range);
 }
 
+void CWorldCore::SetCharacter(int ClientID, CCharacterCore *pCharCore)
+{
+	bool WasSet = m_apCharacters[ClientID] != 0;
+	m_apCharacters[ClientID] = pCharCore;
+	if(WasSet == (pCharCore != 0))
+		return;
+
+	// keep the live list sorted by id
+	int Index = 0;
+	while(Index < m_NumLive && m_aLiveIDs[Index] < ClientID)
+		Index++;
+
+	if(pCharCore)
+	{
+		mem_move(&m_aLiveIDs[Index+1], &m_aLiveIDs[Index], (m_NumLive-Index)*sizeof(int));
+		m_aLiveIDs[Index] = ClientID;
+		m_NumLive++;
+	}
+	else
+	{
+		m_NumLive--;
+		mem_move(&m_aLiveIDs[Index], &m_aLiveIDs[Index+1], (m_NumLive-Index)*sizeof(int));
+	}
+}
+
+int CWorldCore::FindCharacters(vec2 From, vec2 To, float Radius, int *pIDs, const CCharacterCore *pNotThis) const
+{
+	// add some slack for rounding errors of the exact tests, they grow with the coordinates
+	float Extent = max(max(absolute(From.x), absolute(From.y)), max(absolute(To.x), absolute(To.y)));
+	Radius += 1.0f + Extent/(1<<18);
+	float MinX = min(From.x, To.x) - Radius;
+	float MaxX = max(From.x, To.x) + Radius;
+	float MinY = min(From.y, To.y) - Radius;
+	float MaxY = max(From.y, To.y) + Radius;
+
+	int Num = 0;
+	for(int i = 0; i < m_NumLive; i++)
+	{
+		const CCharacterCore *pCharCore = m_apCharacters[m_aLiveIDs[i]];
+		if(pCharCore == pNotThis)
+			continue;
+		if(pCharCore->m_Pos.x < MinX || pCharCore->m_Pos.x > MaxX || pCharCore->m_Pos.y < MinY || pCharCore->m_Pos.y > MaxY)
+			continue;
+		pIDs[Num++] = m_aLiveIDs[i];
+	}
+	return Num;
+}
+
 void CCharacterCore::Init(CWorldCore *pWorld, CCollision *pCollision)
 {
 	m_pWorld = pWorld;
@@ -210,11 +258,12 @@ void CCharacterCore::Tick(bool UseInput)
 		if(m_pWorld && m_pWorld->m_Tuning.m_PlayerHooking)
 		{
 			float Distance = 0.0f;
-			for(int i = 0; i < MAX_CLIENTS; i++)
+			int aIDs[MAX_CLIENTS];
+			int Num = m_pWorld->FindCharacters(m_HookPos, NewPos, PhysSize+2.0f, aIDs, this);
+			for(int n = 0; n < Num; n++)
 			{
+				int i = aIDs[n];
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-				if(!pCharCore || pCharCore == this)
-					continue;
 
 				vec2 ClosestPoint = closest_point_on_line(m_HookPos, NewPos, pCharCore->m_Pos);
 				if(distance(pCharCore->m_Pos, ClosestPoint) < PhysSize+2.0f)
@@ -304,15 +353,26 @@ void CCharacterCore::Tick(bool UseInput)
 
 	if(m_pWorld)
 	{
-		for(int i = 0; i < MAX_CLIENTS; i++)
+		// only close characters collide, the hooked one is affected at any distance
+		int aIDs[MAX_CLIENTS+1];
+		int Num = m_pWorld->FindCharacters(m_Pos, m_Pos, PhysSize*1.25f, aIDs, this);
+		if(m_HookedPlayer >= 0 && m_HookedPlayer < MAX_CLIENTS && m_pWorld->m_apCharacters[m_HookedPlayer] && m_pWorld->m_apCharacters[m_HookedPlayer] != this)
 		{
-			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
-			if(!pCharCore)
-				continue;
+			int Index = 0;
+			while(Index < Num && aIDs[Index] < m_HookedPlayer)
+				Index++;
+			if(Index == Num || aIDs[Index] != m_HookedPlayer)
+			{
+				mem_move(&aIDs[Index+1], &aIDs[Index], (Num-Index)*sizeof(int));
+				aIDs[Index] = m_HookedPlayer;
+				Num++;
+			}
+		}
 
-			//player *p = (player*)ent;
-			if(pCharCore == this) // || !(p->flags&FLAG_ALIVE)
-				continue; // make sure that we don't nudge our self
+		for(int n = 0; n < Num; n++)
+		{
+			int i = aIDs[n];
+			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
 
 			// handle player <-> player collision
 			float Distance = distance(m_Pos, pCharCore->m_Pos);
@@ -373,15 +433,20 @@ void CCharacterCore::Move()
 		float Distance = distance(m_Pos, NewPos);
 		int End = Distance+1;
 		vec2 LastPos = m_Pos;
+
+		// only characters near the path can block it
+		int aIDs[MAX_CLIENTS];
+		int Num = m_pWorld->FindCharacters(m_Pos, NewPos, 28.0f, aIDs, this);
+		if(!Num)
+			End = 0;
+
 		for(int i = 0; i < End; i++)
 		{
 			float a = i/Distance;
 			vec2 Pos = mix(m_Pos, NewPos, a);
-			for(int p = 0; p < MAX_CLIENTS; p++)
+			for(int p = 0; p < Num; p++)
 			{
-				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[p];
-				if(!pCharCore || pCharCore == this)
-					continue;
+				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[aIDs[p]];
 				float D = distance(Pos, pCharCore->m_Pos);
 				if(D < 28.0f && D > 0.0f)
 				{
@@ -253,10 +253,24 @@ public:
 	CWorldCore()
 	{
 		mem_zero(m_apCharacters, sizeof(m_apCharacters));
+		m_NumLive = 0;
 	}
 
 	CTuningParams m_Tuning;
-	class CCharacterCore *m_apCharacters[MAX_CLIENTS];
+	class CCharacterCore *m_apCharacters[MAX_CLIENTS]; // read only, use SetCharacter to modify
+
+	void SetCharacter(int ClientID, class CCharacterCore *pCharCore);
+
+	// finds all characters that might be closer than Radius to the line From-To (broadphase only, the
+	// exact test is left to the caller). Ids are returned in ascending order to keep the physics deterministic
+	int FindCharacters(vec2 From, vec2 To, float Radius, int *pIDs, const class CCharacterCore *pNotThis) const;
+
+private:
+	// ids of all set characters in ascending order, so queries
+	// see them in the same order as a loop over m_apCharacters.
+	// keep these behind m_Tuning, code relies on it being the first member
+	int m_aLiveIDs[MAX_CLIENTS];
+	int m_NumLive;
 };
 
 class CCharacterCore
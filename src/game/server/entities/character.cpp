@@ -78,7 +78,7 @@ bool CCharacter::Spawn(CPlayer *pPlayer, vec2 Pos)
 	m_Core.Reset();
 	m_Core.Init(&GameServer()->m_World.m_Core, GameServer()->Collision());
 	m_Core.m_Pos = m_Pos;
-	GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = &m_Core;
+	GameServer()->m_World.m_Core.SetCharacter(m_pPlayer->GetCID(), &m_Core);
 
 	m_ReckoningTick = 0;
 	mem_zero(&m_SendCore, sizeof(m_SendCore));
@@ -86,6 +86,7 @@ bool CCharacter::Spawn(CPlayer *pPlayer, vec2 Pos)
 
 	GameServer()->m_World.InsertEntity(this);
 	m_Alive = true;
+	GameServer()->m_pController->OnCharacterAdded(this);
 
 	GameServer()->m_pController->OnCharacterSpawn(this);
 
@@ -96,7 +97,7 @@ void CCharacter::Destroy()
 {
 	MACRO_LUA_EVENT()
 
-	GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = NULL;
+	GameServer()->m_World.m_Core.SetCharacter(m_pPlayer->GetCID(), NULL);
 	m_Alive = false;
 }
 
@@ -639,7 +640,7 @@ void CCharacter::ResetInput()
 
 void CCharacter::Tick()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICK)
 
 	if(m_pPlayer->m_ForceBalanced)
 	{
@@ -687,7 +688,7 @@ void CCharacter::Tick()
 
 void CCharacter::TickDefered()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICKDEFERED)
 
 	m_TuningDiff.ApplyTo(&m_Core.m_pWorld->m_Tuning, false);
 	m_TuningDiff.ApplyTo(&m_ReckoningCore.m_pWorld->m_Tuning, true);
@@ -777,7 +778,7 @@ void CCharacter::TickDefered()
 
 void CCharacter::TickPaused()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICKPAUSED)
 
 	++m_AttackTick;
 	++m_DamageTakenTick;
@@ -848,7 +849,8 @@ void CCharacter::Die(int Killer, int Weapon)
 
 	m_Alive = false;
 	GameServer()->m_World.RemoveEntity(this);
-	GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = NULL;
+	GameServer()->m_pController->OnCharacterRemoved(this);
+	GameServer()->m_World.m_Core.SetCharacter(m_pPlayer->GetCID(), NULL);
 	GameServer()->CreateDeath(m_Pos, m_pPlayer->GetCID());
 
 	MACRO_LUA_CALLBACK("OnDeath", Killer, Weapon)
@@ -950,13 +952,14 @@ bool CCharacter::TakeDamage(vec2 Force, int Dmg, int From, int Weapon)
 
 void CCharacter::Snap(int SnappingClient)
 {
-	MACRO_LUA_EVENT(SnappingClient)
+	MACRO_LUA_PHASE_EVENT(SNAP, SnappingClient)
 
-	if(NetworkClipped(SnappingClient))
+	const CSnapContext *pContext = GameServer()->SnapContext(SnappingClient);
+	if(pContext->Clipped(m_Pos))
 		return;
 
 	int CID = m_pPlayer->GetCID();
-	if(!Server()->IDTranslate(&CID, SnappingClient))
+	if(!pContext->Translate(&CID))
 		return;
 
 	CNetObj_Character *pCharacter = static_cast<CNetObj_Character *>(Server()->SnapNewItem(NETOBJTYPE_CHARACTER, CID, sizeof(CNetObj_Character)));
@@ -992,7 +995,7 @@ void CCharacter::Snap(int SnappingClient)
 	// hooked player ID translation
 	if(pCharacter->m_HookedPlayer != -1)
 	{
-		if(!Server()->IDTranslate(&pCharacter->m_HookedPlayer, SnappingClient))
+		if(!pContext->Translate(&pCharacter->m_HookedPlayer))
 			pCharacter->m_HookedPlayer = -1;
 	}
 
@@ -20,6 +20,7 @@ class CCharacter : public CEntity
 {
 	MACRO_ALLOC_POOL_ID()
 	friend class CLua;
+	friend class CGameWorld;
 
 public:
 	//character's size
@@ -33,6 +34,7 @@ public:
 	virtual void TickDefered();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual bool GetSnapPos(vec2 *pPos) { *pPos = m_Pos; return true; }
 
 	bool IsGrounded();
 
@@ -27,7 +27,7 @@ void CFlag::Reset()
 
 void CFlag::TickPaused()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICKPAUSED)
 
 	++m_DropTick;
 	if(m_GrabTick)
@@ -36,7 +36,7 @@ void CFlag::TickPaused()
 
 void CFlag::Snap(int SnappingClient)
 {
-	MACRO_LUA_EVENT(SnappingClient);
+	MACRO_LUA_PHASE_EVENT(SNAP, SnappingClient);
 
 	if(NetworkClipped(SnappingClient))
 		return;
@@ -23,6 +23,7 @@ public:
 	virtual void Reset();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual int ActivePhases() const { return CGameWorld::PHASEFLAG_TICKPAUSED|CGameWorld::PHASEFLAG_SNAP; }
 
 protected:
 	void OnInsert();
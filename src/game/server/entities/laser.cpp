@@ -89,7 +89,7 @@ void CLaser::Reset()
 
 void CLaser::Tick()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICK)
 
 	if(Server()->Tick() > m_EvalTick+(Server()->TickSpeed()*GameServer()->Tuning()->m_LaserBounceDelay)/1000.0f)
 		DoBounce();
@@ -97,14 +97,14 @@ void CLaser::Tick()
 
 void CLaser::TickPaused()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICKPAUSED)
 
 	++m_EvalTick;
 }
 
 void CLaser::Snap(int SnappingClient)
 {
-	MACRO_LUA_EVENT(SnappingClient)
+	MACRO_LUA_PHASE_EVENT(SNAP, SnappingClient)
 
 	if(NetworkClipped(SnappingClient))
 		return;
@@ -19,22 +19,22 @@ void CLuaEntity::Destroy()
 
 void CLuaEntity::Tick()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICK)
 }
 
 void CLuaEntity::TickDefered()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICKDEFERED)
 }
 
 void CLuaEntity::TickPaused()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICKPAUSED)
 }
 
 void CLuaEntity::Snap(int SnappingClient)
 {
-	MACRO_LUA_EVENT(SnappingClient)
+	MACRO_LUA_PHASE_EVENT(SNAP, SnappingClient)
 }
 
 void CLuaEntity::OnInsert()
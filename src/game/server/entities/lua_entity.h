@@ -14,6 +14,7 @@ public:
 	void TickDefered();
 	void TickPaused();
 	void Snap(int SnappingClient);
+	int ActivePhases() const { return LuaPhases(); }
 
 protected:
 	void OnInsert();
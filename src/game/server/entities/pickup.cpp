@@ -29,7 +29,7 @@ void CPickup::Reset()
 
 void CPickup::Tick()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICK)
 
 	// wait for respawn
 	if(m_SpawnTick > 0)
@@ -134,7 +134,7 @@ void CPickup::Tick()
 
 void CPickup::TickPaused()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICKPAUSED)
 
 	if(m_SpawnTick != -1)
 		++m_SpawnTick;
@@ -142,7 +142,7 @@ void CPickup::TickPaused()
 
 void CPickup::Snap(int SnappingClient)
 {
-	MACRO_LUA_EVENT(SnappingClient)
+	MACRO_LUA_PHASE_EVENT(SNAP, SnappingClient)
 
 	if(m_SpawnTick != -1 || NetworkClipped(SnappingClient))
 		return;
@@ -16,6 +16,8 @@ public:
 	virtual void Tick();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual bool GetSnapPos(vec2 *pPos) { *pPos = m_Pos; return true; }
+	virtual int ActivePhases() const { return CGameWorld::PHASEFLAG_TICK|CGameWorld::PHASEFLAG_TICKPAUSED|CGameWorld::PHASEFLAG_SNAP; }
 
 	// for lua
 	int GetPickupType() const { return m_Type; }
@@ -59,7 +59,7 @@ vec2 CProjectile::GetPos(float Time)
 
 void CProjectile::Tick()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICK)
 
 	float Pt = (Server()->Tick()-m_StartTick-1)/(float)Server()->TickSpeed();
 	float Ct = (Server()->Tick()-m_StartTick)/(float)Server()->TickSpeed();
@@ -88,7 +88,7 @@ void CProjectile::Tick()
 
 void CProjectile::TickPaused()
 {
-	MACRO_LUA_EVENT()
+	MACRO_LUA_PHASE_EVENT(TICKPAUSED)
 
 	++m_StartTick;
 }
@@ -105,7 +105,7 @@ void CProjectile::FillInfo(CNetObj_Projectile *pProj)
 
 void CProjectile::Snap(int SnappingClient)
 {
-	MACRO_LUA_EVENT(SnappingClient)
+	MACRO_LUA_PHASE_EVENT(SNAP, SnappingClient)
 
 	float Ct = (Server()->Tick()-m_StartTick)/(float)Server()->TickSpeed();
 
@@ -117,6 +117,12 @@ void CProjectile::Snap(int SnappingClient)
 		FillInfo(pProj);
 }
 
+bool CProjectile::GetSnapPos(vec2 *pPos)
+{
+	*pPos = GetPos((Server()->Tick()-m_StartTick)/(float)Server()->TickSpeed());
+	return true;
+}
+
 void CProjectile::OnInsert()
 {
 	MACRO_LUA_EVENT()
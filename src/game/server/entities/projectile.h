@@ -29,6 +29,8 @@ public:
 	virtual void Tick();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual bool GetSnapPos(vec2 *pPos);
+	virtual int ActivePhases() const { return CGameWorld::PHASEFLAG_TICK|CGameWorld::PHASEFLAG_TICKPAUSED|CGameWorld::PHASEFLAG_SNAP; }
 
 	// for lua
 	vec2 GetDirection() const { return m_Direction; }
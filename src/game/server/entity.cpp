@@ -20,6 +20,18 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType, const char *pLuaClassName)
 
 	m_pPrevTypeEntity = 0;
 	m_pNextTypeEntity = 0;
+	for(int i = 0; i < CGameWorld::NUM_PHASES; i++)
+	{
+		m_apPrevPhaseEntity[i] = 0;
+		m_apNextPhaseEntity[i] = 0;
+	}
+	m_Phases = 0;
+	m_LuaPhases = 0;
+	m_pPrevSnapEntity = 0;
+	m_pNextSnapEntity = 0;
+	m_SnapBucket = -1;
+	m_SnapCellX = 0;
+	m_SnapCellY = 0;
 }
 
 CEntity::~CEntity()
@@ -28,6 +40,11 @@ CEntity::~CEntity()
 	Server()->SnapFreeID(m_ID);
 }
 
+void CEntity::OnLuaClassBound()
+{
+	GameWorld()->UpdatePhases(this);
+}
+
 int CEntity::NetworkClipped(int SnappingClient)
 {
 	return NetworkClipped(SnappingClient, m_Pos);
@@ -35,18 +52,7 @@ int CEntity::NetworkClipped(int SnappingClient)
 
 int CEntity::NetworkClipped(int SnappingClient, vec2 CheckPos)
 {
-	if(SnappingClient == -1)
-		return 0;
-
-	float dx = GameServer()->m_apPlayers[SnappingClient]->m_ViewPos.x-CheckPos.x;
-	float dy = GameServer()->m_apPlayers[SnappingClient]->m_ViewPos.y-CheckPos.y;
-
-	if(absolute(dx) > 1000.0f || absolute(dy) > 800.0f)
-		return 1;
-
-	if(distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, CheckPos) > 1100.0f)
-		return 1;
-	return 0;
+	return GameServer()->SnapContext(SnappingClient)->Clipped(CheckPos);
 }
 
 bool CEntity::GameLayerClipped(vec2 CheckPos)
@@ -26,6 +26,12 @@
 //	private:
 #define MACRO_ALLOC_HEAP() ;;
 
+/*
+	Like MACRO_LUA_EVENT, but for the phase functions (Tick, Snap, ...) of entities:
+	doesn't bother looking up the lua function if the lua class has none.
+*/
+#define MACRO_LUA_PHASE_EVENT(PHASE, ...) if(LuaPhases()&CGameWorld::PHASEFLAG_##PHASE) MACRO_LUA_EVENT(__VA_ARGS__)
+
 
 #define MACRO_ALLOC_POOL_ID() \
 	public: \
@@ -66,6 +72,17 @@ class CEntity : protected CLuaClass
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
 
+	CEntity *m_apPrevPhaseEntity[CGameWorld::NUM_PHASES];
+	CEntity *m_apNextPhaseEntity[CGameWorld::NUM_PHASES];
+	int m_Phases; // phase lists the entity is in
+	int m_LuaPhases; // phases the lua class implements
+
+	CEntity *m_pPrevSnapEntity;
+	CEntity *m_pNextSnapEntity;
+	int m_SnapBucket; // -1 if not in the snap grid
+	int m_SnapCellX;
+	int m_SnapCellY;
+
 	class CGameWorld *m_pGameWorld;
 
 protected:
@@ -73,6 +90,9 @@ protected:
 	int m_ID;
 	int m_ObjType;
 	virtual void OnInsert() = 0;
+	virtual void OnLuaClassBound();
+
+	int LuaPhases() const { return m_LuaPhases; }
 
 public:
 	CEntity(CGameWorld *pGameWorld, int Objtype, const char *m_pLuaClass);
@@ -87,6 +107,15 @@ public:
 
 	int GetType() const { return m_ObjType; }
 
+	/*
+		Function: active_phases
+			Tells in which phases (CGameWorld::PHASEFLAG_*) the world has to
+			call this entity. Entities are skipped in all the other phases,
+			which is everything the entity doesn't implement in c++ nor
+			forwards to its lua class.
+	*/
+	virtual int ActivePhases() const { return CGameWorld::PHASEFLAG_ALL; }
+
 	/*
 		Function: destroy
 			Destorys the entity.
@@ -132,6 +161,22 @@ public:
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: get_snap_pos
+			Tells the position snap checks with network_clipped, so
+			the world can skip the entity for clients that can't see
+			it. Only entities whose snap sends nothing at all when
+			that position is clipped may return true.
+
+		Arguments:
+			pos - Filled with the position.
+
+		Returns:
+			False if the entity has to be snapped for every client,
+			which is the default.
+	*/
+	virtual bool GetSnapPos(vec2 *pPos) { return false; }
+
 	/*
 		Function: networkclipped(int snapping_client)
 			Performs a series of test to see if a client can see the
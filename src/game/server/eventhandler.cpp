@@ -10,53 +10,145 @@
 CEventHandler::CEventHandler()
 {
 	m_pGameServer = 0;
+	mem_zero(&m_Stats, sizeof(m_Stats));
 	Clear();
 }
 
+CEventHandler::~CEventHandler()
+{
+	for(unsigned i = 0; i < m_lBlocks.size(); i++)
+		mem_free(m_lBlocks[i]);
+}
+
 void CEventHandler::SetGameServer(CGameContext *pGameServer)
 {
 	m_pGameServer = pGameServer;
 }
 
+char *CEventHandler::Alloc(int Size)
+{
+	// continue in the next block, the rest of this one stays unused for this tick
+	if(m_CurrentBlock < (int)m_lBlocks.size() && m_CurrentOffset+Size > BLOCK_SIZE)
+	{
+		m_CurrentBlock++;
+		m_CurrentOffset = 0;
+	}
+	if(m_CurrentBlock == (int)m_lBlocks.size())
+		m_lBlocks.push_back((char *)mem_alloc(BLOCK_SIZE, 1));
+
+	char *p = m_lBlocks[m_CurrentBlock]+m_CurrentOffset;
+	m_CurrentOffset += Size;
+	return p;
+}
+
 void *CEventHandler::Create(int Type, int Size, Cmask *pMask)
 {
-	if(m_NumEvents == MAX_EVENTS)
-		return NULL;
-	if(m_CurrentOffset+Size >= MAX_DATASIZE)
+	if(Size <= 0 || Size > BLOCK_SIZE || (int)m_lEvents.size() == MAX_EVENTS)
+	{
+		if(m_Stats.m_Dropped++ == 0)
+			dbg_msg("events", "dropping event of type %d (size %d, %d events)", Type, Size, (int)m_lEvents.size());
 		return NULL;
+	}
 
-	void *p = &m_aData[m_CurrentOffset];
-	m_aOffsets[m_NumEvents] = m_CurrentOffset;
-	m_aTypes[m_NumEvents] = Type;
-	m_aSizes[m_NumEvents] = Size;
+	CEvent Event;
+	Event.m_Type = Type;
+	Event.m_Size = Size;
+	Event.m_pData = Alloc(Size);
 	if(pMask)
-		m_aClientMasks[m_NumEvents] = *pMask;
+		Event.m_ClientMask = *pMask;
 	else
-		m_aClientMasks[m_NumEvents] = CmaskAll();
-	m_CurrentOffset += Size;
-	m_NumEvents++;
-	return p;
+		Event.m_ClientMask = CmaskAll();
+	Event.m_CellX = Event.m_CellY = 0;
+	Event.m_Next = -1;
+	m_lEvents.push_back(Event);
+
+	m_Stats.m_Created++;
+	return Event.m_pData;
 }
 
 void CEventHandler::Clear()
 {
-	m_NumEvents = 0;
+	if((int)m_lEvents.size() > m_Stats.m_MaxPerTick)
+		m_Stats.m_MaxPerTick = (int)m_lEvents.size();
+
+	m_lEvents.clear();
+	m_CurrentBlock = 0;
 	m_CurrentOffset = 0;
+
+	for(int i = 0; i < NUM_BUCKETS; i++)
+		m_aBuckets[i] = -1;
+	m_NumBinned = 0;
+}
+
+void CEventHandler::BinEvents()
+{
+	// the position is only known after the creator filled in the event
+	for(; m_NumBinned < (int)m_lEvents.size(); m_NumBinned++)
+	{
+		CEvent *pEvent = &m_lEvents[m_NumBinned];
+		const CNetEvent_Common *pCommon = (const CNetEvent_Common *)pEvent->m_pData;
+		pEvent->m_CellX = pCommon->m_X>>CELL_SHIFT;
+		pEvent->m_CellY = pCommon->m_Y>>CELL_SHIFT;
+
+		int Bucket = CEventHandler::Bucket(pEvent->m_CellX, pEvent->m_CellY);
+		pEvent->m_Next = m_aBuckets[Bucket];
+		m_aBuckets[Bucket] = m_NumBinned;
+	}
+}
+
+void CEventHandler::SnapEvent(int Index)
+{
+	const CEvent *pEvent = &m_lEvents[Index];
+	void *d = GameServer()->Server()->SnapNewItem(pEvent->m_Type, Index, pEvent->m_Size);
+	if(d)
+	{
+		mem_copy(d, pEvent->m_pData, pEvent->m_Size);
+		m_Stats.m_Snapped++;
+	}
+	else
+		m_Stats.m_Dropped++;
 }
 
-void CEventHandler::Snap(int SnappingClient)
+void CEventHandler::Snap(const CSnapContext *pContext)
 {
-	for(int i = 0; i < m_NumEvents; i++)
+	const int SnappingClient = pContext->m_ClientID;
+	if(SnappingClient == -1)
+	{
+		for(int i = 0; i < (int)m_lEvents.size(); i++)
+			SnapEvent(i);
+		return;
+	}
+
+	BinEvents();
+
+	int Handled = m_Stats.m_Snapped + m_Stats.m_Dropped;
+
+	// only the cells the view circle touches
+	const vec2 ViewPos = pContext->m_ViewPos;
+	const int MinX = ((int)ViewPos.x-VIEW_RADIUS)>>CELL_SHIFT, MaxX = ((int)ViewPos.x+VIEW_RADIUS)>>CELL_SHIFT;
+	const int MinY = ((int)ViewPos.y-VIEW_RADIUS)>>CELL_SHIFT, MaxY = ((int)ViewPos.y+VIEW_RADIUS)>>CELL_SHIFT;
+	for(int y = MinY; y <= MaxY; y++)
 	{
-		if(SnappingClient == -1 || CmaskIsSet(m_aClientMasks[i], SnappingClient))
+		for(int x = MinX; x <= MaxX; x++)
 		{
-			CNetEvent_Common *ev = (CNetEvent_Common *)&m_aData[m_aOffsets[i]];
-			if(SnappingClient == -1 || distance(GameServer()->m_apPlayers[SnappingClient]->m_ViewPos, vec2(ev->m_X, ev->m_Y)) < 1500.0f)
+			for(int i = m_aBuckets[Bucket(x, y)]; i != -1; i = m_lEvents[i].m_Next)
 			{
-				void *d = GameServer()->Server()->SnapNewItem(m_aTypes[i], i, m_aSizes[i]);
-				if(d)
-					mem_copy(d, &m_aData[m_aOffsets[i]], m_aSizes[i]);
+				const CEvent *pEvent = &m_lEvents[i];
+
+				// other cells can share the bucket
+				if(pEvent->m_CellX != x || pEvent->m_CellY != y)
+					continue;
+
+				if(!CmaskIsSet(pEvent->m_ClientMask, SnappingClient))
+					continue;
+
+				const CNetEvent_Common *pCommon = (const CNetEvent_Common *)pEvent->m_pData;
+				if(distance(ViewPos, vec2(pCommon->m_X, pCommon->m_Y)) < (float)VIEW_RADIUS)
+					SnapEvent(i);
 			}
 		}
 	}
+
+	Handled = m_Stats.m_Snapped + m_Stats.m_Dropped - Handled;
+	m_Stats.m_Culled += (int)m_lEvents.size() - Handled;
 }
@@ -3,32 +3,84 @@
 #ifndef GAME_SERVER_EVENTHANDLER_H
 #define GAME_SERVER_EVENTHANDLER_H
 
+#include <vector>
+#include <base/vmath.h>
+
 #include "cmask.h"
 
-//
+/*
+	Collects the events of the ticks between two snapshots.
+
+	The event data lives in blocks that are kept across ticks, more are
+	allocated whenever a tick needs them, so pointers returned by Create
+	stay valid until Clear. For snapping, the events are sorted into a
+	grid of cells and each client only looks at the cells around its view.
+*/
 class CEventHandler
 {
-	static const int MAX_EVENTS = 128;
-	static const int MAX_DATASIZE = 128*64;
+	enum
+	{
+		BLOCK_SIZE=128*64,
+		MAX_EVENTS=0x10000, // snap item ids are 16 bit
 
-	int m_aTypes[MAX_EVENTS]; // TODO: remove some of these arrays
-	int m_aOffsets[MAX_EVENTS];
-	int m_aSizes[MAX_EVENTS];
-	Cmask m_aClientMasks[MAX_EVENTS];
-	char m_aData[MAX_DATASIZE];
+		CELL_SHIFT=10, // 1024 units per cell
+		NUM_BUCKETS=256, // cells are hashed into these
+		VIEW_RADIUS=1500,
+	};
 
-	class CGameContext *m_pGameServer;
+	struct CEvent
+	{
+		int m_Type;
+		int m_Size;
+		char *m_pData;
+		Cmask m_ClientMask;
+		int m_CellX;
+		int m_CellY;
+		int m_Next; // next event in the same bucket, -1 for the end
+	};
 
+	std::vector<CEvent> m_lEvents;
+	std::vector<char *> m_lBlocks;
+	int m_CurrentBlock;
 	int m_CurrentOffset;
-	int m_NumEvents;
+
+	int m_aBuckets[NUM_BUCKETS];
+	int m_NumBinned;
+
+	class CGameContext *m_pGameServer;
+
+	static int Bucket(int CellX, int CellY) { return (int)(((unsigned)CellX*73856093u ^ (unsigned)CellY*19349663u)&(NUM_BUCKETS-1)); }
+	char *Alloc(int Size);
+	void BinEvents();
+	void SnapEvent(int Index);
+
+public:
+	struct CStats
+	{
+		int m_Created;
+		int m_Dropped; // couldn't be created or didn't fit into a snapshot anymore
+		int m_Snapped;
+		int m_Culled; // not snapped for a client because they're out of its view or not meant for it
+		int m_MaxPerTick;
+	};
+
+private:
+	CStats m_Stats;
+
 public:
 	CGameContext *GameServer() const { return m_pGameServer; }
 	void SetGameServer(CGameContext *pGameServer);
 
 	CEventHandler();
+	~CEventHandler();
 	void *Create(int Type, int Size, Cmask *Mask = 0);
 	void Clear();
-	void Snap(int SnappingClient);
+	void Snap(const class CSnapContext *pContext);
+
+	int NumEvents() const { return (int)m_lEvents.size(); }
+	int NumBlocks() const { return (int)m_lBlocks.size(); }
+	const CStats *Stats() const { return &m_Stats; }
+	void ResetStats() { mem_zero(&m_Stats, sizeof(m_Stats)); }
 };
 
 #endif
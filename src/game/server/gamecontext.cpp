@@ -3,6 +3,7 @@
 #include <new>
 #include <base/math.h>
 #include <engine/shared/config.h>
+#include <engine/shared/profiler.h>
 #include <engine/map.h>
 #include <engine/console.h>
 #include "cmask.h"
@@ -41,6 +42,9 @@ void CGameContext::Construct(int Resetting)
 	m_pVoteOptionLast = 0;
 	m_NumVoteOptions = 0;
 	m_LockTeams = 0;
+	m_SnapContext.Init(this, -1);
+	m_OtherSnapContext.Init(this, -1);
+	m_Snapping = false;
 
 	if(Resetting==NO_RESET)
 		m_pVoteOptionHeap = new CHeap();
@@ -536,14 +540,31 @@ void CGameContext::SwapTeams()
 	(void)m_pController->CheckTeamBalance();
 }
 
+void CGameContext::OnIdleTick()
+{
+	// the world stands still, but the gametype may want to keep its timers going
+	CLua::Lua()->Watchdog()->NextTick();
+	CLua::Lua()->Timers()->Tick(Server()->Tick());
+	CLua::Lua()->Async()->Tick();
+	MACRO_LUA_CALLBACK("OnIdleTick")
+}
+
 void CGameContext::OnTick()
 {
+	// before anything else, so that timers started during this tick count from it
+	CLua::Lua()->Watchdog()->NextTick();
+	CLua::Lua()->Timers()->Tick(Server()->Tick());
+	CLua::Lua()->Async()->Tick();
+
 	// check tuning
 	CheckPureTuning();
 
 	// copy tuning
 	m_World.m_Core.m_Tuning = m_Tuning;
-	m_World.Tick();
+	{
+		PROFILE_SCOPE(PHASE_WORLD);
+		m_World.Tick();
+	}
 
 	//if(world.paused) // make sure that the game object always updates
 	m_pController->Tick();
@@ -1177,7 +1198,7 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
 
 void CGameContext::ConTuneParam(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	const char *pParamName = pResult->GetString(0);
 	float NewValue = pResult->GetFloat(1);
 
@@ -1194,7 +1215,7 @@ void CGameContext::ConTuneParam(IConsole::IResult *pResult, void *pUserData)
 
 void CGameContext::ConTuneReset(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	CTuningParams TuningParams;
 	*pSelf->Tuning() = TuningParams;
 	pSelf->SendTuningParams(-1);
@@ -1203,7 +1224,7 @@ void CGameContext::ConTuneReset(IConsole::IResult *pResult, void *pUserData)
 
 void CGameContext::ConTuneDump(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	char aBuf[256];
 	for(int i = 0; i < pSelf->Tuning()->Num(); i++)
 	{
@@ -1214,21 +1235,38 @@ void CGameContext::ConTuneDump(IConsole::IResult *pResult, void *pUserData)
 	}
 }
 
+void CGameContext::ConEventStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = ConsoleInstance(pUserData);
+	if(pResult->NumArguments() && str_comp(pResult->GetString(0), "reset") == 0)
+	{
+		pSelf->m_Events.ResetStats();
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "events", "statistics reset");
+		return;
+	}
+
+	const CEventHandler::CStats *pStats = pSelf->m_Events.Stats();
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "created=%d dropped=%d snapped=%d culled=%d max_per_tick=%d blocks=%d",
+		pStats->m_Created, pStats->m_Dropped, pStats->m_Snapped, pStats->m_Culled, pStats->m_MaxPerTick, pSelf->m_Events.NumBlocks());
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "events", aBuf);
+}
+
 void CGameContext::ConPause(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	pSelf->m_pController->TogglePause();
 }
 
 void CGameContext::ConChangeMap(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	pSelf->m_pController->ChangeMap(pResult->NumArguments() ? pResult->GetString(0) : "");
 }
 
 void CGameContext::ConRestart(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	if(pResult->NumArguments())
 		pSelf->m_pController->DoWarmup(pResult->GetInteger(0));
 	else
@@ -1237,19 +1275,19 @@ void CGameContext::ConRestart(IConsole::IResult *pResult, void *pUserData)
 
 void CGameContext::ConBroadcast(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	pSelf->SendBroadcast(pResult->GetString(0), -1);
 }
 
 void CGameContext::ConSay(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	pSelf->SendChat(-1, CGameContext::CHAT_ALL, pResult->GetString(0));
 }
 
 void CGameContext::ConSetTeam(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	int ClientID = clamp(pResult->GetInteger(0), 0, (int)MAX_CLIENTS-1);
 	int Team = clamp(pResult->GetInteger(1), -1, 1);
 	int Delay = pResult->NumArguments()>2 ? pResult->GetInteger(2) : 0;
@@ -1267,7 +1305,7 @@ void CGameContext::ConSetTeam(IConsole::IResult *pResult, void *pUserData)
 
 void CGameContext::ConSetTeamAll(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	int Team = clamp(pResult->GetInteger(0), -1, 1);
 
 	char aBuf[256];
@@ -1283,13 +1321,13 @@ void CGameContext::ConSetTeamAll(IConsole::IResult *pResult, void *pUserData)
 
 void CGameContext::ConSwapTeams(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	pSelf->SwapTeams();
 }
 
 void CGameContext::ConShuffleTeams(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	if(!pSelf->m_pController->IsTeamplay())
 		return;
 
@@ -1332,7 +1370,7 @@ void CGameContext::ConShuffleTeams(IConsole::IResult *pResult, void *pUserData)
 
 void CGameContext::ConLockTeams(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	pSelf->m_LockTeams ^= 1;
 	if(pSelf->m_LockTeams)
 		pSelf->SendChat(-1, CGameContext::CHAT_ALL, "Teams were locked");
@@ -1342,7 +1380,7 @@ void CGameContext::ConLockTeams(IConsole::IResult *pResult, void *pUserData)
 
 void CGameContext::ConAddVote(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	const char *pDescription = pResult->GetString(0);
 	const char *pCommand = pResult->GetString(1);
 
@@ -1411,7 +1449,7 @@ void CGameContext::ConAddVote(IConsole::IResult *pResult, void *pUserData)
 
 void CGameContext::ConRemoveVote(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	const char *pDescription = pResult->GetString(0);
 
 	// check for valid option
@@ -1476,7 +1514,7 @@ void CGameContext::ConRemoveVote(IConsole::IResult *pResult, void *pUserData)
 
 void CGameContext::ConForceVote(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 	const char *pType = pResult->GetString(0);
 	const char *pValue = pResult->GetString(1);
 	const char *pReason = pResult->NumArguments() > 2 && pResult->GetString(2)[0] ? pResult->GetString(2) : "No reason given";
@@ -1545,7 +1583,7 @@ void CGameContext::ConForceVote(IConsole::IResult *pResult, void *pUserData)
 
 void CGameContext::ConClearVotes(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 
 	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "cleared votes");
 	CNetMsg_Sv_VoteClearOptions VoteClearOptionsMsg;
@@ -1558,7 +1596,7 @@ void CGameContext::ConClearVotes(IConsole::IResult *pResult, void *pUserData)
 
 void CGameContext::ConVote(IConsole::IResult *pResult, void *pUserData)
 {
-	CGameContext *pSelf = (CGameContext *)pUserData;
+	CGameContext *pSelf = ConsoleInstance(pUserData);
 
 	// check if there is a vote running
 	if(!pSelf->m_VoteCloseTime)
@@ -1582,7 +1620,7 @@ void CGameContext::ConchainSpecialMotdupdate(IConsole::IResult *pResult, void *p
 	{
 		CNetMsg_Sv_Motd Msg;
 		Msg.m_pMessage = g_Config.m_SvMotd;
-		CGameContext *pSelf = (CGameContext *)pUserData;
+		CGameContext *pSelf = ConsoleInstance(pUserData);
 		for(int i = 0; i < MAX_CLIENTS; ++i)
 			if(pSelf->m_apPlayers[i])
 				pSelf->Server()->SendPackMsg(&Msg, MSGFLAG_VITAL, i);
@@ -1597,6 +1635,7 @@ void CGameContext::OnConsoleInit()
 	Console()->Register("tune", "si", CFGFLAG_SERVER, ConTuneParam, this, "Tune variable to value");
 	Console()->Register("tune_reset", "", CFGFLAG_SERVER, ConTuneReset, this, "Reset tuning");
 	Console()->Register("tune_dump", "", CFGFLAG_SERVER, ConTuneDump, this, "Dump tuning");
+	Console()->Register("event_stats", "?s", CFGFLAG_SERVER, ConEventStats, this, "Show how many events were created, dropped, snapped and culled (or 'event_stats reset')");
 
 	Console()->Register("pause", "", CFGFLAG_SERVER, ConPause, this, "Pause/unpause game");
 	Console()->Register("change_map", "?r", CFGFLAG_SERVER|CFGFLAG_STORE, ConChangeMap, this, "Change map");
@@ -1638,7 +1677,7 @@ bool CGameContext::OnInit(/*class IKernel *pKernel*/)
 	m_pController = new CGameControllerMOD(this);
 
 	// all set, fire it up!
-	if(!CLua::Lua()->InitAndStartGametype())
+	if(!CLua::Lua()->InitAndStartGametype(this))
 	{
 		Console()->Printf(IConsole::OUTPUT_LEVEL_STANDARD, "luaserver/ERROR", "failed to load gametype. gametype='%s'", g_Config.m_SvGametype);
 		return false;
@@ -1688,15 +1727,20 @@ void CGameContext::OnSnap(int ClientID)
 		Server()->SendMsg(&Msg, MSGFLAG_RECORD|MSGFLAG_NOSEND, ClientID);
 	}
 
-	m_World.Snap(ClientID);
+	m_SnapContext.Init(this, ClientID);
+	m_Snapping = true;
+
+	m_World.Snap(&m_SnapContext);
 	m_pController->Snap(ClientID);
-	m_Events.Snap(ClientID);
+	m_Events.Snap(&m_SnapContext);
 
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		if(m_apPlayers[i])
-			m_apPlayers[i]->Snap(ClientID);
+			m_apPlayers[i]->Snap(&m_SnapContext);
 	}
+	Server()->SnapSetOwner(0);
+	m_Snapping = false;
 
 	if(ClientID > -1)
 		m_apPlayers[ClientID]->FakeSnap();
@@ -1762,7 +1806,7 @@ int CGameContext::CreateBot()
 	// search for free slot
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
-		if(m_apPlayers[i] == NULL)
+		if(m_apPlayers[i] == NULL && Server()->ClientSlotFree(i))
 		{
 			ClientID = i;
 			break;
@@ -15,6 +15,7 @@
 #include "gamecontroller.h"
 #include "gameworld.h"
 #include "player.h"
+#include "snapcontext.h"
 
 /*
 	Tick
@@ -46,9 +47,12 @@ class CGameContext : public IGameServer, protected CLuaClass
 	CNetObjHandler m_NetObjHandler;
 	CTuningParams m_Tuning;
 
+	// the commands are registered once for all game instances and act on the one they were issued in
+	static CGameContext *ConsoleInstance(void *pUserData) { return (CGameContext *)((CGameContext *)pUserData)->Server()->GameServer(); }
 	static void ConTuneParam(IConsole::IResult *pResult, void *pUserData);
 	static void ConTuneReset(IConsole::IResult *pResult, void *pUserData);
 	static void ConTuneDump(IConsole::IResult *pResult, void *pUserData);
+	static void ConEventStats(IConsole::IResult *pResult, void *pUserData);
 	static void ConPause(IConsole::IResult *pResult, void *pUserData);
 	static void ConChangeMap(IConsole::IResult *pResult, void *pUserData);
 	static void ConRestart(IConsole::IResult *pResult, void *pUserData);
@@ -66,6 +70,10 @@ class CGameContext : public IGameServer, protected CLuaClass
 	static void ConVote(IConsole::IResult *pResult, void *pUserData);
 	static void ConchainSpecialMotdupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 
+	CSnapContext m_SnapContext; // of the client OnSnap is running for
+	CSnapContext m_OtherSnapContext; // for snaps lua starts for someone else
+	bool m_Snapping;
+
 	CGameContext(int Resetting);
 	void Construct(int Resetting);
 
@@ -94,6 +102,15 @@ public:
 
 	int m_LockTeams;
 
+	// what the entities need to know about the client they are snapped for
+	const CSnapContext *SnapContext(int ClientID)
+	{
+		if(m_Snapping && m_SnapContext.m_ClientID == ClientID)
+			return &m_SnapContext;
+		m_OtherSnapContext.Init(this, ClientID);
+		return &m_OtherSnapContext;
+	}
+
 	// voting
 	void StartVote(const char *pDesc, const char *pCommand, const char *pReason);
 	void EndVote();
@@ -160,6 +177,7 @@ public:
 	virtual void OnShutdown();
 
 	virtual void OnTick();
+	virtual void OnIdleTick();
 	virtual void OnPreSnap();
 	virtual void OnSnap(int ClientID);
 	virtual void OnPostSnap();
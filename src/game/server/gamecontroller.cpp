@@ -31,9 +31,7 @@ IGameController::IGameController(class CGameContext *pGameServer) : CLuaClass("G
 	m_UnbalancedTick = -1;
 	m_ForceBalanced = false;
 
-	m_aNumSpawnPoints[0] = 0;
-	m_aNumSpawnPoints[1] = 0;
-	m_aNumSpawnPoints[2] = 0;
+	m_SpawnCacheTick = -1;
 }
 
 IGameController::~IGameController()
@@ -58,32 +56,123 @@ float IGameController::EvaluateSpawnPos(CSpawnEval *pEval, vec2 Pos)
 	return Score;
 }
 
+static const vec2 s_aSpawnOffsets[] = { vec2(0.0f, 0.0f), vec2(-32.0f, 0.0f), vec2(0.0f, -32.0f), vec2(32.0f, 0.0f), vec2(0.0f, 32.0f) };	// start, left, up, right, down
+
+int IGameController::DangerTeam(int Team)
+{
+	return Team == TEAM_RED ? 0 : Team == TEAM_BLUE ? 1 : 2;
+}
+
+void IGameController::AddSpawnPoint(int Type, vec2 Pos)
+{
+	CSpawnPoint Point;
+	Point.m_Pos = Pos;
+	Point.m_SolidMask = 0;
+	for(int i = 0; i < NUM_SPAWN_OFFSETS; i++)
+		if(GameServer()->Collision()->CheckPoint(Pos+s_aSpawnOffsets[i]))
+			Point.m_SolidMask |= 1<<i;
+	Point.m_NumNear = 0;
+	Point.m_OccupiedMask = 0;
+	for(int t = 0; t < NUM_DANGER_TEAMS; t++)
+		Point.m_aDanger[t] = 0.0f;
+	m_alSpawnPoints[Type].push_back(Point);
+	m_SpawnCacheTick = -1;
+}
+
+void IGameController::AddToSpawnCache(CCharacter *pChr)
+{
+	const int Team = DangerTeam(pChr->GetPlayer()->GetTeam());
+	for(int Type = 0; Type < 3; Type++)
+	{
+		for(unsigned i = 0; i < m_alSpawnPoints[Type].size(); i++)
+		{
+			CSpawnPoint *pPoint = &m_alSpawnPoints[Type][i];
+			float d = distance(pPoint->m_Pos, pChr->m_Pos);
+			pPoint->m_aDanger[Team] += d == 0 ? 1000000000.0f : 1.0f/d;
+
+			if(d >= 64.0f+pChr->m_ProximityRadius)
+				continue;
+			pPoint->m_NumNear++;
+			for(int o = 0; o < NUM_SPAWN_OFFSETS; o++)
+				if(distance(pChr->m_Pos, pPoint->m_Pos+s_aSpawnOffsets[o]) <= pChr->m_ProximityRadius)
+					pPoint->m_OccupiedMask |= 1<<o;
+		}
+	}
+}
+
+void IGameController::UpdateSpawnCache()
+{
+	// characters move every tick, so the points are evaluated once per tick at most
+	if(m_SpawnCacheTick == Server()->Tick())
+		return;
+
+	for(int Type = 0; Type < 3; Type++)
+	{
+		for(unsigned i = 0; i < m_alSpawnPoints[Type].size(); i++)
+		{
+			CSpawnPoint *pPoint = &m_alSpawnPoints[Type][i];
+			pPoint->m_NumNear = 0;
+			pPoint->m_OccupiedMask = 0;
+			for(int t = 0; t < NUM_DANGER_TEAMS; t++)
+				pPoint->m_aDanger[t] = 0.0f;
+		}
+	}
+
+	CCharacter *pC = static_cast<CCharacter *>(GameServer()->m_World.FindFirst(CGameWorld::ENTTYPE_CHARACTER));
+	for(; pC; pC = (CCharacter *)pC->TypeNext())
+		AddToSpawnCache(pC);
+
+	m_SpawnCacheTick = Server()->Tick();
+}
+
+void IGameController::OnCharacterAdded(CCharacter *pChr)
+{
+	if(m_SpawnCacheTick == Server()->Tick())
+		AddToSpawnCache(pChr);
+}
+
+void IGameController::OnCharacterRemoved(CCharacter *pChr)
+{
+	m_SpawnCacheTick = -1;
+}
+
+float IGameController::SpawnDanger(const CSpawnPoint *pPoint, int FriendlyTeam) const
+{
+	float Score = 0.0f;
+	for(int t = 0; t < NUM_DANGER_TEAMS; t++)
+	{
+		// team mates are not as dangerous as enemies
+		if(FriendlyTeam != -1 && t == DangerTeam(FriendlyTeam))
+			Score += 0.5f * pPoint->m_aDanger[t];
+		else
+			Score += pPoint->m_aDanger[t];
+	}
+	return Score;
+}
+
 void IGameController::EvaluateSpawnType(CSpawnEval *pEval, int Type)
 {
+	UpdateSpawnCache();
+
 	// get spawn point
-	for(int i = 0; i < m_aNumSpawnPoints[Type]; i++)
+	for(unsigned i = 0; i < m_alSpawnPoints[Type].size(); i++)
 	{
-		// check if the position is occupado
-		CCharacter *aEnts[MAX_CLIENTS];
-		int Num = GameServer()->m_World.FindEntities(m_aaSpawnPoints[Type][i], 64, (CEntity**)aEnts, MAX_CLIENTS, CGameWorld::ENTTYPE_CHARACTER);
-		vec2 Positions[5] = { vec2(0.0f, 0.0f), vec2(-32.0f, 0.0f), vec2(0.0f, -32.0f), vec2(32.0f, 0.0f), vec2(0.0f, 32.0f) };	// start, left, up, right, down
+		const CSpawnPoint *pPoint = &m_alSpawnPoints[Type][i];
+
+		// check if the position is occupado, walls only count with someone close
+		int Blocked = pPoint->m_OccupiedMask;
+		if(pPoint->m_NumNear)
+			Blocked |= pPoint->m_SolidMask;
 		int Result = -1;
-		for(int Index = 0; Index < 5 && Result == -1; ++Index)
-		{
-			Result = Index;
-			for(int c = 0; c < Num; ++c)
-				if(GameServer()->Collision()->CheckPoint(m_aaSpawnPoints[Type][i]+Positions[Index]) ||
-					distance(aEnts[c]->m_Pos, m_aaSpawnPoints[Type][i]+Positions[Index]) <= aEnts[c]->m_ProximityRadius)
-				{
-					Result = -1;
-					break;
-				}
-		}
+		for(int Index = 0; Index < NUM_SPAWN_OFFSETS && Result == -1; ++Index)
+			if(!(Blocked&(1<<Index)))
+				Result = Index;
 		if(Result == -1)
 			continue;	// try next spawn point
 
-		vec2 P = m_aaSpawnPoints[Type][i]+Positions[Result];
-		float S = EvaluateSpawnPos(pEval, P);
+		// the score is only cached for the spawn point itself
+		vec2 P = pPoint->m_Pos+s_aSpawnOffsets[Result];
+		float S = Result == 0 ? SpawnDanger(pPoint, pEval->m_FriendlyTeam) : EvaluateSpawnPos(pEval, P);
 		if(!pEval->m_Got || pEval->m_Score > S)
 		{
 			pEval->m_Got = true;
@@ -132,11 +221,11 @@ bool IGameController::OnEntity(int Index, vec2 Pos)
 	int SubType = 0;
 
 	if(Index == ENTITY_SPAWN)
-		m_aaSpawnPoints[0][m_aNumSpawnPoints[0]++] = Pos;
+		AddSpawnPoint(0, Pos);
 	else if(Index == ENTITY_SPAWN_RED)
-		m_aaSpawnPoints[1][m_aNumSpawnPoints[1]++] = Pos;
+		AddSpawnPoint(1, Pos);
 	else if(Index == ENTITY_SPAWN_BLUE)
-		m_aaSpawnPoints[2][m_aNumSpawnPoints[2]++] = Pos;
+		AddSpawnPoint(2, Pos);
 	else if(Index == ENTITY_ARMOR_1)
 		Type = POWERUP_ARMOR;
 	else if(Index == ENTITY_HEALTH_1)
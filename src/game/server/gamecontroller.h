@@ -3,6 +3,7 @@
 #ifndef GAME_SERVER_GAMECONTROLLER_H
 #define GAME_SERVER_GAMECONTROLLER_H
 
+#include <vector>
 #include <base/vmath.h>
 #include <engine/server/lua_class.h>
 
@@ -13,8 +14,31 @@
 */
 class IGameController : public CLuaClass
 {
-	vec2 m_aaSpawnPoints[3][64];
-	int m_aNumSpawnPoints[3];
+	enum
+	{
+		NUM_SPAWN_OFFSETS=5, // where around a spawn point a player may be put
+		NUM_DANGER_TEAMS=3, // red, blue and anything else
+	};
+
+	struct CSpawnPoint
+	{
+		vec2 m_Pos;
+		int m_SolidMask; // offsets that are inside a wall
+
+		// what the characters of the current tick mean for this point
+		int m_NumNear; // characters within 64 units
+		int m_OccupiedMask; // offsets a character stands on
+		float m_aDanger[NUM_DANGER_TEAMS]; // the score of the first offset, per team of the characters
+	};
+
+	std::vector<CSpawnPoint> m_alSpawnPoints[3];
+	int m_SpawnCacheTick; // tick the spawn points were evaluated for, -1 if outdated
+
+	static int DangerTeam(int Team);
+	void AddSpawnPoint(int Type, vec2 Pos);
+	void UpdateSpawnCache();
+	void AddToSpawnCache(class CCharacter *pChr);
+	float SpawnDanger(const CSpawnPoint *pPoint, int FriendlyTeam) const;
 
 	class CGameContext *m_pGameServer;
 	class IServer *m_pServer;
@@ -128,6 +152,19 @@ public:
 	*/
 	virtual int OnCharacterDeath(class CCharacter *pVictim, class CPlayer *pKiller, int Weapon);
 
+	/*
+		Function: on_character_added / on_character_removed
+			Keep the cached spawn point evaluation of the current tick
+			up to date when characters enter or leave the world in it.
+			Called by the characters themselves, not meant to be
+			overridden.
+
+		Arguments:
+			chr - The character.
+	*/
+	void OnCharacterAdded(class CCharacter *pChr);
+	void OnCharacterRemoved(class CCharacter *pChr);
+
 
 	virtual void OnPlayerInfoChange(class CPlayer *pP);
 
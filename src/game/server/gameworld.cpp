@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 
 #include <engine/shared/config.h>
+#include <engine/shared/profiler.h>
 #include <algorithm>
 #include "gameworld.h"
 #include "entity.h"
@@ -12,6 +13,10 @@
 #include "entities/projectile.h"
 #include "gamecontext.h"
 
+static_assert((int)CGameWorld::NUM_ENTTYPES == (int)CProfiler::NUM_ENTITY_PHASES, "every entity type needs its profiler phase");
+static_assert((int)CGameWorld::PHASEFLAG_TICK == (int)CLua::CLASSCAP_TICK && (int)CGameWorld::PHASEFLAG_TICKDEFERED == (int)CLua::CLASSCAP_TICKDEFERED &&
+	(int)CGameWorld::PHASEFLAG_TICKPAUSED == (int)CLua::CLASSCAP_TICKPAUSED && (int)CGameWorld::PHASEFLAG_SNAP == (int)CLua::CLASSCAP_SNAP, "phases must match the lua class caps");
+
 //////////////////////////////////////////////////
 // game world
 //////////////////////////////////////////////////
@@ -22,8 +27,17 @@ CGameWorld::CGameWorld()
 
 	m_Paused = false;
 	m_ResetRequested = false;
+	m_pNextTraverseEntity = 0;
+	m_TraversePhase = -1;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 		m_apFirstEntityTypes[i] = NULL;
+	for(int p = 0; p < NUM_PHASES; p++)
+		for(int i = 0; i < NUM_ENTTYPES; i++)
+			m_aapFirstPhaseEntities[p][i] = NULL;
+	m_LuaCapsGeneration = -1;
+	for(int i = 0; i <= NUM_SNAP_BUCKETS; i++)
+		m_apSnapBuckets[i] = NULL;
+	m_SnapGridTick = -1;
 }
 
 CGameWorld::~CGameWorld()
@@ -94,6 +108,162 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 	return Num;
 }
 
+void CGameWorld::FillInfo(CEntity *pEnt, CEntityInfo *pInfo)
+{
+	pInfo->m_pEntity = pEnt;
+	pInfo->m_Pos = pEnt->m_Pos;
+	pInfo->m_Vel = vec2(0, 0);
+	pInfo->m_Health = 0;
+	pInfo->m_Armor = 0;
+	pInfo->m_Team = -1;
+	pInfo->m_CID = -1;
+
+	// the type lists only hold their own type, no need for dynamic_cast
+	switch(pEnt->m_ObjType)
+	{
+	case ENTTYPE_CHARACTER:
+		{
+			CCharacter *pChr = static_cast<CCharacter *>(pEnt);
+			pInfo->m_Vel = pChr->GetCore()->m_Vel;
+			pInfo->m_Health = pChr->m_Health;
+			pInfo->m_Armor = pChr->m_Armor;
+			if(pChr->GetPlayer())
+			{
+				pInfo->m_Team = pChr->GetPlayer()->GetTeam();
+				pInfo->m_CID = pChr->GetPlayer()->GetCID();
+			}
+		}
+		break;
+	case ENTTYPE_FLAG:
+		pInfo->m_Vel = static_cast<CFlag *>(pEnt)->m_Vel;
+		pInfo->m_Team = static_cast<CFlag *>(pEnt)->m_Team;
+		break;
+	case ENTTYPE_PROJECTILE:
+		pInfo->m_Vel = static_cast<CProjectile *>(pEnt)->GetDirection();
+		pInfo->m_CID = static_cast<CProjectile *>(pEnt)->GetOwner();
+		break;
+	case ENTTYPE_LASER:
+		pInfo->m_CID = static_cast<CLaser *>(pEnt)->GetOwner();
+		break;
+	}
+
+	if(pInfo->m_Team == -1 && pInfo->m_CID >= 0 && pInfo->m_CID < MAX_CLIENTS && GameServer()->m_apPlayers[pInfo->m_CID])
+		pInfo->m_Team = GameServer()->m_apPlayers[pInfo->m_CID]->GetTeam();
+}
+
+int CGameWorld::Query(int Type, vec2 Pos, float Radius, CEntityInfo *pInfos, int Max)
+{
+	if(Type < 0 || Type >= NUM_ENTTYPES)
+		return 0;
+
+	int Num = 0;
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt && Num < Max; pEnt = pEnt->m_pNextTypeEntity)
+	{
+		if(Radius < 0.0f || distance(pEnt->m_Pos, Pos) < Radius+pEnt->m_ProximityRadius)
+			FillInfo(pEnt, &pInfos[Num++]);
+	}
+	return Num;
+}
+
+int CGameWorld::QueryLua(lua_State *L)
+{
+	// the world itself is argument 1
+	enum
+	{
+		FIELD_X=0,
+		FIELD_Y,
+		FIELD_VX,
+		FIELD_VY,
+		FIELD_HEALTH,
+		FIELD_ARMOR,
+		FIELD_TEAM,
+		FIELD_CID,
+		FIELD_ENT,
+		NUM_FIELDS
+	};
+	static const char *s_apFields[NUM_FIELDS] = { "x", "y", "vx", "vy", "health", "armor", "team", "cid", "ent" };
+
+	int Type = luaL_checkint(L, 2);
+	vec2 Pos(0, 0);
+	float Radius = -1.0f;
+	if(!lua_isnoneornil(L, 4))
+	{
+		Pos = luabridge::Stack<vec2>::get(L, 4);
+		Radius = (float)luaL_checknumber(L, 5);
+	}
+
+	if(lua_isnoneornil(L, 3))
+	{
+		lua_settop(L, 2);
+		lua_newtable(L);
+	}
+	else
+	{
+		luaL_checktype(L, 3, LUA_TTABLE);
+		lua_settop(L, 3);
+	}
+
+	// the arrays go to the stack once, above the table
+	luaL_checkstack(L, NUM_FIELDS+2, "out of stack space");
+	const int First = lua_gettop(L)+1;
+	bool aWanted[NUM_FIELDS];
+	bool Any = false;
+	for(int f = 0; f < NUM_FIELDS; f++)
+	{
+		lua_getfield(L, 3, s_apFields[f]);
+		aWanted[f] = lua_istable(L, -1);
+		Any |= aWanted[f];
+	}
+
+	// a table without any arrays gets the default set
+	if(!Any)
+	{
+		lua_settop(L, 3);
+		for(int f = 0; f < NUM_FIELDS; f++)
+		{
+			lua_newtable(L);
+			if(f == FIELD_ENT)
+				continue;
+			lua_pushvalue(L, -1);
+			lua_setfield(L, 3, s_apFields[f]);
+			aWanted[f] = true;
+		}
+	}
+
+	int Num = 0;
+	CEntityInfo Info;
+	for(CEntity *pEnt = FindFirst(Type); pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	{
+		if(Radius >= 0.0f && distance(pEnt->m_Pos, Pos) >= Radius+pEnt->m_ProximityRadius)
+			continue;
+
+		FillInfo(pEnt, &Info);
+		Num++;
+
+		const lua_Number aValues[FIELD_ENT] = { Info.m_Pos.x, Info.m_Pos.y, Info.m_Vel.x, Info.m_Vel.y,
+			(lua_Number)Info.m_Health, (lua_Number)Info.m_Armor, (lua_Number)Info.m_Team, (lua_Number)Info.m_CID };
+		for(int f = 0; f < FIELD_ENT; f++)
+		{
+			if(!aWanted[f])
+				continue;
+			lua_pushnumber(L, aValues[f]);
+			lua_rawseti(L, First+f, Num);
+		}
+		if(aWanted[FIELD_ENT])
+		{
+			luabridge::Stack<CEntity *>::push(L, pEnt);
+			lua_rawseti(L, First+FIELD_ENT, Num);
+		}
+	}
+
+	lua_settop(L, 3);
+	lua_pushinteger(L, Num);
+	lua_setfield(L, 3, "n");
+	lua_pushinteger(L, Num);
+	lua_insert(L, 3);
+	return 2;
+}
+
 void CGameWorld::InsertEntity(CEntity *pEnt)
 {
 #ifdef CONF_DEBUG
@@ -110,10 +280,75 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+	UpdatePhases(pEnt);
 
 	pEnt->OnInsert();
 }
 
+bool CGameWorld::IsInserted(CEntity *pEnt)
+{
+	return pEnt->m_pNextTypeEntity || pEnt->m_pPrevTypeEntity || m_apFirstEntityTypes[pEnt->m_ObjType] == pEnt;
+}
+
+void CGameWorld::LinkPhase(CEntity *pEnt, int Phase)
+{
+	CEntity **ppFirst = &m_aapFirstPhaseEntities[Phase][pEnt->m_ObjType];
+	if(*ppFirst)
+		(*ppFirst)->m_apPrevPhaseEntity[Phase] = pEnt;
+	pEnt->m_apNextPhaseEntity[Phase] = *ppFirst;
+	pEnt->m_apPrevPhaseEntity[Phase] = 0x0;
+	*ppFirst = pEnt;
+	pEnt->m_Phases |= 1<<Phase;
+}
+
+void CGameWorld::UnlinkPhase(CEntity *pEnt, int Phase)
+{
+	if(Phase == PHASE_SNAP)
+		UnlinkSnapGrid(pEnt);
+
+	if(pEnt->m_apPrevPhaseEntity[Phase])
+		pEnt->m_apPrevPhaseEntity[Phase]->m_apNextPhaseEntity[Phase] = pEnt->m_apNextPhaseEntity[Phase];
+	else
+		m_aapFirstPhaseEntities[Phase][pEnt->m_ObjType] = pEnt->m_apNextPhaseEntity[Phase];
+	if(pEnt->m_apNextPhaseEntity[Phase])
+		pEnt->m_apNextPhaseEntity[Phase]->m_apPrevPhaseEntity[Phase] = pEnt->m_apPrevPhaseEntity[Phase];
+
+	// keep list traversing valid
+	if(m_TraversePhase == Phase && m_pNextTraverseEntity == pEnt)
+		m_pNextTraverseEntity = pEnt->m_apNextPhaseEntity[Phase];
+
+	pEnt->m_apNextPhaseEntity[Phase] = 0;
+	pEnt->m_apPrevPhaseEntity[Phase] = 0;
+	pEnt->m_Phases &= ~(1<<Phase);
+}
+
+void CGameWorld::UpdatePhases(CEntity *pEnt)
+{
+	if(!IsInserted(pEnt))
+		return;
+
+	pEnt->m_LuaPhases = CLua::Lua()->GetClassCaps(pEnt->GetLuaClassName());
+	m_SnapGridTick = -1;
+	int Phases = pEnt->ActivePhases();
+	for(int p = 0; p < NUM_PHASES; p++)
+	{
+		bool Wanted = Phases&(1<<p);
+		bool Linked = pEnt->m_Phases&(1<<p);
+		if(Wanted && !Linked)
+			LinkPhase(pEnt, p);
+		else if(!Wanted && Linked)
+			UnlinkPhase(pEnt, p);
+	}
+}
+
+void CGameWorld::UpdateAllPhases()
+{
+	m_LuaCapsGeneration = CLua::Lua()->ClassCapsGeneration();
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+			UpdatePhases(pEnt);
+}
+
 void CGameWorld::DestroyEntity(CEntity *pEnt)
 {
 	pEnt->m_MarkedForDestroy = true;
@@ -122,9 +357,13 @@ void CGameWorld::DestroyEntity(CEntity *pEnt)
 void CGameWorld::RemoveEntity(CEntity *pEnt)
 {
 	// not in the list
-	if(!pEnt->m_pNextTypeEntity && !pEnt->m_pPrevTypeEntity && m_apFirstEntityTypes[pEnt->m_ObjType] != pEnt)
+	if(!IsInserted(pEnt))
 		return;
 
+	for(int p = 0; p < NUM_PHASES; p++)
+		if(pEnt->m_Phases&(1<<p))
+			UnlinkPhase(pEnt, p);
+
 	// remove
 	if(pEnt->m_pPrevTypeEntity)
 		pEnt->m_pPrevTypeEntity->m_pNextTypeEntity = pEnt->m_pNextTypeEntity;
@@ -134,23 +373,116 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 		pEnt->m_pNextTypeEntity->m_pPrevTypeEntity = pEnt->m_pPrevTypeEntity;
 
 	// keep list traversing valid
-	if(m_pNextTraverseEntity == pEnt)
+	if(m_TraversePhase == -1 && m_pNextTraverseEntity == pEnt)
 		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
 }
 
-//
-void CGameWorld::Snap(int SnappingClient)
+void CGameWorld::BuildSnapGrid()
 {
+	for(int b = 0; b <= NUM_SNAP_BUCKETS; b++)
+	{
+		for(CEntity *pEnt = m_apSnapBuckets[b]; pEnt; pEnt = pEnt->m_pNextSnapEntity)
+			pEnt->m_SnapBucket = -1;
+		m_apSnapBuckets[b] = 0;
+	}
+
 	for(int i = 0; i < NUM_ENTTYPES; i++)
-		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
+		for(CEntity *pEnt = m_aapFirstPhaseEntities[PHASE_SNAP][i]; pEnt; pEnt = pEnt->m_apNextPhaseEntity[PHASE_SNAP])
 		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+			// a lua snap can send anything from anywhere
+			vec2 Pos;
+			int Bucket = SNAP_BUCKET_ALWAYS;
+			if(!(pEnt->m_LuaPhases&PHASEFLAG_SNAP) && pEnt->GetSnapPos(&Pos))
+			{
+				pEnt->m_SnapCellX = (int)Pos.x>>SNAP_CELL_SHIFT;
+				pEnt->m_SnapCellY = (int)Pos.y>>SNAP_CELL_SHIFT;
+				Bucket = SnapBucket(pEnt->m_SnapCellX, pEnt->m_SnapCellY);
+			}
+
+			if(m_apSnapBuckets[Bucket])
+				m_apSnapBuckets[Bucket]->m_pPrevSnapEntity = pEnt;
+			pEnt->m_pNextSnapEntity = m_apSnapBuckets[Bucket];
+			pEnt->m_pPrevSnapEntity = 0x0;
+			pEnt->m_SnapBucket = Bucket;
+			m_apSnapBuckets[Bucket] = pEnt;
+		}
+
+	m_SnapGridTick = Server()->Tick();
+}
+
+void CGameWorld::UnlinkSnapGrid(CEntity *pEnt)
+{
+	if(pEnt->m_SnapBucket == -1)
+		return;
+
+	if(pEnt->m_pPrevSnapEntity)
+		pEnt->m_pPrevSnapEntity->m_pNextSnapEntity = pEnt->m_pNextSnapEntity;
+	else
+		m_apSnapBuckets[pEnt->m_SnapBucket] = pEnt->m_pNextSnapEntity;
+	if(pEnt->m_pNextSnapEntity)
+		pEnt->m_pNextSnapEntity->m_pPrevSnapEntity = pEnt->m_pPrevSnapEntity;
+
+	// keep list traversing valid
+	if(m_TraversePhase == PHASE_SNAP && m_pNextTraverseEntity == pEnt)
+		m_pNextTraverseEntity = pEnt->m_pNextSnapEntity;
+
+	pEnt->m_pNextSnapEntity = 0;
+	pEnt->m_pPrevSnapEntity = 0;
+	pEnt->m_SnapBucket = -1;
+}
+
+void CGameWorld::SnapBucketEntities(int Bucket, int CellX, int CellY, int SnappingClient)
+{
+	for(CEntity *pEnt = m_apSnapBuckets[Bucket]; pEnt; )
+	{
+		m_pNextTraverseEntity = pEnt->m_pNextSnapEntity;
+
+		// other cells can share the bucket
+		if(SnappingClient == -1 || Bucket == SNAP_BUCKET_ALWAYS || (pEnt->m_SnapCellX == CellX && pEnt->m_SnapCellY == CellY))
+		{
+			Server()->SnapSetOwner(pEnt->GetLuaClassName());
 			pEnt->Snap(SnappingClient);
-			pEnt = m_pNextTraverseEntity;
 		}
+		pEnt = m_pNextTraverseEntity;
+	}
+}
+
+//
+void CGameWorld::Snap(const CSnapContext *pContext)
+{
+	// entities move and get created during the tick only
+	if(m_SnapGridTick != Server()->Tick())
+		BuildSnapGrid();
+
+	const int SnappingClient = pContext->m_ClientID;
+	m_TraversePhase = PHASE_SNAP;
+	SnapBucketEntities(SNAP_BUCKET_ALWAYS, 0, 0, SnappingClient);
+	if(SnappingClient == -1)
+	{
+		// the demo gets everything
+		for(int b = 0; b < NUM_SNAP_BUCKETS; b++)
+			SnapBucketEntities(b, 0, 0, SnappingClient);
+	}
+	else
+	{
+		// only the cells the view box touches, the entities clip the rest themselves
+		const vec2 ViewPos = pContext->m_ViewPos;
+		const int MinX = (int)(ViewPos.x-CSnapContext::VIEW_WIDTH)>>SNAP_CELL_SHIFT, MaxX = (int)(ViewPos.x+CSnapContext::VIEW_WIDTH)>>SNAP_CELL_SHIFT;
+		const int MinY = (int)(ViewPos.y-CSnapContext::VIEW_HEIGHT)>>SNAP_CELL_SHIFT, MaxY = (int)(ViewPos.y+CSnapContext::VIEW_HEIGHT)>>SNAP_CELL_SHIFT;
+		for(int y = MinY; y <= MaxY; y++)
+			for(int x = MinX; x <= MaxX; x++)
+				SnapBucketEntities(SnapBucket(x, y), x, y, SnappingClient);
+	}
+	m_TraversePhase = -1;
+	Server()->SnapSetOwner(0);
+}
+
+void CGameWorld::SnapLua(int SnappingClient)
+{
+	Snap(GameServer()->SnapContext(SnappingClient));
 }
 
 void CGameWorld::Reset()
@@ -192,38 +524,55 @@ void CGameWorld::Tick()
 	if(m_ResetRequested)
 		Reset();
 
+	// scripts got (re)loaded
+	if(m_LuaCapsGeneration != CLua::Lua()->ClassCapsGeneration())
+		UpdateAllPhases();
+
 	if(!m_Paused)
 	{
 		if(GameServer()->m_pController->IsForceBalanced())
 			GameServer()->SendChat(-1, CGameContext::CHAT_ALL, "Teams have been balanced");
 		// update all objects
+		m_TraversePhase = PHASE_TICK;
 		for(int i = 0; i < NUM_ENTTYPES; i++)
-			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
+		{
+			CProfileScope Scope(CProfiler::PHASE_ENTITIES+i);
+			for(CEntity *pEnt = m_aapFirstPhaseEntities[PHASE_TICK][i]; pEnt; )
 			{
-				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pNextTraverseEntity = pEnt->m_apNextPhaseEntity[PHASE_TICK];
 				pEnt->Tick();
 				pEnt = m_pNextTraverseEntity;
 			}
+		}
 
+		m_TraversePhase = PHASE_TICKDEFERED;
 		for(int i = 0; i < NUM_ENTTYPES; i++)
-			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
+		{
+			CProfileScope Scope(CProfiler::PHASE_ENTITIES+i);
+			for(CEntity *pEnt = m_aapFirstPhaseEntities[PHASE_TICKDEFERED][i]; pEnt; )
 			{
-				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pNextTraverseEntity = pEnt->m_apNextPhaseEntity[PHASE_TICKDEFERED];
 				pEnt->TickDefered();
 				pEnt = m_pNextTraverseEntity;
 			}
+		}
 	}
 	else
 	{
 		// update all objects
+		m_TraversePhase = PHASE_TICKPAUSED;
 		for(int i = 0; i < NUM_ENTTYPES; i++)
-			for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
+		{
+			CProfileScope Scope(CProfiler::PHASE_ENTITIES+i);
+			for(CEntity *pEnt = m_aapFirstPhaseEntities[PHASE_TICKPAUSED][i]; pEnt; )
 			{
-				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				m_pNextTraverseEntity = pEnt->m_apNextPhaseEntity[PHASE_TICKPAUSED];
 				pEnt->TickPaused();
 				pEnt = m_pNextTraverseEntity;
 			}
+		}
 	}
+	m_TraversePhase = -1;
 
 	RemoveEntities();
 
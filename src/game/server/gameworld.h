@@ -7,6 +7,7 @@
 
 class CEntity;
 class CCharacter;
+struct lua_State;
 
 /*
 	Class: Game World
@@ -27,16 +28,72 @@ public:
 		NUM_ENTTYPES
 	};
 
+	// the calls the world makes to its entities every tick
+	enum
+	{
+		PHASE_TICK = 0,
+		PHASE_TICKDEFERED,
+		PHASE_TICKPAUSED,
+		PHASE_SNAP,
+		NUM_PHASES,
+
+		PHASEFLAG_TICK = 1<<PHASE_TICK,
+		PHASEFLAG_TICKDEFERED = 1<<PHASE_TICKDEFERED,
+		PHASEFLAG_TICKPAUSED = 1<<PHASE_TICKPAUSED,
+		PHASEFLAG_SNAP = 1<<PHASE_SNAP,
+		PHASEFLAG_ALL = (1<<NUM_PHASES)-1,
+	};
+
+	// what a bulk query reports about an entity
+	struct CEntityInfo
+	{
+		CEntity *m_pEntity;
+		vec2 m_Pos;
+		vec2 m_Vel;
+		int m_Health;
+		int m_Armor;
+		int m_Team; // -1 if it has none
+		int m_CID; // the player, or the owner of projectiles and lasers, -1 if none
+	};
+
 private:
 	void Reset();
 	void RemoveEntities();
 
 	CEntity *m_pNextTraverseEntity;
+	int m_TraversePhase; // phase list m_pNextTraverseEntity belongs to, -1 for the type lists
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// per phase and type, only the entities that do anything in that phase
+	CEntity *m_aapFirstPhaseEntities[NUM_PHASES][NUM_ENTTYPES];
+	int m_LuaCapsGeneration;
+
+	// the snap phase entities sorted into a grid of cells, so each client
+	// only visits the cells around its view
+	enum
+	{
+		SNAP_CELL_SHIFT=10, // 1024 units per cell
+		NUM_SNAP_BUCKETS=256, // cells are hashed into these
+		SNAP_BUCKET_ALWAYS=NUM_SNAP_BUCKETS, // entities that can't be culled by position
+	};
+	CEntity *m_apSnapBuckets[NUM_SNAP_BUCKETS+1];
+	int m_SnapGridTick; // tick the grid was built in, -1 if it's outdated
+
+	static int SnapBucket(int CellX, int CellY) { return (int)(((unsigned)CellX*73856093u ^ (unsigned)CellY*19349663u)&(NUM_SNAP_BUCKETS-1)); }
+	void BuildSnapGrid();
+	void UnlinkSnapGrid(CEntity *pEnt);
+	void SnapBucketEntities(int Bucket, int CellX, int CellY, int SnappingClient);
+
+	bool IsInserted(CEntity *pEnt);
+	void LinkPhase(CEntity *pEnt, int Phase);
+	void UnlinkPhase(CEntity *pEnt, int Phase);
+	void UpdateAllPhases();
+
 	class CGameContext *m_pGameServer;
 	class IServer *m_pServer;
 
+	void FillInfo(CEntity *pEnt, CEntityInfo *pInfo);
+
 	void UpdatePlayerMappings();
 	void FindAltSlot(int ForCID, int LargestAssignableID, int WhoIsSearching); // helper
 
@@ -77,6 +134,38 @@ public:
 	*/
 	int FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type);
 
+	/*
+		Function: query
+			Like find_entities, but also collects the state scripts
+			usually read from every entity found.
+
+		Arguments:
+			type - Type of the entities to find.
+			pos - Position.
+			radius - How close the entities have to be, negative for
+				the whole world.
+			infos - Array that is filled with the entities.
+			max - Number of entries that fit into the infos array.
+
+		Returns:
+			Number of entities found and added to the infos array.
+	*/
+	int Query(int Type, vec2 Pos, float Radius, CEntityInfo *pInfos, int Max);
+
+	/*
+		Function: query (lua)
+			World:Query(type [, out [, pos, radius]]) -> n, out
+
+			Fills the arrays in the table out with the entities of a type
+			in one call: x, y, vx, vy, health, armor, team, cid and ent
+			(the entities themselves). Only the arrays out already has are
+			filled, so reusing a table that holds just x and y costs no
+			more than that. If out is missing or has none of them, it
+			gets all arrays but ent. out.n is set to the count, the
+			arrays are not cleared beyond it.
+	*/
+	int QueryLua(lua_State *L);
+
 	/*
 		Function: interserct_CCharacter
 			Finds the closest CCharacter that intersects the line.
@@ -134,16 +223,29 @@ public:
 	*/
 	void DestroyEntity(CEntity *pEntity);
 
+	/*
+		Function: update_phases
+			Puts an entity into the lists of the phases it implements,
+			after its lua class changed.
+
+		Arguments:
+			entity - Entity to update
+	*/
+	void UpdatePhases(CEntity *pEntity);
+
 	/*
 		Function: snap
-			Calls snap on all the entities in the world to create
-			the snapshot.
+			Calls snap on the entities in the world to create the
+			snapshot. Entities that tell their position (see
+			CEntity::GetSnapPos) are only called if they are in a
+			cell the client's view touches.
 
 		Arguments:
-			snapping_client - ID of the client which snapshot
-			is being created.
+			context - The client which snapshot is being
+			created.
 	*/
-	void Snap(int SnappingClient);
+	void Snap(const class CSnapContext *pContext);
+	void SnapLua(int SnappingClient);
 
 	/*
 		Function: tick
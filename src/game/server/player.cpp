@@ -165,15 +165,18 @@ bool CPlayer::AddSpectatorInfoSnap(int SpectatorID, int X, int Y)
     return true;
 }
 
-void CPlayer::Snap(int SnappingClient)
+void CPlayer::Snap(const CSnapContext *pContext)
 {
 	if(!Server()->ClientIngame(m_ClientID))
 		return;
 
+	Server()->SnapSetOwner(GetLuaClassName());
+
+	const int SnappingClient = pContext->m_ClientID;
 	MACRO_LUA_EVENT(SnappingClient)
 
 	int SentCID = m_ClientID;
-	if(!Server()->IDTranslate(&SentCID, SnappingClient))
+	if(!pContext->Translate(&SentCID))
 		return;
 
 	CNetObj_ClientInfo *pClientInfo = static_cast<CNetObj_ClientInfo *>(Server()->SnapNewItem(NETOBJTYPE_CLIENTINFO, SentCID, sizeof(CNetObj_ClientInfo)));
@@ -192,7 +195,7 @@ void CPlayer::Snap(int SnappingClient)
 	if(!pPlayerInfo)
 		return;
 
-	pPlayerInfo->m_Latency = SnappingClient == -1 ? m_Latency.m_Min : GameServer()->m_apPlayers[SnappingClient]->m_aActLatency[m_ClientID];
+	pPlayerInfo->m_Latency = pContext->m_pLatency ? pContext->m_pLatency[m_ClientID] : m_Latency.m_Min;
 	pPlayerInfo->m_Local = 0;
 	pPlayerInfo->m_ClientID = SentCID;
 	pPlayerInfo->m_Score = m_Score;
@@ -213,6 +216,11 @@ void CPlayer::Snap(int SnappingClient)
 	}
 }
 
+void CPlayer::SnapLua(int SnappingClient)
+{
+	Snap(GameServer()->SnapContext(SnappingClient));
+}
+
 void CPlayer::FakeSnap()
 {
 	// This is problematic when it's sent before we know whether it's a non-64-player-client
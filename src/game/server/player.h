@@ -27,7 +27,8 @@ public:
 
 	void Tick();
 	void PostTick();
-	void Snap(int SnappingClient);
+	void Snap(const class CSnapContext *pContext);
+	void SnapLua(int SnappingClient);
 	void FakeSnap();
 
 	void OnDirectInput(const CNetObj_PlayerInput *NewInput);
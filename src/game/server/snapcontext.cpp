@@ -0,0 +1,34 @@
+#include "snapcontext.h"
+#include "gamecontext.h"
+#include "player.h"
+
+void CSnapContext::Init(CGameContext *pGameServer, int ClientID)
+{
+	m_ClientID = ClientID;
+	m_ViewPos = vec2(0, 0);
+	m_Is64 = false;
+	m_Is128 = false;
+	m_pRevMap = 0;
+	m_pLatency = 0;
+	if(ClientID < 0 || ClientID >= MAX_CLIENTS)
+	{
+		m_ClientID = -1;
+		return;
+	}
+
+	IServer::CClientInfo Info;
+	Info.m_Is64 = false;
+	Info.m_Is128 = false;
+	pGameServer->Server()->GetClientInfo(ClientID, &Info);
+	m_Is64 = Info.m_Is64;
+	m_Is128 = Info.m_Is128;
+	if(!m_Is128)
+		m_pRevMap = pGameServer->Server()->GetRevMap(ClientID);
+
+	CPlayer *pPlayer = pGameServer->m_apPlayers[ClientID];
+	if(pPlayer)
+	{
+		m_ViewPos = pPlayer->m_ViewPos;
+		m_pLatency = pPlayer->m_aActLatency;
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef GAME_SERVER_SNAPCONTEXT_H
+#define GAME_SERVER_SNAPCONTEXT_H
+
+#include <base/math.h>
+#include <base/vmath.h>
+#include <engine/server.h>
+
+/*
+	Everything about the snapping client that the entities ask for over and
+	over, looked up once per snapshot instead of once per entity: where it
+	looks, whether it needs its IDs translated and the latencies it measured.
+*/
+class CSnapContext
+{
+public:
+	enum
+	{
+		VIEW_WIDTH=1000, // from the view position to the side
+		VIEW_HEIGHT=800,
+		VIEW_RADIUS=1100,
+	};
+
+	int m_ClientID; // -1 for the demo recorder
+	vec2 m_ViewPos;
+	bool m_Is64;
+	bool m_Is128;
+	const IDMapT *m_pRevMap; // internal ID -> the ID the client knows it by, NULL if it knows everyone as they are
+	const int *m_pLatency; // of every player as this client sees it, NULL for the demo recorder
+
+	void Init(class CGameContext *pGameServer, int ClientID);
+
+	bool Clipped(vec2 Pos) const
+	{
+		if(m_ClientID == -1)
+			return false;
+
+		float dx = m_ViewPos.x-Pos.x;
+		float dy = m_ViewPos.y-Pos.y;
+		if(absolute(dx) > (float)VIEW_WIDTH || absolute(dy) > (float)VIEW_HEIGHT)
+			return true;
+		return dx*dx+dy*dy > (float)VIEW_RADIUS*VIEW_RADIUS;
+	}
+
+	// same as IServer::IDTranslate
+	bool Translate(int *pInOutID) const
+	{
+		// the demo recorder never got player infos, keep it that way
+		if(m_ClientID == -1 || *pInOutID < 0 || *pInOutID >= MAX_CLIENTS)
+			return false;
+		if(!m_pRevMap)
+			return true;
+
+		int MappedID = m_pRevMap[*pInOutID];
+		if(MappedID == IDMapT::DEFAULT)
+			return false;
+		*pInOutID = MappedID;
+		return true;
+	}
+
+	// lua
+	bool ClippedLua(vec2 Pos) const { return Clipped(Pos); }
+	int TranslateLua(int ID) const { return Translate(&ID) ? ID : -1; }
+	int LatencyLua(int ClientID) const { return m_pLatency && ClientID >= 0 && ClientID < MAX_CLIENTS ? m_pLatency[ClientID] : -1; }
+};
+
+#endif
@@ -1,16 +1,91 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
+#include <engine/shared/linereader.h>
+#include <engine/shared/network.h>
 
 #include <cstdlib>
 
+/*
+	crapnet - a local network simulator that sits between clients and a server
+
+	Every client that sends to the listen port gets a flow with its own socket
+	towards the server, so the server sees them as separate clients. Each flow
+	has a profile that adds latency, jitter, spikes, loss, duplication,
+	reordering and a bandwidth limit, applied to both directions.
+
+	usage: crapnet [-p <listen port>] [-s <server addr>] [-c <config file>]
+	               [-w <capture file>] [-r <capture file>] [-i <stats interval>] [-l]
+
+	The config file holds one command per line, '#' starts a comment:
+		profile <name> [latency <ms>] [jitter <ms>] [spike <ms>] [spikefreq <packets>]
+		               [loss <%>] [duplicate <%>] [reorder <%>] [bandwidth <kbit/s>]
+		flow <n|*> <profile>           the profile of the n-th client, or of everyone else
+		cycle <seconds> <profile> ...  switch the profile of '*' every few seconds
+
+	-w writes every packet to a capture file as it arrives, before it gets
+	impaired. -r replays the client packets of such a capture against the
+	server with the original timing, one socket per captured flow.
+*/
+
+enum
+{
+	MAX_PROFILES=32,
+	MAX_FLOWS=256,
+	MAX_CYCLE=16,
+	FLOW_TIMEOUT=30, // seconds
+	MAX_QUEUE_DELAY=500, // ms a packet may wait for bandwidth before it's dropped
+
+	DIR_UP=0, // client to server
+	DIR_DOWN,
+	NUM_DIRS,
+};
+
+struct CProfile
+{
+	char m_aName[32];
+	int m_Latency; // ms, one way
+	int m_Jitter; // ms
+	int m_Spike; // ms
+	int m_SpikeFreq; // every n-th packet
+	int m_Loss; // percent
+	int m_Duplicate; // percent
+	int m_Reorder; // percent
+	int m_Bandwidth; // kbit/s, 0 for unlimited
+};
+
+struct CDirStats
+{
+	int m_Packets;
+	int m_Bytes;
+	int m_Dropped;
+	int m_Duplicated;
+	int m_Reordered;
+	int m_ResendRequests; // packets asking the other side to resend
+};
+
+struct CFlow
+{
+	bool m_Used;
+	int m_ID;
+	NETADDR m_ClientAddr;
+	NETSOCKET m_Socket; // towards the server
+	int64 m_LastActive;
+	int m_ProfileOverride; // -1 to follow '*'
+	int64 m_aNextFree[NUM_DIRS]; // when the link is free again for the bandwidth limit
+	int m_aCount[NUM_DIRS];
+	CDirStats m_aStats[NUM_DIRS];
+};
+
 struct CPacket
 {
 	CPacket *m_pPrev;
 	CPacket *m_pNext;
 
-	NETADDR m_SendTo;
-	int64 m_Timestamp;
+	CFlow *m_pFlow;
+	int m_Dir;
+	int64 m_Timestamp; // when it goes out
 	int m_ID;
 	int m_DataSize;
 	char m_aData[1];
@@ -18,198 +93,568 @@ struct CPacket
 
 static CPacket *m_pFirst = (CPacket *)0;
 static CPacket *m_pLast = (CPacket *)0;
-static int m_CurrentLatency = 0;
 
-struct CPingConfig
-{
-	int m_Base;
-	int m_Flux;
-	int m_Spike;
-	int m_Loss;
-	int m_Delay;
-	int m_DelayFreq;
+static CProfile m_aProfiles[MAX_PROFILES] = {
+//		name		latency	jitter	spike	spikefreq	loss	dup	reorder	bandwidth
+		{"none",	0,		0,		0,		0,			0,		0,	0,		0},
+		{"lag",		40,		20,		100,	100,		0,		0,	0,		0},
+		{"heavylag",140,	40,		200,	100,		0,		0,	0,		0},
 };
+static int m_NumProfiles = 3;
 
-static CPingConfig m_aConfigPings[] = {
-//		base	flux	spike	loss	delay	delayfreq
-		{0,		0,		0,		0,		0,		0},
-		{40,	20,		100,		0,		0,		0},
-		{140,	40,		200,		0,		0,		0},
-};
-
-static int m_ConfigNumpingconfs = sizeof(m_aConfigPings)/sizeof(CPingConfig);
-static int m_ConfigInterval = 10; // seconds between different pingconfigs
+static int m_aFlowProfiles[MAX_FLOWS]; // -1 for the default
+static int m_aCycle[MAX_CYCLE] = {0, 1, 2};
+static int m_CycleLength = 3;
+static int m_ConfigInterval = 10; // seconds between the profiles of the cycle
 static int m_ConfigLog = 0;
-static int m_ConfigReorder = 0;
+static int m_ConfigStatsInterval = 5;
+
+static CFlow m_aFlows[MAX_FLOWS];
+static int m_NextFlowID = 0;
+static NETSOCKET m_ListenSocket;
+static NETADDR m_ServerAddr;
+static IOHANDLE m_CaptureFile = 0;
+static int64 m_StartTime;
 
-void Run(unsigned short Port, NETADDR Dest)
+static int FindProfile(const char *pName)
 {
-	NETADDR Src = {NETTYPE_IPV4, {0,0,0,0}, Port};
-	NETSOCKET Socket = net_udp_create(Src, 0);
+	for(int i = 0; i < m_NumProfiles; i++)
+		if(str_comp(m_aProfiles[i].m_aName, pName) == 0)
+			return i;
+	return -1;
+}
 
-	char aBuffer[1024*2];
-	int ID = 0;
-	int Delaycounter = 0;
+static const CProfile *FlowProfile(const CFlow *pFlow)
+{
+	if(pFlow->m_ProfileOverride >= 0)
+		return &m_aProfiles[pFlow->m_ProfileOverride];
+	int n = ((time_get()-m_StartTime)/time_freq()/m_ConfigInterval) % m_CycleLength;
+	return &m_aProfiles[m_aCycle[n]];
+}
 
-	while(1)
+static int64 Ms(int Ms) { return time_freq()*Ms/1000; }
+static bool Chance(int Percent) { return Percent > 0 && rand()%100 < Percent; }
+
+static char *NextWord(char **ppStr)
+{
+	char *pWord = str_skip_whitespaces(*ppStr);
+	if(!*pWord || *pWord == '#')
+		return 0;
+	char *pEnd = str_skip_to_whitespace(pWord);
+	if(*pEnd)
+		*pEnd++ = 0;
+	*ppStr = pEnd;
+	return pWord;
+}
+
+static bool LoadConfig(const char *pFilename)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
 	{
-		static int Lastcfg = 0;
-		int n = ((time_get()/time_freq())/m_ConfigInterval) % m_ConfigNumpingconfs;
-		CPingConfig Ping = m_aConfigPings[n];
+		dbg_msg("crapnet", "failed to open config '%s'", pFilename);
+		return false;
+	}
 
-		if(n != Lastcfg)
-			dbg_msg("crapnet", "cfg = %d", n);
-		Lastcfg = n;
+	CLineReader LineReader;
+	LineReader.Init(File);
+	m_NumProfiles = 1; // keep "none"
+	m_CycleLength = 1;
+	m_aCycle[0] = 0;
 
-		// handle incomming packets
-		while(1)
-		{
-			// fetch data
-			int DataTrash = 0;
-			NETADDR From;
-			int Bytes = net_udp_recv(Socket, &From, aBuffer, 1024*2);
-			if(Bytes <= 0)
-				break;
+	int Line = 0;
+	char *pLine;
+	while((pLine = LineReader.Get()))
+	{
+		Line++;
+		char *pCmd = NextWord(&pLine);
+		if(!pCmd)
+			continue;
 
-			if((rand()%100) < Ping.m_Loss) // drop the packet
+		if(str_comp(pCmd, "profile") == 0)
+		{
+			char *pName = NextWord(&pLine);
+			if(!pName || m_NumProfiles == MAX_PROFILES)
 			{
-				if(m_ConfigLog)
-					dbg_msg("crapnet", "dropped packet");
+				dbg_msg("crapnet", "%s:%d: invalid profile", pFilename, Line);
 				continue;
 			}
-
-			// create new packet
-			CPacket *p = (CPacket *)mem_alloc(sizeof(CPacket)+Bytes, 1);
-
-			if(net_addr_comp(&From, &Dest) == 0)
-				p->m_SendTo = Src; // from the server
-			else
+			int Index = FindProfile(pName);
+			if(Index < 0)
+				Index = m_NumProfiles++;
+			CProfile *pProfile = &m_aProfiles[Index];
+			mem_zero(pProfile, sizeof(*pProfile));
+			str_copy(pProfile->m_aName, pName, sizeof(pProfile->m_aName));
+
+			char *pKey, *pValue;
+			while((pKey = NextWord(&pLine)) && (pValue = NextWord(&pLine)))
 			{
-				Src = From; // from the client
-				p->m_SendTo = Dest;
+				int Value = str_toint(pValue);
+				if(str_comp(pKey, "latency") == 0) pProfile->m_Latency = Value;
+				else if(str_comp(pKey, "jitter") == 0) pProfile->m_Jitter = Value;
+				else if(str_comp(pKey, "spike") == 0) pProfile->m_Spike = Value;
+				else if(str_comp(pKey, "spikefreq") == 0) pProfile->m_SpikeFreq = Value;
+				else if(str_comp(pKey, "loss") == 0) pProfile->m_Loss = Value;
+				else if(str_comp(pKey, "duplicate") == 0) pProfile->m_Duplicate = Value;
+				else if(str_comp(pKey, "reorder") == 0) pProfile->m_Reorder = Value;
+				else if(str_comp(pKey, "bandwidth") == 0) pProfile->m_Bandwidth = Value;
+				else
+					dbg_msg("crapnet", "%s:%d: unknown profile setting '%s'", pFilename, Line, pKey);
 			}
-
-			// queue packet
-			p->m_pPrev = m_pLast;
-			p->m_pNext = 0;
-			if(m_pLast)
-				m_pLast->m_pNext = p;
-			else
+		}
+		else if(str_comp(pCmd, "flow") == 0)
+		{
+			char *pWhich = NextWord(&pLine);
+			char *pName = NextWord(&pLine);
+			int Profile = pName ? FindProfile(pName) : -1;
+			if(!pWhich || Profile < 0)
 			{
-				m_pFirst = p;
-				m_pLast = p;
+				dbg_msg("crapnet", "%s:%d: invalid flow, profiles have to be defined first", pFilename, Line);
+				continue;
 			}
-			m_pLast = p;
-
-			// set data in packet
-			p->m_Timestamp = time_get();
-			p->m_DataSize = Bytes;
-			p->m_ID = ID++;
-			mem_copy(p->m_aData, aBuffer, Bytes);
-
-			if(ID > 20 && Bytes > 6 && DataTrash)
+			if(str_comp(pWhich, "*") == 0)
 			{
-				p->m_aData[6+(rand()%(Bytes-6))] = rand()&255; // modify a byte
-				if((rand()%10) == 0)
-				{
-					p->m_DataSize -= rand()%32;
-					if(p->m_DataSize < 6)
-						p->m_DataSize = 6;
-				}
+				m_aCycle[0] = Profile;
+				m_CycleLength = 1;
 			}
-
-			if(Delaycounter <= 0)
+			else if(str_toint(pWhich) >= 0 && str_toint(pWhich) < MAX_FLOWS)
+				m_aFlowProfiles[str_toint(pWhich)] = Profile;
+		}
+		else if(str_comp(pCmd, "cycle") == 0)
+		{
+			char *pInterval = NextWord(&pLine);
+			if(!pInterval || str_toint(pInterval) <= 0)
+			{
+				dbg_msg("crapnet", "%s:%d: invalid cycle", pFilename, Line);
+				continue;
+			}
+			m_ConfigInterval = str_toint(pInterval);
+			m_CycleLength = 0;
+			char *pName;
+			while((pName = NextWord(&pLine)) && m_CycleLength < MAX_CYCLE)
 			{
-				if(Ping.m_Delay)
-					p->m_Timestamp += (time_freq()*1000)/Ping.m_Delay;
-				Delaycounter = Ping.m_DelayFreq;
+				int Profile = FindProfile(pName);
+				if(Profile < 0)
+					dbg_msg("crapnet", "%s:%d: unknown profile '%s'", pFilename, Line, pName);
+				else
+					m_aCycle[m_CycleLength++] = Profile;
 			}
-			Delaycounter--;
+			if(m_CycleLength == 0)
+				m_aCycle[m_CycleLength++] = 0;
+		}
+		else
+			dbg_msg("crapnet", "%s:%d: unknown command '%s'", pFilename, Line, pCmd);
+	}
+
+	io_close(File);
+	return true;
+}
 
-			if(m_ConfigLog)
+static CFlow *FindFlow(const NETADDR *pClientAddr)
+{
+	for(int i = 0; i < MAX_FLOWS; i++)
+		if(m_aFlows[i].m_Used && net_addr_comp(&m_aFlows[i].m_ClientAddr, pClientAddr) == 0)
+			return &m_aFlows[i];
+	return 0;
+}
+
+static CFlow *NewFlow(const NETADDR *pClientAddr)
+{
+	for(int i = 0; i < MAX_FLOWS; i++)
+	{
+		CFlow *pFlow = &m_aFlows[i];
+		if(pFlow->m_Used)
+			continue;
+
+		NETADDR BindAddr = {NETTYPE_IPV4, {0,0,0,0}, 0};
+		NETSOCKET Socket = net_udp_create(BindAddr, 1);
+		if(!Socket.type)
+		{
+			dbg_msg("crapnet", "failed to create a socket for a new flow");
+			return 0;
+		}
+
+		mem_zero(pFlow, sizeof(*pFlow));
+		pFlow->m_Used = true;
+		pFlow->m_ID = m_NextFlowID++;
+		pFlow->m_ClientAddr = *pClientAddr;
+		pFlow->m_Socket = Socket;
+		pFlow->m_LastActive = time_get();
+		pFlow->m_ProfileOverride = pFlow->m_ID < MAX_FLOWS ? m_aFlowProfiles[pFlow->m_ID] : -1;
+
+		char aAddrStr[NETADDR_MAXSTRSIZE];
+		net_addr_str(pClientAddr, aAddrStr, sizeof(aAddrStr), true);
+		dbg_msg("crapnet", "flow %d: new client %s, profile '%s'", pFlow->m_ID, aAddrStr, FlowProfile(pFlow)->m_aName);
+		return pFlow;
+	}
+
+	dbg_msg("crapnet", "too many flows");
+	return 0;
+}
+
+static void PrintStats(CFlow *pFlow, const char *pWhat)
+{
+	static const char *s_apDirs[NUM_DIRS] = {"up", "down"};
+	for(int d = 0; d < NUM_DIRS; d++)
+	{
+		const CDirStats *pStats = &pFlow->m_aStats[d];
+		dbg_msg("crapnet", "flow %d %s %-4s %6d packets %8d bytes, %d dropped, %d duplicated, %d reordered, %d resend requests",
+			pFlow->m_ID, pWhat, s_apDirs[d], pStats->m_Packets, pStats->m_Bytes, pStats->m_Dropped,
+			pStats->m_Duplicated, pStats->m_Reordered, pStats->m_ResendRequests);
+	}
+}
+
+static void CloseFlow(CFlow *pFlow)
+{
+	PrintStats(pFlow, "closed");
+
+	// forget the packets that are still underway
+	CPacket *pNext;
+	for(CPacket *p = m_pFirst; p; p = pNext)
+	{
+		pNext = p->m_pNext;
+		if(p->m_pFlow != pFlow)
+			continue;
+		if(p->m_pNext)
+			p->m_pNext->m_pPrev = p->m_pPrev;
+		else
+			m_pLast = p->m_pPrev;
+		if(p->m_pPrev)
+			p->m_pPrev->m_pNext = p->m_pNext;
+		else
+			m_pFirst = p->m_pNext;
+		mem_free(p);
+	}
+
+	net_udp_close(pFlow->m_Socket);
+	pFlow->m_Used = false;
+}
+
+static void Capture(const CFlow *pFlow, int Dir, const char *pData, int Size)
+{
+	if(!m_CaptureFile)
+		return;
+
+	// time in microseconds, direction, flow, size, data; little endian
+	unsigned char aHeader[13];
+	int64 Time = (time_get()-m_StartTime)*1000000/time_freq();
+	for(int i = 0; i < 8; i++)
+		aHeader[i] = (Time>>(i*8))&0xff;
+	aHeader[8] = Dir;
+	aHeader[9] = pFlow->m_ID&0xff;
+	aHeader[10] = (pFlow->m_ID>>8)&0xff;
+	aHeader[11] = Size&0xff;
+	aHeader[12] = (Size>>8)&0xff;
+	io_write(m_CaptureFile, aHeader, sizeof(aHeader));
+	io_write(m_CaptureFile, pData, Size);
+}
+
+static void Enqueue(CPacket *p)
+{
+	// mostly in order, so search from the back
+	CPacket *pAfter = m_pLast;
+	while(pAfter && pAfter->m_Timestamp > p->m_Timestamp)
+		pAfter = pAfter->m_pPrev;
+
+	p->m_pPrev = pAfter;
+	p->m_pNext = pAfter ? pAfter->m_pNext : m_pFirst;
+	if(p->m_pNext)
+		p->m_pNext->m_pPrev = p;
+	else
+		m_pLast = p;
+	if(pAfter)
+		pAfter->m_pNext = p;
+	else
+		m_pFirst = p;
+}
+
+static void Impair(CFlow *pFlow, int Dir, const char *pData, int Bytes)
+{
+	static int s_ID = 0;
+	const CProfile *pProfile = FlowProfile(pFlow);
+	CDirStats *pStats = &pFlow->m_aStats[Dir];
+	int64 Now = time_get();
+
+	pFlow->m_LastActive = Now;
+	pStats->m_Packets++;
+	pStats->m_Bytes += Bytes;
+	// connless packets start with 0xff and would look like a resend request
+	int Flags = (unsigned char)pData[0]>>4;
+	if(Bytes >= NET_PACKETHEADERSIZE && !(Flags&NET_PACKETFLAG_CONNLESS) && (Flags&NET_PACKETFLAG_RESEND))
+		pStats->m_ResendRequests++;
+	Capture(pFlow, Dir, pData, Bytes);
+
+	if(Chance(pProfile->m_Loss))
+	{
+		pStats->m_Dropped++;
+		if(m_ConfigLog)
+			dbg_msg("crapnet", "flow %d: dropped packet", pFlow->m_ID);
+		return;
+	}
+
+	int Copies = Chance(pProfile->m_Duplicate) ? 2 : 1;
+	if(Copies > 1)
+		pStats->m_Duplicated++;
+
+	for(int c = 0; c < Copies; c++)
+	{
+		int64 Delay = Ms(pProfile->m_Latency);
+		if(pProfile->m_Jitter)
+			Delay += (int64)(Ms(pProfile->m_Jitter)*(rand()/(double)RAND_MAX));
+		if(pProfile->m_Spike && pProfile->m_SpikeFreq && (pFlow->m_aCount[Dir]%pProfile->m_SpikeFreq) == 0)
+			Delay += Ms(pProfile->m_Spike);
+		bool Reorder = Chance(pProfile->m_Reorder);
+		pFlow->m_aCount[Dir]++;
+
+		int64 SendTime = Now+Delay;
+		if(pProfile->m_Bandwidth > 0)
+		{
+			// the link sends one packet after the other
+			SendTime = max(SendTime, pFlow->m_aNextFree[Dir]);
+			if(SendTime-Now-Delay > Ms(MAX_QUEUE_DELAY))
 			{
-				char aAddrStr[NETADDR_MAXSTRSIZE];
-				net_addr_str(&From, aAddrStr, sizeof(aAddrStr), true);
-				dbg_msg("crapnet", "<< %08d %s (%d)", p->m_ID, aAddrStr, p->m_DataSize);
+				pStats->m_Dropped++;
+				continue;
 			}
+			pFlow->m_aNextFree[Dir] = SendTime + time_freq()*Bytes*8/(pProfile->m_Bandwidth*1000);
+		}
+		if(Reorder)
+		{
+			// hold it back long enough for the next packets to overtake it, after the link
+			// so that it doesn't hold up everything behind it
+			SendTime += Ms(max(pProfile->m_Jitter, 10)*2);
+			pStats->m_Reordered++;
 		}
 
-		//
-		/*while(1)
-		{*/
-		CPacket *p = 0;
-		CPacket *pNext = m_pFirst;
+		CPacket *p = (CPacket *)mem_alloc(sizeof(CPacket)+Bytes, 1);
+		p->m_pFlow = pFlow;
+		p->m_Dir = Dir;
+		p->m_Timestamp = SendTime;
+		p->m_ID = s_ID++;
+		p->m_DataSize = Bytes;
+		mem_copy(p->m_aData, pData, Bytes);
+		Enqueue(p);
+
+		if(m_ConfigLog)
+			dbg_msg("crapnet", "flow %d: %s %08d (%d) in %dms", pFlow->m_ID, Dir == DIR_UP ? "<<" : ">>", p->m_ID, Bytes, (int)((SendTime-Now)*1000/time_freq()));
+	}
+}
+
+static void SendDue()
+{
+	int64 Now = time_get();
+	while(m_pFirst && m_pFirst->m_Timestamp <= Now)
+	{
+		CPacket *p = m_pFirst;
+		m_pFirst = p->m_pNext;
+		if(m_pFirst)
+			m_pFirst->m_pPrev = 0;
+		else
+			m_pLast = 0;
+
+		if(p->m_Dir == DIR_UP)
+			net_udp_send(p->m_pFlow->m_Socket, &m_ServerAddr, p->m_aData, p->m_DataSize);
+		else
+			net_udp_send(m_ListenSocket, &p->m_pFlow->m_ClientAddr, p->m_aData, p->m_DataSize);
+		mem_free(p);
+	}
+}
+
+void Run(unsigned short Port)
+{
+	NETADDR Src = {NETTYPE_IPV4, {0,0,0,0}, Port};
+	m_ListenSocket = net_udp_create(Src, 0);
+	if(!m_ListenSocket.type)
+	{
+		dbg_msg("crapnet", "failed to open port %d", Port);
+		return;
+	}
+
+	char aBuffer[1024*2];
+	int LastCycle = -1;
+	int64 NextStats = time_get()+time_freq()*m_ConfigStatsInterval;
+
+	while(1)
+	{
+		if(m_CycleLength > 1)
+		{
+			int n = ((time_get()-m_StartTime)/time_freq()/m_ConfigInterval) % m_CycleLength;
+			if(n != LastCycle)
+				dbg_msg("crapnet", "profile = %s", m_aProfiles[m_aCycle[n]].m_aName);
+			LastCycle = n;
+		}
+
+		// from the clients
 		while(1)
 		{
-			p = pNext;
-			if(!p)
+			NETADDR From;
+			int Bytes = net_udp_recv(m_ListenSocket, &From, aBuffer, sizeof(aBuffer));
+			if(Bytes <= 0)
 				break;
-			pNext = p->m_pNext;
 
-			if((time_get()-p->m_Timestamp) > m_CurrentLatency)
+			CFlow *pFlow = FindFlow(&From);
+			if(!pFlow && !(pFlow = NewFlow(&From)))
+				continue;
+			Impair(pFlow, DIR_UP, aBuffer, Bytes);
+		}
+
+		// from the server
+		for(int i = 0; i < MAX_FLOWS; i++)
+		{
+			CFlow *pFlow = &m_aFlows[i];
+			if(!pFlow->m_Used)
+				continue;
+
+			while(1)
 			{
-				char aFlags[] = "  ";
+				NETADDR From;
+				int Bytes = net_udp_recv(pFlow->m_Socket, &From, aBuffer, sizeof(aBuffer));
+				if(Bytes <= 0)
+					break;
+				Impair(pFlow, DIR_DOWN, aBuffer, Bytes);
+			}
 
-				if(m_ConfigReorder && (rand()%2) == 0 && p->m_pNext)
-				{
-					aFlags[0] = 'R';
-					p = m_pFirst->m_pNext;
-				}
+			if(time_get() > pFlow->m_LastActive+time_freq()*FLOW_TIMEOUT)
+				CloseFlow(pFlow);
+		}
 
-				if(p->m_pNext)
-					p->m_pNext->m_pPrev = p->m_pPrev;
-				else
-					m_pLast = p->m_pPrev;
+		SendDue();
 
-				if(p->m_pPrev)
-					p->m_pPrev->m_pNext = p->m_pNext;
-				else
-					m_pFirst = p->m_pNext;
-
-				/*CPacket *cur = first;
-				while(cur)
-				{
-					dbg_assert(cur != p, "p still in list");
-					cur = cur->next;
-				}*/
-
-				// send and remove packet
-				//if((rand()%20) != 0) // heavy packetloss
-				net_udp_send(Socket, &p->m_SendTo, p->m_aData, p->m_DataSize);
-
-				// update lag
-				double Flux = rand()/(double)RAND_MAX;
-				int MsSpike = Ping.m_Spike;
-				int MsFlux = Ping.m_Flux;
-				int MsPing = Ping.m_Base;
-				m_CurrentLatency = ((time_freq()*MsPing)/1000) + (int64)(((time_freq()*MsFlux)/1000)*Flux); // 50ms
-
-				if(MsSpike && (p->m_ID%100) == 0)
-				{
-					m_CurrentLatency += (time_freq()*MsSpike)/1000;
-					aFlags[1] = 'S';
-				}
-
-				if(m_ConfigLog)
-				{
-					char aAddrStr[NETADDR_MAXSTRSIZE];
-					net_addr_str(&p->m_SendTo, aAddrStr, sizeof(aAddrStr), true);
-					dbg_msg("crapnet", ">> %08d %s (%d) %s", p->m_ID, aAddrStr, p->m_DataSize, aFlags);
-				}
-
-
-				mem_free(p);
-			}
+		if(m_ConfigStatsInterval > 0 && time_get() > NextStats)
+		{
+			for(int i = 0; i < MAX_FLOWS; i++)
+				if(m_aFlows[i].m_Used)
+					PrintStats(&m_aFlows[i], "total");
+			NextStats = time_get()+time_freq()*m_ConfigStatsInterval;
 		}
 
 		thread_sleep(1);
 	}
 }
 
+void Replay(const char *pFilename)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		dbg_msg("crapnet", "failed to open capture '%s'", pFilename);
+		return;
+	}
+
+	NETSOCKET aSockets[MAX_FLOWS];
+	bool aOpen[MAX_FLOWS] = {false};
+	int NumSent = 0, NumReceived = 0;
+	char aBuffer[1024*2];
+	char aDiscard[1024*2];
+	unsigned char aHeader[13];
+
+	int64 Start = time_get();
+	while(io_read(File, aHeader, sizeof(aHeader)) == sizeof(aHeader))
+	{
+		int64 Time = 0;
+		for(int i = 0; i < 8; i++)
+			Time |= (int64)aHeader[i]<<(i*8);
+		int Dir = aHeader[8];
+		int Flow = aHeader[9] | (aHeader[10]<<8);
+		int Size = aHeader[11] | (aHeader[12]<<8);
+		if(Size > (int)sizeof(aBuffer) || (int)io_read(File, aBuffer, Size) != Size)
+			break;
+		if(Dir != DIR_UP || Flow >= MAX_FLOWS)
+			continue;
+
+		if(!aOpen[Flow])
+		{
+			NETADDR BindAddr = {NETTYPE_IPV4, {0,0,0,0}, 0};
+			aSockets[Flow] = net_udp_create(BindAddr, 1);
+			aOpen[Flow] = aSockets[Flow].type != 0;
+			if(!aOpen[Flow])
+				continue;
+		}
+
+		// keep the original timing, answers from the server are only counted
+		int64 SendTime = Start + Time*time_freq()/1000000;
+		while(time_get() < SendTime)
+		{
+			for(int i = 0; i < MAX_FLOWS; i++)
+			{
+				NETADDR From;
+				while(aOpen[i] && net_udp_recv(aSockets[i], &From, aDiscard, sizeof(aDiscard)) > 0)
+					NumReceived++;
+			}
+			thread_sleep(1);
+		}
+
+		net_udp_send(aSockets[Flow], &m_ServerAddr, aBuffer, Size);
+		NumSent++;
+	}
+
+	io_close(File);
+	for(int i = 0; i < MAX_FLOWS; i++)
+		if(aOpen[i])
+			net_udp_close(aSockets[i]);
+	dbg_msg("crapnet", "replayed %d packets in %.1fs, received %d", NumSent, (time_get()-Start)/(double)time_freq(), NumReceived);
+}
+
 int main(int argc, char **argv) // ignore_convention
 {
-	NETADDR Addr = {NETTYPE_IPV4, {127,0,0,1},8303};
 	dbg_logger_stdout();
-	Run(8302, Addr);
+	net_init();
+	m_StartTime = time_get();
+	for(int i = 0; i < MAX_FLOWS; i++)
+		m_aFlowProfiles[i] = -1;
+
+	int Port = 8302;
+	const char *pServer = "127.0.0.1:8303";
+	const char *pReplay = 0;
+	for(int i = 1; i < argc; i++) // ignore_convention
+	{
+		const char *pArg = argv[i]; // ignore_convention
+		const char *pValue = i+1 < argc ? argv[i+1] : 0; // ignore_convention
+		if(str_comp(pArg, "-l") == 0)
+			m_ConfigLog = 1;
+		else if(pValue && str_comp(pArg, "-p") == 0)
+			Port = str_toint(argv[++i]); // ignore_convention
+		else if(pValue && str_comp(pArg, "-s") == 0)
+			pServer = argv[++i]; // ignore_convention
+		else if(pValue && str_comp(pArg, "-i") == 0)
+			m_ConfigStatsInterval = str_toint(argv[++i]); // ignore_convention
+		else if(pValue && str_comp(pArg, "-r") == 0)
+			pReplay = argv[++i]; // ignore_convention
+		else if(pValue && str_comp(pArg, "-c") == 0)
+		{
+			if(!LoadConfig(argv[++i])) // ignore_convention
+				return 1;
+		}
+		else if(pValue && str_comp(pArg, "-w") == 0)
+		{
+			m_CaptureFile = io_open(argv[++i], IOFLAG_WRITE); // ignore_convention
+			if(!m_CaptureFile)
+			{
+				dbg_msg("crapnet", "failed to open capture file '%s'", argv[i]); // ignore_convention
+				return 1;
+			}
+		}
+		else
+		{
+			dbg_msg("crapnet", "usage: crapnet [-p <listen port>] [-s <server addr>] [-c <config file>] [-w <capture file>] [-r <capture file>] [-i <stats interval>] [-l]");
+			return 1;
+		}
+	}
+
+	if(net_host_lookup(pServer, &m_ServerAddr, NETTYPE_IPV4) != 0)
+	{
+		dbg_msg("crapnet", "failed to resolve '%s'", pServer);
+		return 1;
+	}
+	if(m_ServerAddr.port == 0)
+		m_ServerAddr.port = 8303;
+
+	if(pReplay)
+		Replay(pReplay);
+	else
+		Run(Port);
+
+	if(m_CaptureFile)
+		io_close(m_CaptureFile);
 	return 0;
 }
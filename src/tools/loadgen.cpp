@@ -0,0 +1,367 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/message.h>
+#include <engine/shared/network.h>
+#include <engine/shared/packer.h>
+#include <engine/shared/protocol.h>
+#include <game/generated/protocol.h>
+#include <game/version.h>
+
+#include <cstdlib>
+
+/*
+	loadgen - headless clients for load testing a server
+
+	Every client runs the real connection handshake over the client net stack,
+	optionally downloads the map, enters the game and then sends random input
+	every tick while acking the snapshots it receives, so the server does the
+	same work as for real players. Combine with crapnet to put them behind a
+	bad network.
+
+	usage: loadgen [-s <server addr>] [-n <clients>] [-t <seconds>] [-r <connects per second>]
+	               [-p <password>] [-d]
+*/
+
+enum
+{
+	MAX_LOADCLIENTS=256,
+	TICK_SPEED=50,
+
+	STATE_OFFLINE=0,
+	STATE_CONNECTING,
+	STATE_LOADING, // got the map change
+	STATE_READY, // waiting for the game to let us in
+	STATE_INGAME,
+	NUM_STATES
+};
+
+struct CClient
+{
+	CNetClient m_Net;
+	int m_State;
+	int m_ID;
+	int m_MapCrc;
+	int m_MapChunk;
+	int m_AckedTick;
+	int m_LastInputTick;
+	CNetObj_PlayerInput m_Input;
+
+	// totals
+	int m_Snaps;
+	int m_RecvBytes;
+	int m_SentBytes;
+	int m_MapBytes;
+};
+
+static CClient m_aClients[MAX_LOADCLIENTS];
+static NETADDR m_ServerAddr;
+static const char *m_pPassword = "";
+static bool m_DownloadMap = false;
+
+static void SendMsg(CClient *pClient, CMsgPacker *pMsg, int Flags, bool System)
+{
+	CNetChunk Packet;
+	mem_zero(&Packet, sizeof(Packet));
+	Packet.m_ClientID = 0;
+	Packet.m_pData = pMsg->Data();
+	Packet.m_DataSize = pMsg->Size();
+
+	// same as the server: the message id carries the system flag
+	*((unsigned char*)Packet.m_pData) <<= 1;
+	if(System)
+		*((unsigned char*)Packet.m_pData) |= 1;
+
+	if(Flags&MSGFLAG_VITAL)
+		Packet.m_Flags |= NETSENDFLAG_VITAL;
+	if(Flags&MSGFLAG_FLUSH)
+		Packet.m_Flags |= NETSENDFLAG_FLUSH;
+
+	pClient->m_Net.Send(&Packet);
+	pClient->m_SentBytes += Packet.m_DataSize;
+}
+
+static void SendInfo(CClient *pClient)
+{
+	CMsgPacker Msg(NETMSG_INFO);
+	Msg.AddString(GAME_NETVERSION, 128);
+	Msg.AddString(m_pPassword, 128);
+	SendMsg(pClient, &Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+}
+
+static void SendStartInfo(CClient *pClient)
+{
+	char aName[16];
+	str_format(aName, sizeof(aName), "loadgen %d", pClient->m_ID);
+
+	CNetMsg_Cl_StartInfo Info;
+	Info.m_pName = aName;
+	Info.m_pClan = "";
+	Info.m_Country = -1;
+	Info.m_pSkin = "default";
+	Info.m_UseCustomColor = 0;
+	Info.m_ColorBody = 0;
+	Info.m_ColorFeet = 0;
+
+	CMsgPacker Msg(Info.MsgID());
+	Info.Pack(&Msg);
+	SendMsg(pClient, &Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, false);
+}
+
+static void SendInput(CClient *pClient)
+{
+	// wander around, shoot and hook at random
+	CNetObj_PlayerInput *pInput = &pClient->m_Input;
+	if(rand()%25 == 0)
+		pInput->m_Direction = rand()%3-1;
+	pInput->m_TargetX = rand()%400-200;
+	pInput->m_TargetY = rand()%400-200;
+	pInput->m_Jump = rand()%20 == 0;
+	pInput->m_Fire += rand()%10 == 0;
+	pInput->m_Hook = rand()%30 == 0 ? !pInput->m_Hook : pInput->m_Hook;
+
+	CMsgPacker Msg(NETMSG_INPUT);
+	Msg.AddInt(pClient->m_AckedTick);
+	Msg.AddInt(++pClient->m_LastInputTick > pClient->m_AckedTick ? pClient->m_LastInputTick : (pClient->m_LastInputTick = pClient->m_AckedTick+1));
+	Msg.AddInt(sizeof(*pInput));
+	const int *pData = (const int *)pInput;
+	for(unsigned i = 0; i < sizeof(*pInput)/sizeof(int); i++)
+		Msg.AddInt(pData[i]);
+	SendMsg(pClient, &Msg, MSGFLAG_FLUSH, true);
+}
+
+static void ProcessPacket(CClient *pClient, CNetChunk *pPacket)
+{
+	pClient->m_RecvBytes += pPacket->m_DataSize;
+
+	CUnpacker Unpacker;
+	Unpacker.Reset(pPacket->m_pData, pPacket->m_DataSize);
+	int Msg = Unpacker.GetInt();
+	int Sys = Msg&1;
+	Msg >>= 1;
+	if(Unpacker.Error())
+		return;
+
+	if(!Sys)
+	{
+		if(Msg == NETMSGTYPE_SV_READYTOENTER && pClient->m_State == STATE_READY)
+		{
+			CMsgPacker Msg(NETMSG_ENTERGAME);
+			SendMsg(pClient, &Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+			pClient->m_State = STATE_INGAME;
+		}
+		return;
+	}
+
+	if(Msg == NETMSG_MAP_CHANGE)
+	{
+		Unpacker.GetString(CUnpacker::SANITIZE_CC); // map name
+		pClient->m_MapCrc = Unpacker.GetInt();
+		pClient->m_State = STATE_LOADING;
+		if(m_DownloadMap)
+		{
+			pClient->m_MapChunk = 0;
+			CMsgPacker Msg(NETMSG_REQUEST_MAP_DATA);
+			Msg.AddInt(pClient->m_MapChunk);
+			SendMsg(pClient, &Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+		}
+		else
+		{
+			CMsgPacker Msg(NETMSG_READY);
+			SendMsg(pClient, &Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+		}
+	}
+	else if(Msg == NETMSG_MAP_DATA && pClient->m_State == STATE_LOADING)
+	{
+		int Last = Unpacker.GetInt();
+		Unpacker.GetInt(); // crc
+		Unpacker.GetInt(); // chunk
+		int Size = Unpacker.GetInt();
+		if(Unpacker.Error())
+			return;
+		pClient->m_MapBytes += Size;
+
+		CMsgPacker Msg(Last ? NETMSG_READY : NETMSG_REQUEST_MAP_DATA);
+		if(!Last)
+			Msg.AddInt(++pClient->m_MapChunk);
+		SendMsg(pClient, &Msg, MSGFLAG_VITAL|MSGFLAG_FLUSH, true);
+	}
+	else if(Msg == NETMSG_CON_READY && pClient->m_State == STATE_LOADING)
+	{
+		pClient->m_State = STATE_READY;
+		SendStartInfo(pClient);
+	}
+	else if(Msg == NETMSG_SNAP || Msg == NETMSG_SNAPSINGLE || Msg == NETMSG_SNAPEMPTY)
+	{
+		// only acked, never unpacked. the server keeps sending deltas as if we had them
+		int Tick = Unpacker.GetInt();
+		if(Unpacker.Error())
+			return;
+		if(Msg == NETMSG_SNAP)
+		{
+			Unpacker.GetInt(); // delta
+			int NumParts = Unpacker.GetInt();
+			int Part = Unpacker.GetInt();
+			if(Unpacker.Error() || Part != NumParts-1)
+				return;
+		}
+		if(Tick > pClient->m_AckedTick)
+		{
+			pClient->m_AckedTick = Tick;
+			pClient->m_Snaps++;
+		}
+	}
+	else if(Msg == NETMSG_PING)
+	{
+		CMsgPacker Msg(NETMSG_PING_REPLY);
+		SendMsg(pClient, &Msg, MSGFLAG_FLUSH, true);
+	}
+}
+
+static void Connect(CClient *pClient)
+{
+	NETADDR BindAddr = {NETTYPE_IPV4, {0,0,0,0}, 0};
+	if(!pClient->m_Net.Open(BindAddr, NETCREATE_FLAG_RANDOMPORT))
+	{
+		dbg_msg("loadgen", "client %d: failed to open a socket", pClient->m_ID);
+		return;
+	}
+	pClient->m_Net.Connect(&m_ServerAddr);
+	pClient->m_State = STATE_CONNECTING;
+}
+
+static void PrintStats(int NumClients, double Seconds, int *pLastSnaps, int *pLastRecv, int *pLastSent)
+{
+	int aStates[NUM_STATES] = {0};
+	int Snaps = 0, Recv = 0, Sent = 0;
+	for(int i = 0; i < NumClients; i++)
+	{
+		aStates[m_aClients[i].m_State]++;
+		Snaps += m_aClients[i].m_Snaps;
+		Recv += m_aClients[i].m_RecvBytes;
+		Sent += m_aClients[i].m_SentBytes;
+	}
+
+	dbg_msg("loadgen", "%3d ingame, %d connecting, %d loading, %d offline | %5.0f snaps/s, %7.1f KB/s in, %6.1f KB/s out",
+		aStates[STATE_INGAME], aStates[STATE_CONNECTING]+aStates[STATE_READY], aStates[STATE_LOADING], aStates[STATE_OFFLINE],
+		(Snaps-*pLastSnaps)/Seconds, (Recv-*pLastRecv)/1024.0/Seconds, (Sent-*pLastSent)/1024.0/Seconds);
+	*pLastSnaps = Snaps;
+	*pLastRecv = Recv;
+	*pLastSent = Sent;
+}
+
+int main(int argc, char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	net_init();
+	CNetBase::Init();
+
+	const char *pServer = "127.0.0.1:8303";
+	int NumClients = 8;
+	int Duration = 0;
+	int ConnectRate = 10;
+	for(int i = 1; i < argc; i++) // ignore_convention
+	{
+		const char *pArg = argv[i]; // ignore_convention
+		bool HasValue = i+1 < argc; // ignore_convention
+		if(str_comp(pArg, "-d") == 0)
+			m_DownloadMap = true;
+		else if(HasValue && str_comp(pArg, "-s") == 0)
+			pServer = argv[++i]; // ignore_convention
+		else if(HasValue && str_comp(pArg, "-n") == 0)
+			NumClients = clamp(str_toint(argv[++i]), 1, (int)MAX_LOADCLIENTS); // ignore_convention
+		else if(HasValue && str_comp(pArg, "-t") == 0)
+			Duration = str_toint(argv[++i]); // ignore_convention
+		else if(HasValue && str_comp(pArg, "-r") == 0)
+			ConnectRate = max(str_toint(argv[++i]), 1); // ignore_convention
+		else if(HasValue && str_comp(pArg, "-p") == 0)
+			m_pPassword = argv[++i]; // ignore_convention
+		else
+		{
+			dbg_msg("loadgen", "usage: loadgen [-s <server addr>] [-n <clients>] [-t <seconds>] [-r <connects per second>] [-p <password>] [-d]");
+			return 1;
+		}
+	}
+
+	if(net_host_lookup(pServer, &m_ServerAddr, NETTYPE_IPV4) != 0)
+	{
+		dbg_msg("loadgen", "failed to resolve '%s'", pServer);
+		return 1;
+	}
+	if(m_ServerAddr.port == 0)
+		m_ServerAddr.port = 8303;
+
+	for(int i = 0; i < NumClients; i++)
+		m_aClients[i].m_ID = i;
+
+	int64 Start = time_get();
+	int64 NextTick = Start;
+	int64 NextConnect = Start;
+	int64 NextStats = Start+time_freq();
+	int NumStarted = 0;
+	int LastSnaps = 0, LastRecv = 0, LastSent = 0;
+
+	while(Duration <= 0 || time_get() < Start+time_freq()*Duration)
+	{
+		int64 Now = time_get();
+
+		// ramp up instead of connecting everyone at once
+		if(NumStarted < NumClients && Now >= NextConnect)
+		{
+			Connect(&m_aClients[NumStarted++]);
+			NextConnect = Now+time_freq()/ConnectRate;
+		}
+
+		bool Tick = Now >= NextTick;
+		if(Tick)
+			NextTick += time_freq()/TICK_SPEED;
+
+		for(int i = 0; i < NumStarted; i++)
+		{
+			CClient *pClient = &m_aClients[i];
+			if(pClient->m_State == STATE_OFFLINE)
+				continue;
+
+			pClient->m_Net.Update();
+			int NetState = pClient->m_Net.State();
+			if(NetState == NETSTATE_OFFLINE)
+			{
+				dbg_msg("loadgen", "client %d: disconnected (%s)", pClient->m_ID, pClient->m_Net.ErrorString());
+				pClient->m_State = STATE_OFFLINE;
+				continue;
+			}
+
+			if(pClient->m_State == STATE_CONNECTING && NetState == NETSTATE_ONLINE && pClient->m_MapCrc == 0 && pClient->m_SentBytes == 0)
+				SendInfo(pClient);
+
+			CNetChunk Packet;
+			while(pClient->m_Net.Recv(&Packet))
+			{
+				if(Packet.m_ClientID != -1)
+					ProcessPacket(pClient, &Packet);
+			}
+
+			if(Tick && pClient->m_State == STATE_INGAME)
+				SendInput(pClient);
+		}
+
+		if(Now >= NextStats)
+		{
+			PrintStats(NumStarted, 1.0+(Now-NextStats)/(double)time_freq(), &LastSnaps, &LastRecv, &LastSent);
+			NextStats = Now+time_freq();
+		}
+
+		thread_sleep(1);
+	}
+
+	int MapBytes = 0;
+	for(int i = 0; i < NumStarted; i++)
+	{
+		MapBytes += m_aClients[i].m_MapBytes;
+		m_aClients[i].m_Net.Disconnect("load test over");
+		m_aClients[i].m_Net.Update();
+	}
+	dbg_msg("loadgen", "done after %.1fs, %d KB of map data downloaded", (time_get()-Start)/(double)time_freq(), MapBytes/1024);
+	return 0;
+}
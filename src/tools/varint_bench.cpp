@@ -0,0 +1,236 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdlib.h> //rand
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/demo.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+
+/*
+	Benchmarks CVariableInt::Compress/Decompress against the plain one int at a time
+	implementation and verifies that both produce the exact same wire format.
+
+	usage: varint_bench [iterations] [demo file]
+
+	The delta chunks of the given demo are used as input, so record a demo on a full
+	server (e.g. a 64 player match) to get realistic data. Without a demo, synthetic
+	deltas are generated instead.
+*/
+
+enum
+{
+	MAX_BUFFERS=4096,
+
+	// see demo.cpp
+	CHUNKTYPEFLAG_TICKMARKER = 0x80,
+	CHUNKTICKFLAG_KEYFRAME = 0x40,
+	CHUNKMASK_TYPE = 0x60,
+	CHUNKMASK_SIZE = 0x1f,
+	CHUNKTYPE_DELTA = 3,
+};
+
+struct CBuffer
+{
+	int m_Size; // in bytes
+	int *m_pData;
+};
+
+static CBuffer s_aBuffers[MAX_BUFFERS];
+static int s_NumBuffers = 0;
+static int s_TotalSize = 0;
+
+static unsigned char s_aPacked[CSnapshot::MAX_SIZE*2];
+static unsigned char s_aPackedRef[CSnapshot::MAX_SIZE*2];
+static int s_aUnpacked[CSnapshot::MAX_SIZE];
+
+static long CompressRef(const void *pSrc_, int Size, void *pDst_)
+{
+	const int *pSrc = (const int *)pSrc_;
+	unsigned char *pDst = (unsigned char *)pDst_;
+	for(Size /= 4; Size; Size--, pSrc++)
+		pDst = CVariableInt::Pack(pDst, *pSrc);
+	return (long)(pDst-(unsigned char *)pDst_);
+}
+
+static long DecompressRef(const void *pSrc_, int Size, void *pDst_)
+{
+	const unsigned char *pSrc = (const unsigned char *)pSrc_;
+	const unsigned char *pEnd = pSrc + Size;
+	int *pDst = (int *)pDst_;
+	while(pSrc < pEnd)
+		pSrc = CVariableInt::Unpack(pSrc, pDst++);
+	return (long)((unsigned char *)pDst-(unsigned char *)pDst_);
+}
+
+static void AddBuffer(const int *pData, int Size)
+{
+	if(s_NumBuffers >= MAX_BUFFERS || Size <= 0)
+		return;
+	CBuffer *pBuf = &s_aBuffers[s_NumBuffers++];
+	pBuf->m_Size = Size;
+	pBuf->m_pData = (int *)mem_alloc(Size, 1);
+	mem_copy(pBuf->m_pData, pData, Size);
+	s_TotalSize += Size;
+}
+
+static bool LoadDemo(const char *pFilename)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		dbg_msg("varint_bench", "could not open '%s'", pFilename);
+		return false;
+	}
+
+	CDemoHeader Header;
+	if(io_read(File, &Header, sizeof(Header)) != sizeof(Header) || mem_comp(Header.m_aMarker, "TWDEMO", 7) != 0 || Header.m_Version < 3)
+	{
+		dbg_msg("varint_bench", "'%s' is not a supported demo file", pFilename);
+		io_close(File);
+		return false;
+	}
+	if(Header.m_Version > 3)
+		io_skip(File, sizeof(CTimelineMarkers));
+	io_skip(File, (Header.m_aMapSize[0]<<24) | (Header.m_aMapSize[1]<<16) | (Header.m_aMapSize[2]<<8) | (Header.m_aMapSize[3]));
+
+	static unsigned char aCompressed[CSnapshot::MAX_SIZE];
+	static unsigned char aDecompressed[CSnapshot::MAX_SIZE];
+	while(1)
+	{
+		unsigned char Chunk;
+		if(io_read(File, &Chunk, 1) != 1)
+			break;
+
+		if(Chunk&CHUNKTYPEFLAG_TICKMARKER)
+		{
+			if((Chunk&0x3f) == 0)
+				io_skip(File, 4);
+			continue;
+		}
+
+		int Type = (Chunk&CHUNKMASK_TYPE)>>5;
+		int Size = Chunk&CHUNKMASK_SIZE;
+		if(Size >= 30)
+		{
+			unsigned char aSize[2] = {0};
+			if(io_read(File, aSize, Size-29) != (unsigned)Size-29)
+				break;
+			Size = aSize[0] | (aSize[1]<<8);
+		}
+
+		if(io_read(File, aCompressed, Size) != (unsigned)Size)
+			break;
+		if(Type != CHUNKTYPE_DELTA)
+			continue;
+
+		int DataSize = CNetBase::Decompress(aCompressed, Size, aDecompressed, sizeof(aDecompressed));
+		if(DataSize < 0)
+			continue;
+		AddBuffer(s_aUnpacked, (int)DecompressRef(aDecompressed, DataSize, s_aUnpacked));
+	}
+
+	io_close(File);
+	return s_NumBuffers > 0;
+}
+
+static void GenerateDeltas()
+{
+	// values around the single byte boundaries
+	int NumEdge = 0;
+	for(int v = -200; v <= 200; v++)
+		s_aUnpacked[NumEdge++] = v;
+	AddBuffer(s_aUnpacked, NumEdge*4);
+
+	// mimic a delta: item keys with mostly small diffs and the odd large one
+	for(int i = 0; i < 1000; i++)
+	{
+		int NumInts = 0;
+		s_aUnpacked[NumInts++] = 0;
+		s_aUnpacked[NumInts++] = 64;
+		s_aUnpacked[NumInts++] = 0;
+		for(int Item = 0; Item < 64; Item++)
+		{
+			s_aUnpacked[NumInts++] = 9; // type
+			s_aUnpacked[NumInts++] = Item; // id
+			for(int d = 0; d < 22; d++)
+			{
+				int r = rand()%100;
+				s_aUnpacked[NumInts++] = r < 70 ? 0 : r < 95 ? (rand()%128)-64 : rand()-RAND_MAX/2;
+			}
+		}
+		AddBuffer(s_aUnpacked, NumInts*4);
+	}
+}
+
+static bool Verify()
+{
+	for(int i = 0; i < s_NumBuffers; i++)
+	{
+		CBuffer *pBuf = &s_aBuffers[i];
+		long RefSize = CompressRef(pBuf->m_pData, pBuf->m_Size, s_aPackedRef);
+		long Size = CVariableInt::Compress(pBuf->m_pData, pBuf->m_Size, s_aPacked);
+		if(Size != RefSize || mem_comp(s_aPacked, s_aPackedRef, Size) != 0)
+		{
+			dbg_msg("varint_bench", "compress mismatch in buffer %d", i);
+			return false;
+		}
+		if(CVariableInt::Decompress(s_aPacked, Size, s_aUnpacked) != pBuf->m_Size || mem_comp(s_aUnpacked, pBuf->m_pData, pBuf->m_Size) != 0)
+		{
+			dbg_msg("varint_bench", "decompress mismatch in buffer %d", i);
+			return false;
+		}
+	}
+	return true;
+}
+
+static int64 Bench(long (*pfnCompress)(const void *, int, void *), long (*pfnDecompress)(const void *, int, void *), int Iterations, int64 *pDecompressTime)
+{
+	int64 CompressTime = 0;
+	*pDecompressTime = 0;
+	for(int n = 0; n < Iterations; n++)
+	{
+		for(int i = 0; i < s_NumBuffers; i++)
+		{
+			int64 Start = time_get();
+			long Size = pfnCompress(s_aBuffers[i].m_pData, s_aBuffers[i].m_Size, s_aPacked);
+			int64 Mid = time_get();
+			pfnDecompress(s_aPacked, Size, s_aUnpacked);
+			CompressTime += Mid-Start;
+			*pDecompressTime += time_get()-Mid;
+		}
+	}
+	return CompressTime;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	CNetBase::Init();
+
+	int Iterations = argc > 1 ? max(1, str_toint(argv[1])) : 50; // ignore_convention
+	if(argc > 2) // ignore_convention
+	{
+		if(!LoadDemo(argv[2])) // ignore_convention
+			return -1;
+	}
+	else
+		GenerateDeltas();
+
+	dbg_msg("varint_bench", "%d delta buffers, %d bytes total, %d iterations", s_NumBuffers, s_TotalSize, Iterations);
+	if(!Verify())
+		return -1;
+
+	int64 RefDecompress, FastDecompress;
+	int64 RefCompress = Bench(CompressRef, DecompressRef, Iterations, &RefDecompress);
+	int64 FastCompress = Bench(CVariableInt::Compress, CVariableInt::Decompress, Iterations, &FastDecompress);
+
+	double Bytes = (double)s_TotalSize*Iterations;
+	double Freq = (double)time_freq();
+	dbg_msg("varint_bench", "compress:   reference %.1f MB/s, fast %.1f MB/s (%.2fx)",
+		Bytes/(RefCompress/Freq)/(1024*1024), Bytes/(FastCompress/Freq)/(1024*1024), RefCompress/(double)FastCompress);
+	dbg_msg("varint_bench", "decompress: reference %.1f MB/s, fast %.1f MB/s (%.2fx)",
+		Bytes/(RefDecompress/Freq)/(1024*1024), Bytes/(FastDecompress/Freq)/(1024*1024), RefDecompress/(double)FastDecompress);
+	return 0;
+}